@@ -0,0 +1,225 @@
+#include "allocator.h"
+
+#include <stdlib.h>
+
+/* Round size up to a multiple of alignment, a power of two. */
+static size_t align_size(size_t const size, size_t const alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Heap
+//////////////////////////////////////////////////////////////////////////////
+
+static void* heap_allocate(TrnAllocator * const allocator,
+                           size_t const size,
+                           size_t const alignment)
+{
+    (void) allocator;
+    void* memory = NULL;
+    if (alignment <= sizeof(void*))
+        return malloc(size);
+    if (posix_memalign(&memory, alignment, size))
+        return NULL;
+    return memory;
+}
+
+static void heap_release(TrnAllocator * const allocator, void * const memory)
+{
+    (void) allocator;
+    free(memory);
+}
+
+/* Stateless, never written. */
+static TrnAllocator heap = {heap_allocate, heap_release};
+
+TrnAllocator* trn_allocator_heap()
+{
+    return &heap;
+}
+
+void* trn_allocator_allocate(TrnAllocator * const allocator,
+                             size_t const size,
+                             size_t const alignment)
+{
+    return allocator->allocate(allocator, size, alignment);
+}
+
+void trn_allocator_release(TrnAllocator * const allocator,
+                           void * const memory)
+{
+    if (memory)
+        allocator->release(allocator, memory);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Arena
+//////////////////////////////////////////////////////////////////////////////
+
+struct TrnArenaChunk {
+    TrnArenaChunk* next;
+    size_t size;
+    size_t used;
+};
+
+#define ARENA_CHUNK_HEADER_SIZE \
+    align_size(sizeof(TrnArenaChunk), TRN_ALLOCATOR_MAX_ALIGNMENT)
+
+static TrnArenaChunk* arena_new_chunk(size_t const size,
+                                      TrnArenaChunk * const next)
+{
+    void* memory = NULL;
+    if (posix_memalign(&memory, TRN_ALLOCATOR_MAX_ALIGNMENT,
+                       ARENA_CHUNK_HEADER_SIZE + size))
+        return NULL;
+    TrnArenaChunk* chunk = (TrnArenaChunk*) memory;
+    chunk->next = next;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void* arena_allocate(TrnAllocator * const allocator,
+                            size_t const size,
+                            size_t const alignment)
+{
+    TrnArena * const arena = (TrnArena*) allocator;
+    TrnArenaChunk* chunk = arena->chunks;
+    size_t offset = chunk ? align_size(chunk->used, alignment) : 0;
+
+    if (!chunk || offset + size > chunk->size) {
+        /* Oversized allocations get a chunk of their own. */
+        size_t const chunkSize = size > arena->chunkSize ? size
+                                                         : arena->chunkSize;
+        chunk = arena_new_chunk(chunkSize, arena->chunks);
+        if (!chunk)
+            return NULL;
+        arena->chunks = chunk;
+        offset = 0;
+    }
+
+    chunk->used = offset + size;
+    return (char*) chunk + ARENA_CHUNK_HEADER_SIZE + offset;
+}
+
+static void arena_release(TrnAllocator * const allocator, void * const memory)
+{
+    /* Released with the whole arena. */
+    (void) allocator;
+    (void) memory;
+}
+
+TrnArena* trn_arena_new(size_t const chunkSize)
+{
+    TrnArena* arena = (TrnArena*) malloc(sizeof(TrnArena));
+    arena->base.allocate = arena_allocate;
+    arena->base.release = arena_release;
+    arena->chunks = NULL;
+    arena->chunkSize = chunkSize;
+    return arena;
+}
+
+void trn_arena_reset(TrnArena * const arena)
+{
+    /* Keep the first chunk allocated, it is likely to be reused as is. */
+    TrnArenaChunk* chunk = arena->chunks;
+    if (!chunk)
+        return;
+    while (chunk->next) {
+        TrnArenaChunk* next = chunk->next;
+        chunk->next = next->next;
+        free(next);
+    }
+    chunk->used = 0;
+}
+
+void trn_arena_destroy(TrnArena * arena)
+{
+    while (arena->chunks) {
+        TrnArenaChunk* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Pool
+//////////////////////////////////////////////////////////////////////////////
+
+struct TrnPoolBlock {
+    TrnPoolBlock* next;
+};
+
+struct TrnPoolChunk {
+    TrnPoolChunk* next;
+};
+
+#define POOL_CHUNK_HEADER_SIZE \
+    align_size(sizeof(TrnPoolChunk), TRN_ALLOCATOR_MAX_ALIGNMENT)
+
+static void* pool_allocate(TrnAllocator * const allocator,
+                           size_t const size,
+                           size_t const alignment)
+{
+    TrnPool * const pool = (TrnPool*) allocator;
+    if (size > pool->blockSize || alignment > TRN_ALLOCATOR_MAX_ALIGNMENT)
+        return NULL;
+
+    if (!pool->freeBlocks) {
+        void* memory = NULL;
+        if (posix_memalign(&memory, TRN_ALLOCATOR_MAX_ALIGNMENT,
+                           POOL_CHUNK_HEADER_SIZE +
+                           pool->blockSize * pool->blocksPerChunk))
+            return NULL;
+        TrnPoolChunk* chunk = (TrnPoolChunk*) memory;
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+
+        char* block = (char*) chunk + POOL_CHUNK_HEADER_SIZE;
+        int blockIndex;
+        for (blockIndex = 0 ; blockIndex < pool->blocksPerChunk ;
+             blockIndex++, block += pool->blockSize) {
+            ((TrnPoolBlock*) block)->next = pool->freeBlocks;
+            pool->freeBlocks = (TrnPoolBlock*) block;
+        }
+    }
+
+    TrnPoolBlock* block = pool->freeBlocks;
+    pool->freeBlocks = block->next;
+    return block;
+}
+
+static void pool_release(TrnAllocator * const allocator, void * const memory)
+{
+    TrnPool * const pool = (TrnPool*) allocator;
+    TrnPoolBlock * const block = (TrnPoolBlock*) memory;
+    block->next = pool->freeBlocks;
+    pool->freeBlocks = block;
+}
+
+TrnPool* trn_pool_new(size_t const blockSize, int const blocksPerChunk)
+{
+    TrnPool* pool = (TrnPool*) malloc(sizeof(TrnPool));
+    pool->base.allocate = pool_allocate;
+    pool->base.release = pool_release;
+    pool->freeBlocks = NULL;
+    pool->chunks = NULL;
+    /* Every block is aligned on a cache line. */
+    pool->blockSize = align_size(blockSize < sizeof(TrnPoolBlock) ?
+                                 sizeof(TrnPoolBlock) : blockSize,
+                                 TRN_ALLOCATOR_MAX_ALIGNMENT);
+    pool->blocksPerChunk = blocksPerChunk;
+    return pool;
+}
+
+void trn_pool_destroy(TrnPool * pool)
+{
+    while (pool->chunks) {
+        TrnPoolChunk* next = pool->chunks->next;
+        free(pool->chunks);
+        pool->chunks = next;
+    }
+    free(pool);
+}
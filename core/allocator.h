@@ -0,0 +1,63 @@
+#ifndef TRN_ALLOCATOR_H
+#define TRN_ALLOCATOR_H
+
+#include <stddef.h>
+
+/* Memory allocation context for games, grids and pieces. The allocator is
+ * passed to the *_with_allocator constructors and kept by the objects to
+ * release their memory. Allocators are not thread safe, use one per thread. */
+typedef struct TrnAllocator {
+    void* (*allocate)(struct TrnAllocator * const allocator,
+                      size_t const size,
+                      size_t const alignment);
+    void (*release)(struct TrnAllocator * const allocator,
+                    void * const memory);
+} TrnAllocator;
+
+/* Largest alignment an allocator must honor, one cache line. */
+#define TRN_ALLOCATOR_MAX_ALIGNMENT 64
+
+/* The default allocator, the C library heap. */
+TrnAllocator* trn_allocator_heap();
+
+void* trn_allocator_allocate(TrnAllocator * const allocator,
+                             size_t const size,
+                             size_t const alignment);
+
+void trn_allocator_release(TrnAllocator * const allocator,
+                           void * const memory);
+
+/* Arena: memory is carved from big chunks and never released one allocation
+ * at a time, but all at once by trn_arena_reset or trn_arena_destroy. */
+typedef struct TrnArenaChunk TrnArenaChunk;
+
+typedef struct {
+    TrnAllocator base;
+    TrnArenaChunk* chunks;
+    size_t chunkSize;
+} TrnArena;
+
+TrnArena* trn_arena_new(size_t const chunkSize);
+
+void trn_arena_reset(TrnArena * const arena);
+
+void trn_arena_destroy(TrnArena * arena);
+
+/* Pool: blocks of a single size, released blocks are reused by the next
+ * allocations. Allocations bigger than the block size fail. */
+typedef struct TrnPoolBlock TrnPoolBlock;
+typedef struct TrnPoolChunk TrnPoolChunk;
+
+typedef struct {
+    TrnAllocator base;
+    TrnPoolBlock* freeBlocks;
+    TrnPoolChunk* chunks;
+    size_t blockSize;
+    int blocksPerChunk;
+} TrnPool;
+
+TrnPool* trn_pool_new(size_t const blockSize, int const blocksPerChunk);
+
+void trn_pool_destroy(TrnPool * pool);
+
+#endif
@@ -0,0 +1,631 @@
+#include "bot.h"
+#include "allocator.h"
+#include "placement.h"
+#include "tetromino.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+TrnBotSettings trn_bot_default_settings()
+{
+    TrnBotSettings settings;
+    settings.weights.aggregateHeight = -0.51;
+    settings.weights.holes = -4.0;
+    settings.weights.bumpiness = -0.18;
+    settings.weights.wells = -0.35;
+    settings.weights.rowTransitions = -0.32;
+    settings.weights.columnTransitions = -0.93;
+    settings.weights.lines = 0.76;
+    settings.beamWidth = 8;
+    settings.depth = 2;
+    settings.withTucks = false;
+    return settings;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Features
+//////////////////////////////////////////////////////////////////////////////
+
+static uint64_t full_row(int const numberOfColumns)
+{
+    return numberOfColumns == 64 ? ~(uint64_t) 0
+                                 : ((uint64_t) 1 << numberOfColumns) - 1;
+}
+
+/* The walls being filled, a void row has none. */
+static int row_transitions(uint64_t const row, int const numberOfColumns)
+{
+    if (!row)
+        return 0;
+    uint64_t const inner = full_row(numberOfColumns - 1);
+    return __builtin_popcountll((row ^ (row >> 1)) & inner) +
+           !(row & 1) + !((row >> (numberOfColumns - 1)) & 1);
+}
+
+/* Changes between a row and the one below it. */
+static int column_transitions(uint64_t const row, uint64_t const below)
+{
+    return __builtin_popcountll(row ^ below);
+}
+
+static int well_sums(int const depth)
+{
+    return depth > 0 ? depth * (depth + 1) / 2 : 0;
+}
+
+/* Wells of the column at index in heights, the walls being as high as the
+ * grid. */
+static int column_wells(int const heights[],
+                        int const index,
+                        int const columnIndex,
+                        int const numberOfColumns,
+                        int const numberOfRows)
+{
+    int const left = columnIndex > 0 ? heights[index - 1] : numberOfRows;
+    int const right = columnIndex < numberOfColumns - 1 ? heights[index + 1]
+                                                        : numberOfRows;
+    return well_sums((left < right ? left : right) - heights[index]);
+}
+
+/* Features of the rows [0, numberOfRows), numberOfRows being the floor. */
+static void compute_rows_features(uint64_t const rows[],
+                                  int const numberOfRows,
+                                  int const numberOfColumns,
+                                  TrnBotFeatures * const features)
+{
+    int heights[TRN_BOT_MAX_COLUMNS];
+    uint64_t const full = full_row(numberOfColumns);
+    uint64_t covered = 0;
+    int rowIndex, columnIndex;
+
+    memset(features, 0, sizeof(TrnBotFeatures));
+    memset(heights, 0, numberOfColumns * sizeof(int));
+    for (rowIndex = 0 ; rowIndex < numberOfRows ; rowIndex++) {
+        uint64_t const row = rows[rowIndex];
+        uint64_t tops = row & ~covered;
+        while (tops) {
+            heights[__builtin_ctzll(tops)] = numberOfRows - rowIndex;
+            tops &= tops - 1;
+        }
+        features->holes += __builtin_popcountll(covered & ~row);
+        covered |= row;
+        features->rowTransitions += row_transitions(row, numberOfColumns);
+        features->columnTransitions +=
+            column_transitions(row, rowIndex + 1 < numberOfRows ?
+                                    rows[rowIndex + 1] : full);
+    }
+
+    for (columnIndex = 0 ; columnIndex < numberOfColumns ; columnIndex++) {
+        features->aggregateHeight += heights[columnIndex];
+        if (columnIndex > 0)
+            features->bumpiness += abs(heights[columnIndex] -
+                                       heights[columnIndex - 1]);
+        features->wells += column_wells(heights, columnIndex, columnIndex,
+                                        numberOfColumns, numberOfRows);
+    }
+}
+
+/* Cells of the row at shapeRowIndex of shape, its box left column being at
+ * leftColumnIndex, which is negative when the box sticks out of the grid. */
+static uint64_t shape_row(TrnTetrominoShape const * const shape,
+                          int const shapeRowIndex,
+                          int const leftColumnIndex)
+{
+    uint64_t const mask = shape->rowMasks[shapeRowIndex];
+    return leftColumnIndex >= 0 ? mask << leftColumnIndex
+                                : mask >> -leftColumnIndex;
+}
+
+/* Occupancy of a row of a grid of a single word per row, the floor being
+ * filled. */
+static uint64_t grid_row(TrnGrid const * const grid, int const rowIndex)
+{
+    if (rowIndex >= grid->numberOfRows)
+        return full_row(grid->numberOfColumns);
+    return trn_grid_row_bits(grid, rowIndex)[0];
+}
+
+void trn_bot_compute_features(TrnGrid const * const grid,
+                              TrnBotFeatures * const features)
+{
+    uint64_t rows[grid->numberOfRows];
+    int rowIndex;
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++)
+        rows[rowIndex] = grid_row(grid, rowIndex);
+    compute_rows_features(rows, grid->numberOfRows, grid->numberOfColumns,
+                          features);
+}
+
+int trn_bot_place_features(TrnGrid const * const grid,
+                           TrnBotFeatures const * const features,
+                           TrnPiece const * const placement,
+                           TrnBotFeatures * const placed)
+{
+    TrnTetrominoShape const * const shape =
+        &TRN_ALL_TETROMINO_SHAPES[placement->type][placement->angle];
+    int const numberOfRows = grid->numberOfRows;
+    int const numberOfColumns = grid->numberOfColumns;
+    int const topRowIndex = placement->topLeftCorner.rowIndex;
+    int const leftColumnIndex = placement->topLeftCorner.columnIndex;
+    int const firstRowIndex = topRowIndex + shape->firstRowIndex;
+    int const lastRowIndex = topRowIndex + shape->lastRowIndex;
+    int const firstColumnIndex = leftColumnIndex + shape->firstColumnIndex;
+    int const lastColumnIndex = leftColumnIndex + shape->lastColumnIndex;
+    uint64_t const full = full_row(numberOfColumns);
+    uint64_t oldRows[TRN_TETROMINO_GRID_SIZE + 1];
+    uint64_t newRows[TRN_TETROMINO_GRID_SIZE + 1];
+    int rowIndex, columnIndex, completeRows = 0;
+
+    /* Rows of the piece, plus the one above for the column transitions. */
+    for (rowIndex = firstRowIndex - 1 ; rowIndex <= lastRowIndex ;
+         rowIndex++) {
+        int const index = rowIndex - firstRowIndex + 1;
+        uint64_t const old = rowIndex >= 0 ? grid_row(grid, rowIndex) : 0;
+        oldRows[index] = old;
+        newRows[index] = old;
+        if (rowIndex < firstRowIndex)
+            continue;
+        newRows[index] |= shape_row(shape, rowIndex - topRowIndex,
+                                    leftColumnIndex);
+        completeRows += newRows[index] == full;
+    }
+    if (completeRows)
+        return completeRows;
+
+    *placed = *features;
+    for (rowIndex = firstRowIndex ; rowIndex <= lastRowIndex ; rowIndex++) {
+        int const index = rowIndex - firstRowIndex + 1;
+        uint64_t const below = grid_row(grid, rowIndex + 1);
+        uint64_t const newBelow = rowIndex < lastRowIndex ?
+                                  newRows[index + 1] : below;
+        placed->rowTransitions +=
+            row_transitions(newRows[index], numberOfColumns) -
+            row_transitions(oldRows[index], numberOfColumns);
+        placed->columnTransitions +=
+            column_transitions(newRows[index], newBelow) -
+            column_transitions(oldRows[index], below);
+    }
+    if (firstRowIndex > 0)
+        placed->columnTransitions +=
+            column_transitions(oldRows[0], newRows[1]) -
+            column_transitions(oldRows[0], oldRows[1]);
+
+    /* Heights of the piece columns and of the two columns on each side, which
+     * wells and bumpiness depend on, index 2 being the first piece column. */
+    int oldHeights[TRN_TETROMINO_GRID_SIZE + 4];
+    int newHeights[TRN_TETROMINO_GRID_SIZE + 4];
+    int const windowColumnIndex = firstColumnIndex - 2;
+    int const windowLength = lastColumnIndex - firstColumnIndex + 5;
+    int index;
+    for (index = 0 ; index < windowLength ; index++) {
+        columnIndex = windowColumnIndex + index;
+        oldHeights[index] = columnIndex >= 0 && columnIndex < numberOfColumns ?
+                            trn_grid_column_height(grid, columnIndex) : 0;
+        newHeights[index] = oldHeights[index];
+    }
+
+    for (columnIndex = firstColumnIndex ; columnIndex <= lastColumnIndex ;
+         columnIndex++) {
+        int const shapeColumnIndex = columnIndex - leftColumnIndex;
+        int const oldHeight = oldHeights[columnIndex - windowColumnIndex];
+        int const oldTopRowIndex = numberOfRows - oldHeight;
+        int pieceTopRowIndex = -1, cellsBelowTop = 0, cellsAboveTop = 0;
+        for (rowIndex = shape->firstRowIndex ;
+             rowIndex <= shape->columnBottoms[shapeColumnIndex] ;
+             rowIndex++) {
+            if (!((shape->rowMasks[rowIndex] >> shapeColumnIndex) & 1))
+                continue;
+            int const gridRowIndex = topRowIndex + rowIndex;
+            if (pieceTopRowIndex < 0)
+                pieceTopRowIndex = gridRowIndex;
+            if (gridRowIndex > oldTopRowIndex)
+                cellsBelowTop++;
+            else
+                cellsAboveTop++;
+        }
+        /* Cells below the old top fill holes, void cells between the old top
+         * and the piece become holes. */
+        placed->holes -= cellsBelowTop;
+        if (pieceTopRowIndex < oldTopRowIndex) {
+            int const newHeight = numberOfRows - pieceTopRowIndex;
+            placed->holes += oldTopRowIndex - pieceTopRowIndex - cellsAboveTop;
+            placed->aggregateHeight += newHeight - oldHeight;
+            newHeights[columnIndex - windowColumnIndex] = newHeight;
+        }
+    }
+
+    for (index = 0 ; index < windowLength ; index++) {
+        columnIndex = windowColumnIndex + index;
+        if (columnIndex < 0 || columnIndex >= numberOfColumns)
+            continue;
+        if (index > 0 && columnIndex > 0)
+            placed->bumpiness +=
+                abs(newHeights[index] - newHeights[index - 1]) -
+                abs(oldHeights[index] - oldHeights[index - 1]);
+        if (index == 0 || index == windowLength - 1)
+            continue;
+        placed->wells +=
+            column_wells(newHeights, index, columnIndex, numberOfColumns,
+                         numberOfRows) -
+            column_wells(oldHeights, index, columnIndex, numberOfColumns,
+                         numberOfRows);
+    }
+    return 0;
+}
+
+double trn_bot_evaluate(TrnBotWeights const * const weights,
+                        TrnBotFeatures const * const features)
+{
+    return weights->aggregateHeight * features->aggregateHeight +
+           weights->holes * features->holes +
+           weights->bumpiness * features->bumpiness +
+           weights->wells * features->wells +
+           weights->rowTransitions * features->rowTransitions +
+           weights->columnTransitions * features->columnTransitions;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Beam search
+//////////////////////////////////////////////////////////////////////////////
+
+/* A board kept by the search, and the placement of the current piece it
+ * comes from. */
+typedef struct {
+    TrnGrid* grid;
+    TrnBotFeatures features;
+    double value;
+    int lines;
+    TrnPiece first;
+} Node;
+
+/* A placement on a kept board. Ties are broken by parent and placement
+ * indices, so that the search does not depend on the worker count. */
+typedef struct {
+    double value;
+    int parentIndex;
+    int placementIndex;
+    int lines;
+    TrnPiece placement;
+    TrnBotFeatures features;
+} Candidate;
+
+/* The beamWidth best candidates of a worker, in a heap, the worst on top. */
+typedef struct {
+    TrnPlacementFinder* finder;
+    Candidate* heap;
+    int heapSize;
+    uint64_t* rows;
+} __attribute__((aligned(TRN_ALLOCATOR_MAX_ALIGNMENT))) Worker;
+
+struct TrnBot {
+    TrnBotSettings settings;
+    TrnScheduler* scheduler;
+    int numberOfRows;
+    int numberOfColumns;
+    Worker* workers;
+    int numberOfWorkers;
+    Node* nodes;     /* boards of the piece searched */
+    Node* children;  /* boards they lead to */
+    int numberOfNodes;
+    Candidate* candidates; /* merged from the workers */
+    /* Snapshots of the boards and the rows they copy, reused from piece to
+     * piece whatever the allocator of the game grid, eg an arena. */
+    TrnPool* snapshots;
+
+    /* Piece searched, where its placements are reached from. */
+    TrnPiece searchedPiece;
+};
+
+static bool is_better(Candidate const * const left,
+                      Candidate const * const right)
+{
+    if (left->value != right->value)
+        return left->value > right->value;
+    if (left->parentIndex != right->parentIndex)
+        return left->parentIndex < right->parentIndex;
+    return left->placementIndex < right->placementIndex;
+}
+
+static int compare_candidates(void const * left, void const * right)
+{
+    return is_better((Candidate const*) left, (Candidate const*) right) ? -1
+                                                                        : 1;
+}
+
+static void swap_candidates(Candidate * const left, Candidate * const right)
+{
+    Candidate const swapped = *left;
+    *left = *right;
+    *right = swapped;
+}
+
+static void heap_push(Worker * const worker,
+                      int const capacity,
+                      Candidate const * const candidate)
+{
+    Candidate * const heap = worker->heap;
+    int index;
+    if (worker->heapSize < capacity) {
+        index = worker->heapSize++;
+        heap[index] = *candidate;
+        while (index > 0 && is_better(&heap[(index - 1) / 2], &heap[index])) {
+            swap_candidates(&heap[(index - 1) / 2], &heap[index]);
+            index = (index - 1) / 2;
+        }
+        return;
+    }
+    if (!is_better(candidate, &heap[0]))
+        return;
+    heap[0] = *candidate;
+    index = 0;
+    for (;;) {
+        int worst = index;
+        int const left = 2 * index + 1;
+        int const right = left + 1;
+        if (left < worker->heapSize && is_better(&heap[worst], &heap[left]))
+            worst = left;
+        if (right < worker->heapSize && is_better(&heap[worst], &heap[right]))
+            worst = right;
+        if (worst == index)
+            return;
+        swap_candidates(&heap[worst], &heap[index]);
+        index = worst;
+    }
+}
+
+/* Features of node grid once placement is locked and its complete rows
+ * popped, from the rows of the worker. */
+static void compute_cleared_features(Worker * const worker,
+                                     TrnGrid const * const grid,
+                                     TrnPiece const * const placement,
+                                     TrnBotFeatures * const features)
+{
+    TrnTetrominoShape const * const shape =
+        &TRN_ALL_TETROMINO_SHAPES[placement->type][placement->angle];
+    int const numberOfRows = grid->numberOfRows;
+    int const topRowIndex = placement->topLeftCorner.rowIndex;
+    uint64_t const full = full_row(grid->numberOfColumns);
+    int const stackTopRowIndex = trn_grid_stack_top_row_index(grid);
+    int const firstRowIndex = topRowIndex + shape->firstRowIndex;
+    int const startRowIndex = firstRowIndex < stackTopRowIndex ?
+                              firstRowIndex : stackTopRowIndex;
+    int rowIndex, keptRowIndex = numberOfRows;
+
+    /* Rows kept, from the bottom, the ones above being void. */
+    for (rowIndex = numberOfRows - 1 ; rowIndex >= startRowIndex ;
+         rowIndex--) {
+        uint64_t row = trn_grid_row_bits(grid, rowIndex)[0];
+        int const shapeRowIndex = rowIndex - topRowIndex;
+        if (shapeRowIndex >= 0 && shapeRowIndex < TRN_TETROMINO_GRID_SIZE)
+            row |= shape_row(shape, shapeRowIndex,
+                             placement->topLeftCorner.columnIndex);
+        if (row != full)
+            worker->rows[--keptRowIndex] = row;
+    }
+    while (keptRowIndex > 0)
+        worker->rows[--keptRowIndex] = 0;
+    compute_rows_features(worker->rows, numberOfRows, grid->numberOfColumns,
+                          features);
+}
+
+static void expand_nodes(void * const context,
+                         int const begin,
+                         int const end,
+                         int const workerIndex)
+{
+    TrnBot * const bot = (TrnBot*) context;
+    Worker * const worker = &bot->workers[workerIndex];
+    TrnBotWeights const * const weights = &bot->settings.weights;
+    int nodeIndex, placementIndex;
+
+    for (nodeIndex = begin ; nodeIndex < end ; nodeIndex++) {
+        Node const * const node = &bot->nodes[nodeIndex];
+        int const numberOfPlacements =
+            trn_placement_finder_find(worker->finder, node->grid,
+                                      &bot->searchedPiece,
+                                      bot->settings.withTucks);
+        for (placementIndex = 0 ; placementIndex < numberOfPlacements ;
+             placementIndex++) {
+            Candidate candidate;
+            candidate.placement = worker->finder->placements[placementIndex];
+            candidate.parentIndex = nodeIndex;
+            candidate.placementIndex = placementIndex;
+            int const lines =
+                trn_bot_place_features(node->grid, &node->features,
+                                       &candidate.placement,
+                                       &candidate.features);
+            if (lines)
+                compute_cleared_features(worker, node->grid,
+                                         &candidate.placement,
+                                         &candidate.features);
+            candidate.lines = node->lines + lines;
+            candidate.value =
+                trn_bot_evaluate(weights, &candidate.features) +
+                weights->lines * candidate.lines;
+            heap_push(worker, bot->settings.beamWidth, &candidate);
+        }
+    }
+}
+
+TrnBot* trn_bot_new(int const numberOfRows,
+                    int const numberOfColumns,
+                    TrnBotSettings const settings,
+                    TrnScheduler * const scheduler)
+{
+    if (numberOfColumns > TRN_BOT_MAX_COLUMNS || settings.beamWidth < 1 ||
+        settings.depth < 1)
+        return NULL;
+
+    TrnBot* bot = (TrnBot*) malloc(sizeof(TrnBot));
+    bot->settings = settings;
+    bot->scheduler = scheduler;
+    bot->numberOfRows = numberOfRows;
+    bot->numberOfColumns = numberOfColumns;
+    bot->numberOfWorkers = scheduler ?
+                           trn_scheduler_number_of_workers(scheduler) : 1;
+    bot->workers = (Worker*) trn_allocator_allocate(
+        trn_allocator_heap(), bot->numberOfWorkers * sizeof(Worker),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+
+    int workerIndex;
+    for (workerIndex = 0 ; workerIndex < bot->numberOfWorkers ;
+         workerIndex++) {
+        Worker * const worker = &bot->workers[workerIndex];
+        worker->finder = trn_placement_finder_new(numberOfRows,
+                                                  numberOfColumns);
+        worker->heap = (Candidate*) malloc(settings.beamWidth *
+                                           sizeof(Candidate));
+        worker->heapSize = 0;
+        worker->rows = (uint64_t*) malloc(numberOfRows * sizeof(uint64_t));
+    }
+
+    bot->nodes = (Node*) malloc(settings.beamWidth * sizeof(Node));
+    bot->children = (Node*) malloc(settings.beamWidth * sizeof(Node));
+    bot->numberOfNodes = 0;
+    bot->candidates = (Candidate*) malloc(
+        bot->numberOfWorkers * settings.beamWidth * sizeof(Candidate));
+    bot->snapshots = trn_pool_new(
+        trn_grid_snapshot_block_size(numberOfRows, numberOfColumns),
+        2 * settings.beamWidth);
+    return bot;
+}
+
+void trn_bot_destroy(TrnBot * bot)
+{
+    int workerIndex;
+    for (workerIndex = 0 ; workerIndex < bot->numberOfWorkers ;
+         workerIndex++) {
+        trn_placement_finder_destroy(bot->workers[workerIndex].finder);
+        free(bot->workers[workerIndex].heap);
+        free(bot->workers[workerIndex].rows);
+    }
+    trn_allocator_release(trn_allocator_heap(), bot->workers);
+    free(bot->nodes);
+    free(bot->children);
+    free(bot->candidates);
+    trn_pool_destroy(bot->snapshots);
+    free(bot);
+}
+
+/* Release the snapshots of the kept boards, but the game grid. */
+static void release_nodes(TrnBot * const bot, TrnGrid const * const root)
+{
+    int nodeIndex;
+    for (nodeIndex = 0 ; nodeIndex < bot->numberOfNodes ; nodeIndex++)
+        if (bot->nodes[nodeIndex].grid != root)
+            trn_grid_destroy(bot->nodes[nodeIndex].grid);
+    bot->numberOfNodes = 0;
+}
+
+/* Expand every kept board with the placements reachable from piece, and
+ * keep the best boards they lead to. Return false, keeping the boards, when
+ * there is none. */
+static bool search_piece(TrnBot * const bot,
+                         TrnGame const * const game,
+                         TrnPiece const piece,
+                         bool const isFirst)
+{
+    int workerIndex, candidateIndex, numberOfCandidates = 0;
+
+    bot->searchedPiece = piece;
+    for (workerIndex = 0 ; workerIndex < bot->numberOfWorkers ;
+         workerIndex++)
+        bot->workers[workerIndex].heapSize = 0;
+    if (bot->scheduler)
+        trn_scheduler_parallel_for(bot->scheduler, bot->numberOfNodes, 1,
+                                   expand_nodes, bot);
+    else
+        expand_nodes(bot, 0, bot->numberOfNodes, 0);
+
+    for (workerIndex = 0 ; workerIndex < bot->numberOfWorkers ;
+         workerIndex++) {
+        Worker const * const worker = &bot->workers[workerIndex];
+        memcpy(&bot->candidates[numberOfCandidates], worker->heap,
+               worker->heapSize * sizeof(Candidate));
+        numberOfCandidates += worker->heapSize;
+    }
+    if (!numberOfCandidates)
+        return false;
+    qsort(bot->candidates, numberOfCandidates, sizeof(Candidate),
+          compare_candidates);
+    if (numberOfCandidates > bot->settings.beamWidth)
+        numberOfCandidates = bot->settings.beamWidth;
+
+    /* Snapshots share the rows of their parent until written, and are not
+     * thread safe: boards are made here, from a single thread. */
+    for (candidateIndex = 0 ; candidateIndex < numberOfCandidates ;
+         candidateIndex++) {
+        Candidate const * const candidate = &bot->candidates[candidateIndex];
+        Node const * const parent = &bot->nodes[candidate->parentIndex];
+        Node * const child = &bot->children[candidateIndex];
+        TrnTetrominoShape const * const shape =
+            &TRN_ALL_TETROMINO_SHAPES[candidate->placement.type]
+                                     [candidate->placement.angle];
+        int const topRowIndex = candidate->placement.topLeftCorner.rowIndex;
+
+        child->grid = trn_grid_snapshot_with_allocator(parent->grid,
+                                                       &bot->snapshots->base);
+        trn_grid_fill_piece(child->grid, &candidate->placement);
+        if (candidate->lines != parent->lines)
+            trn_grid_pop_complete_rows_in_range(
+                child->grid, topRowIndex + shape->firstRowIndex,
+                topRowIndex + shape->lastRowIndex, NULL);
+        child->features = candidate->features;
+        child->value = candidate->value;
+        child->lines = candidate->lines;
+        child->first = isFirst ? candidate->placement : parent->first;
+    }
+
+    release_nodes(bot, game->grid);
+    Node * const nodes = bot->nodes;
+    bot->nodes = bot->children;
+    bot->children = nodes;
+    bot->numberOfNodes = numberOfCandidates;
+    return true;
+}
+
+bool trn_bot_choose(TrnBot * const bot,
+                    TrnGame const * const game,
+                    TrnPiece * const placement)
+{
+    if (game->status != TRN_GAME_ON ||
+        game->grid->numberOfRows != bot->numberOfRows ||
+        game->grid->numberOfColumns != bot->numberOfColumns)
+        return false;
+
+    Node * const root = &bot->nodes[0];
+    root->grid = game->grid;
+    trn_bot_compute_features(game->grid, &root->features);
+    root->value = 0;
+    root->lines = 0;
+    bot->numberOfNodes = 1;
+
+    /* The current piece may have moved, or fallen with 20G gravity: its
+     * placements are searched from where it is, those of the preview from
+     * where they spawn. */
+    bool found = search_piece(bot, game, *game->current_piece, true);
+    int depth = 1;
+    while (found && depth < bot->settings.depth &&
+           depth <= game->queue.previewLength) {
+        found = search_piece(bot, game,
+                             trn_game_spawned_piece(
+                               game, trn_game_preview(game, depth - 1)),
+                             false);
+        depth++;
+    }
+
+    /* The boards are sorted, best first. A piece with no placement leaves
+     * those of the previous one, the root alone when it is the first. */
+    bool const chosen = depth > 1 || found;
+    if (chosen)
+        *placement = bot->nodes[0].first;
+    release_nodes(bot, game->grid);
+    return chosen;
+}
+
+bool trn_bot_play(TrnBot * const bot, TrnGame * const game)
+{
+    TrnPiece placement;
+    return trn_bot_choose(bot, game, &placement) &&
+           trn_game_place(game, &placement);
+}
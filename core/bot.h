@@ -0,0 +1,81 @@
+#ifndef TRN_BOT_H
+#define TRN_BOT_H
+
+#include <stdbool.h>
+
+#include "game.h"
+#include "grid.h"
+#include "piece.h"
+#include "scheduler.h"
+
+/* Features of the classic evaluation functions, the walls and the floor
+ * counting as filled cells. Void rows have no transition. */
+typedef struct {
+    int aggregateHeight;   /* sum of the column heights */
+    int holes;             /* void cells below the top of their column */
+    int bumpiness;         /* height differences between adjacent columns */
+    int wells;             /* 1 + 2 + ... + depth, for every well */
+    int rowTransitions;    /* filled to void changes along the rows */
+    int columnTransitions; /* filled to void changes down the columns */
+} TrnBotFeatures;
+
+typedef struct {
+    double aggregateHeight;
+    double holes;
+    double bumpiness;
+    double wells;
+    double rowTransitions;
+    double columnTransitions;
+    double lines; /* per line cleared along the searched placements */
+} TrnBotWeights;
+
+typedef struct {
+    TrnBotWeights weights;
+    int beamWidth; /* boards kept from one piece to the next */
+    int depth;     /* pieces searched: the current one and the preview */
+    bool withTucks;
+} TrnBotSettings;
+
+TrnBotSettings trn_bot_default_settings();
+
+/* Largest grid width the bot supports: one occupancy word per row. */
+#define TRN_BOT_MAX_COLUMNS TRN_GRID_ROW_BITS_WIDTH
+
+void trn_bot_compute_features(TrnGrid const * const grid,
+                              TrnBotFeatures * const features);
+
+/* Set placed to the features of grid once placement is locked, from the
+ * features of grid and the at most 4 rows and columns placement touches.
+ * Return the number of rows placement completes: when it is not 0, placed is
+ * not set, every row above falling. */
+int trn_bot_place_features(TrnGrid const * const grid,
+                           TrnBotFeatures const * const features,
+                           TrnPiece const * const placement,
+                           TrnBotFeatures * const placed);
+
+double trn_bot_evaluate(TrnBotWeights const * const weights,
+                        TrnBotFeatures const * const features);
+
+/* Beam search over the current piece and the preview: at each piece, every
+ * placement of every kept board is evaluated, and the beamWidth best boards
+ * are kept for the next piece. The placements of a piece are evaluated in
+ * parallel with scheduler, when not NULL. The hold is not used. */
+typedef struct TrnBot TrnBot;
+
+TrnBot* trn_bot_new(int const numberOfRows,
+                    int const numberOfColumns,
+                    TrnBotSettings const settings,
+                    TrnScheduler * const scheduler);
+
+void trn_bot_destroy(TrnBot * bot);
+
+/* Set placement to the best placement of the current piece of game. Return
+ * false when there is none. */
+bool trn_bot_choose(TrnBot * const bot,
+                    TrnGame const * const game,
+                    TrnPiece * const placement);
+
+/* Lock the current piece of game at the best placement. */
+bool trn_bot_play(TrnBot * const bot, TrnGame * const game);
+
+#endif
@@ -9,6 +9,19 @@ typedef struct {
   float blue;
 } TrnColor;
 
+/* Initializers of the colors, for tables of constants. */
+#define TRN_RGB(R,G,B) {R / 255.0, G / 255.0, B / 255.0}
+#define TRN_BLACK_INITIALIZER {0,0,0}
+#define TRN_WHITE_INITIALIZER {1,1,1}
+#define TRN_RED_INITIALIZER TRN_RGB(0xc0, 0x39, 0x2b)
+#define TRN_GREEN_INITIALIZER TRN_RGB(0x27, 0xae, 0x60)
+#define TRN_BLUE_INITIALIZER TRN_RGB(0x29, 0x80, 0xb9)
+#define TRN_YELLOW_INITIALIZER TRN_RGB(0xf3, 0x9c, 0x12)
+#define TRN_ORANGE_INITIALIZER TRN_RGB(0xd3, 0x54, 0x00)
+#define TRN_TURQUOISE_INITIALIZER TRN_RGB(0x1a, 0xbc, 0x9c)
+#define TRN_PURPLE_INITIALIZER TRN_RGB(0x8e, 0x44, 0xad)
+#define TRN_CYAN_INITIALIZER {0,1,1}
+
 extern TrnColor const TRN_BLACK;
 extern TrnColor const TRN_WHITE;
 extern TrnColor const TRN_RED;
@@ -0,0 +1,95 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "counters.h"
+
+#define NUMBER_OF_WORDS (sizeof(TrnCounters) / sizeof(uint64_t))
+
+#ifdef TRN_WITH_COUNTERS
+static TrnCounters staticTotals;
+TrnCounters* trn_counters_totals = &staticTotals;
+#endif
+
+bool trn_counters_enabled()
+{
+#ifdef TRN_WITH_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void trn_counters_read(TrnCounters * const counters)
+{
+    memset(counters, 0, sizeof(TrnCounters));
+#ifdef TRN_WITH_COUNTERS
+    /* Counters are all words, read one by one while they change. */
+    uint64_t const * const totals = (uint64_t const*)
+        __atomic_load_n(&trn_counters_totals, __ATOMIC_ACQUIRE);
+    uint64_t * const words = (uint64_t*) counters;
+    size_t index;
+    for (index = 0 ; index < NUMBER_OF_WORDS ; index++)
+        words[index] = __atomic_load_n(&totals[index], __ATOMIC_RELAXED);
+#endif
+}
+
+void trn_counters_reset()
+{
+#ifdef TRN_WITH_COUNTERS
+    uint64_t * const totals = (uint64_t*)
+        __atomic_load_n(&trn_counters_totals, __ATOMIC_ACQUIRE);
+    size_t index;
+    for (index = 0 ; index < NUMBER_OF_WORDS ; index++)
+        __atomic_store_n(&totals[index], 0, __ATOMIC_RELAXED);
+#endif
+}
+
+bool trn_counters_publish(char const * const path)
+{
+#ifdef TRN_WITH_COUNTERS
+    size_t const size = sizeof(TrnCountersFileHeader) + sizeof(TrnCounters);
+    int const file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+        return false;
+    void * const map = ftruncate(file, size) ? MAP_FAILED :
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+        return false;
+
+    TrnCountersFileHeader header = {{'T', 'R', 'N', 'C'},
+                                    TRN_COUNTERS_VERSION, size, 0};
+    TrnCounters * const totals =
+        (TrnCounters*) ((char*) map + sizeof(header));
+    memcpy(map, &header, sizeof(header));
+    trn_counters_read(totals);
+    /* The previous mapping, if any, stays mapped: a game may still be
+     * adding to it. */
+    __atomic_store_n(&trn_counters_totals, totals, __ATOMIC_RELEASE);
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+int trn_counters_bucket(uint64_t const nanoseconds)
+{
+    int bucket = 0;
+    uint64_t value = nanoseconds;
+    while (value > 1 && bucket < TRN_COUNTERS_LATENCY_BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint64_t trn_counters_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
@@ -0,0 +1,106 @@
+#ifndef TRN_COUNTERS_H
+#define TRN_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tetromino.h"
+
+/* Performance counters of the game hot paths, compiled in with
+ * TRN_WITH_COUNTERS (cmake -DTRN_WITH_COUNTERS=ON, or make WITH_COUNTERS=1)
+ * and compiled out otherwise, leaving no code behind. Each game counts its
+ * own, and every game adds to process wide totals with relaxed atomics,
+ * which may be published to a file mapped in memory, read by a dashboard
+ * while the process runs. */
+
+typedef enum {
+    TRN_COUNTED_MOVE_LEFT,
+    TRN_COUNTED_MOVE_RIGHT,
+    TRN_COUNTED_MOVE_DOWN,
+    TRN_COUNTED_ROTATION,
+    TRN_COUNTED_OTHER_MOVE, /* trn_game_try_to_move */
+    TRN_NUMBER_OF_COUNTED_MOVES
+} TrnCountedMove;
+
+/* Durations are counted in buckets of powers of two of nanoseconds: bucket
+ * i for [2^i, 2^(i+1)[, 0 and 1 in bucket 0. */
+#define TRN_COUNTERS_LATENCY_BUCKETS 40
+
+typedef struct {
+    uint64_t moveAttempts[TRN_NUMBER_OF_COUNTED_MOVES];
+    uint64_t failedMoves[TRN_NUMBER_OF_COUNTED_MOVES];
+    uint64_t spawnedPieces[TRN_NUMBER_OF_TETROMINO]; /* drawn from the queue */
+    uint64_t lineClears[5]; /* locks clearing 0 to 4 rows */
+    uint64_t lockToSpawnNanoseconds; /* total */
+    uint64_t lockToSpawn[TRN_COUNTERS_LATENCY_BUCKETS];
+    uint64_t tickNanoseconds; /* total, of trn_game_tick */
+    uint64_t ticks[TRN_COUNTERS_LATENCY_BUCKETS];
+} TrnCounters;
+
+/* A published file is this header followed by the totals, in native byte
+ * order. */
+#define TRN_COUNTERS_VERSION 1
+
+typedef struct {
+    char magic[4]; /* "TRNC" */
+    uint32_t version;
+    uint32_t size; /* of the header and the totals */
+    uint32_t padding;
+} TrnCountersFileHeader;
+
+/* Whether the counters are compiled in. */
+bool trn_counters_enabled();
+
+/* Copy the process wide totals to counters, all 0 when compiled out. */
+void trn_counters_read(TrnCounters * const counters);
+
+void trn_counters_reset();
+
+/* Move the process wide totals to the file at path, created or truncated,
+ * mapped in memory so that other processes read them as they change. Call
+ * it before playing. Return false if the file cannot be mapped, or if the
+ * counters are compiled out. */
+bool trn_counters_publish(char const * const path);
+
+/* Bucket of a duration in nanoseconds. */
+int trn_counters_bucket(uint64_t const nanoseconds);
+
+uint64_t trn_counters_now();
+
+#ifdef TRN_WITH_COUNTERS
+
+/* The process wide totals, static storage or the published file, read
+ * with an acquire load since trn_counters_publish moves them. */
+extern TrnCounters* trn_counters_totals;
+
+/* Add value to a counter of the game counters and of the totals, field
+ * naming the counter, eg lineClears[2]. */
+#define TRN_COUNTER_ADD(counters, field, value)                              \
+    do {                                                                     \
+        (counters)->field += (value);                                        \
+        __atomic_fetch_add(                                                  \
+            &__atomic_load_n(&trn_counters_totals, __ATOMIC_ACQUIRE)->field, \
+            (value), __ATOMIC_RELAXED);                                      \
+    } while (0)
+
+/* Start timing a duration, counted with TRN_COUNTER_ADD_DURATION. */
+#define TRN_COUNTER_START(start) uint64_t const start = trn_counters_now()
+
+/* Add a duration to the counter total and to its bucket of histogram. */
+#define TRN_COUNTER_ADD_DURATION(counters, total, histogram, start)          \
+    do {                                                                     \
+        uint64_t const duration = trn_counters_now() - (start);              \
+        TRN_COUNTER_ADD(counters, total, duration);                          \
+        TRN_COUNTER_ADD(counters, histogram[trn_counters_bucket(duration)],  \
+                        1);                                                  \
+    } while (0)
+
+#else
+
+#define TRN_COUNTER_ADD(counters, field, value) ((void) 0)
+#define TRN_COUNTER_START(start)
+#define TRN_COUNTER_ADD_DURATION(counters, total, histogram, start) ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,171 @@
+#include "env.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Large enough for the games of a usual batch in a few chunks. */
+#define ENV_ARENA_CHUNK_SIZE (1 << 20)
+
+static size_t observation_size(TrnEnv const * const env)
+{
+    return (size_t) env->numberOfRows * env->numberOfColumns;
+}
+
+static void apply_action(TrnGame * const game, TrnAction const action)
+{
+    switch (action) {
+    case TRN_ACTION_LEFT:
+        trn_game_try_to_move_left(game);
+        break;
+    case TRN_ACTION_RIGHT:
+        trn_game_try_to_move_right(game);
+        break;
+    case TRN_ACTION_DOWN:
+        trn_game_try_to_move_down(game);
+        break;
+    case TRN_ACTION_ROTATE_CLOCKWISE:
+        trn_game_try_to_rotate_clockwise(game);
+        break;
+    case TRN_ACTION_ROTATE_COUNTER_CLOCKWISE:
+        trn_game_try_to_rotate_counter_clockwise(game);
+        break;
+    case TRN_ACTION_ROTATE_180:
+        trn_game_try_to_rotate_180(game);
+        break;
+    case TRN_ACTION_HARD_DROP:
+        trn_game_move_to_bottom(game);
+        break;
+    case TRN_ACTION_HOLD:
+        trn_game_hold(game);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Write the cells of game to plane: the rows above the stack top at once,
+ * the others from the bitboard, then the current piece. */
+static void write_observation(TrnGame const * const game,
+                              uint8_t * const plane)
+{
+    TrnGrid const * const grid = game->grid;
+    int const numberOfColumns = grid->numberOfColumns;
+    int const stackTopRowIndex = trn_grid_stack_top_row_index(grid);
+    int rowIndex, columnIndex;
+
+    memset(plane, TRN_ENV_CELL_EMPTY,
+           (size_t) stackTopRowIndex * numberOfColumns);
+    for (rowIndex = stackTopRowIndex ; rowIndex < grid->numberOfRows ;
+         rowIndex++) {
+        TrnGridRowBits const * const bits = trn_grid_row_bits(grid, rowIndex);
+        uint8_t * const cells = plane + (size_t) rowIndex * numberOfColumns;
+        for (columnIndex = 0 ; columnIndex < numberOfColumns ; columnIndex++)
+            cells[columnIndex] =
+                (bits[columnIndex / TRN_GRID_ROW_BITS_WIDTH] >>
+                 (columnIndex % TRN_GRID_ROW_BITS_WIDTH)) & 1;
+    }
+
+    if (game->status != TRN_GAME_ON)
+        return;
+    TrnPiece const * const piece = game->current_piece;
+    TrnTetrominoRotation const squares =
+        TRN_ALL_TETROMINO_FOUR_ROTATIONS[piece->type][piece->angle];
+    int squareIndex;
+    for (squareIndex = 0 ; squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
+         squareIndex++) {
+        rowIndex = piece->topLeftCorner.rowIndex +
+                   squares[squareIndex].rowIndex;
+        columnIndex = piece->topLeftCorner.columnIndex +
+                      squares[squareIndex].columnIndex;
+        plane[(size_t) rowIndex * numberOfColumns + columnIndex] =
+            TRN_ENV_CELL_PIECE;
+    }
+}
+
+TrnEnv* trn_env_new(int const numberOfGames,
+                    int const numberOfRows,
+                    int const numberOfColumns,
+                    uint64_t const seed)
+{
+    TrnEnv* env = (TrnEnv*) malloc(sizeof(TrnEnv));
+    TrnAllocator* allocator;
+    int gameIndex;
+
+    env->numberOfGames = numberOfGames;
+    env->numberOfRows = numberOfRows;
+    env->numberOfColumns = numberOfColumns;
+    env->gravityPeriod = 0;
+    env->stepCount = 0;
+    trn_random_seed(&env->random, seed);
+    env->arena = trn_arena_new(ENV_ARENA_CHUNK_SIZE);
+    allocator = &env->arena->base;
+
+    env->games = (TrnGame**) trn_allocator_allocate(
+        allocator, numberOfGames * sizeof(TrnGame*), sizeof(void*));
+    env->rewards = (int32_t*) trn_allocator_allocate(
+        allocator, numberOfGames * sizeof(int32_t),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+    env->dones = (uint8_t*) trn_allocator_allocate(
+        allocator, numberOfGames, TRN_ALLOCATOR_MAX_ALIGNMENT);
+    env->observations = (uint8_t*) trn_allocator_allocate(
+        allocator, numberOfGames * observation_size(env),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+
+    /* The games get their seeds from trn_env_reset. */
+    for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++)
+        env->games[gameIndex] = trn_game_new_with_allocator(
+            numberOfRows, numberOfColumns, 0, 0, allocator);
+    trn_env_reset(env);
+    return env;
+}
+
+void trn_env_destroy(TrnEnv * env)
+{
+    /* The games and the arrays go with the arena. */
+    trn_arena_destroy(env->arena);
+    free(env);
+}
+
+void trn_env_reset(TrnEnv * const env)
+{
+    int gameIndex;
+    env->stepCount = 0;
+    for (gameIndex = 0 ; gameIndex < env->numberOfGames ; gameIndex++) {
+        TrnGame * const game = env->games[gameIndex];
+        trn_game_reset(game, trn_random_next(&env->random));
+        env->rewards[gameIndex] = 0;
+        env->dones[gameIndex] = 0;
+        write_observation(game, env->observations +
+                                gameIndex * observation_size(env));
+    }
+}
+
+void trn_env_step(TrnEnv * const env, uint8_t const actions[])
+{
+    bool const gravity = env->gravityPeriod > 0 &&
+        (env->stepCount + 1) % env->gravityPeriod == 0;
+    size_t const size = observation_size(env);
+    int gameIndex;
+
+    for (gameIndex = 0 ; gameIndex < env->numberOfGames ; gameIndex++) {
+        TrnGame * const game = env->games[gameIndex];
+        int const score = game->score;
+
+        apply_action(game, (TrnAction) actions[gameIndex]);
+        if (gravity)
+            trn_game_try_to_move_down(game);
+
+        env->rewards[gameIndex] = game->score - score;
+        env->dones[gameIndex] = game->status == TRN_GAME_OVER;
+        if (env->dones[gameIndex])
+            trn_game_reset(game, trn_random_next(&env->random));
+        write_observation(game, env->observations + gameIndex * size);
+    }
+    env->stepCount++;
+}
+
+uint8_t const* trn_env_observation(TrnEnv const * const env,
+                                   int const gameIndex)
+{
+    return env->observations + gameIndex * observation_size(env);
+}
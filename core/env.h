@@ -0,0 +1,70 @@
+#ifndef TRN_ENV_H
+#define TRN_ENV_H
+
+#include <stdint.h>
+
+#include "game.h"
+#include "allocator.h"
+#include "random.h"
+
+/* Actions of a game in an environment, one per step. */
+typedef enum {
+    TRN_ACTION_NONE,
+    TRN_ACTION_LEFT,
+    TRN_ACTION_RIGHT,
+    TRN_ACTION_DOWN,
+    TRN_ACTION_ROTATE_CLOCKWISE,
+    TRN_ACTION_ROTATE_COUNTER_CLOCKWISE,
+    TRN_ACTION_ROTATE_180,
+    TRN_ACTION_HARD_DROP,
+    TRN_ACTION_HOLD,
+    TRN_NUMBER_OF_ACTIONS
+} TrnAction;
+
+/* Observation cell values. */
+#define TRN_ENV_CELL_EMPTY 0
+#define TRN_ENV_CELL_LOCKED 1
+#define TRN_ENV_CELL_PIECE 2
+
+/* A batch of games stepped in lockstep, eg for reinforcement learning. The
+ * results of a step are kept in arrays indexed by game: rewards, done flags
+ * and observations, numberOfRows x numberOfColumns cells per game in a
+ * single contiguous plane, read in place without copies.
+ *
+ * A game that ends is reset within the step: its done flag is set and its
+ * observation is the first one of the next game. Games and arrays are
+ * allocated once, from an arena, and stepping does not allocate. */
+typedef struct {
+    int numberOfGames;
+    int numberOfRows;
+    int numberOfColumns;
+    int gravityPeriod; /* steps between two moves down, 0 for none */
+    int64_t stepCount;
+    TrnGame** games;
+    int32_t* rewards; /* score gained during the last step */
+    uint8_t* dones;
+    uint8_t* observations;
+    TrnRandom random; /* seeds of the next games */
+    TrnArena* arena;
+} TrnEnv;
+
+TrnEnv* trn_env_new(int const numberOfGames,
+                    int const numberOfRows,
+                    int const numberOfColumns,
+                    uint64_t const seed);
+
+void trn_env_destroy(TrnEnv * env);
+
+/* Reset every game and write their first observation. */
+void trn_env_reset(TrnEnv * const env);
+
+/* Apply actions[gameIndex] to each game, then the gravity, and write the
+ * rewards, done flags and observations. */
+void trn_env_step(TrnEnv * const env, uint8_t const actions[]);
+
+/* Return the observation plane of a game, numberOfRows rows of
+ * numberOfColumns cells. */
+uint8_t const* trn_env_observation(TrnEnv const * const env,
+                                   int const gameIndex);
+
+#endif
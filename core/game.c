@@ -2,37 +2,70 @@
 #include <string.h>
 
 #include "game.h"
+#include "replay.h"
 #include "tetromino_srs.h"
-#include <time.h>
+#include "zobrist.h"
 
-static TrnTetrominoType getRandomTrnTetrominoType()
+/* Record an input of an entry point, made while the game is on. */
+static void record(TrnGame * const game,
+                   TrnReplayInput const input,
+                   TrnPiece const * const placement)
 {
-#ifdef WITH_MOCK
-    static int tetromino_type_index = 0;
-    int number_of_tetromino_type = 2;
-    TrnTetrominoType mocked_tetromino_type[2] = 
-      {TRN_TETROMINO_J, TRN_TETROMINO_L};
+  if (game->recorder && game->status == TRN_GAME_ON)
+    trn_replay_recorder_record(game->recorder, input, placement);
+}
 
-    TrnTetrominoType tetrominoType = 
-      mocked_tetromino_type[tetromino_type_index];
-    tetromino_type_index = (tetromino_type_index + 1) % 
-                                     number_of_tetromino_type;
-    return tetrominoType;
-#else
-    return rand() % TRN_NUMBER_OF_TETROMINO;
-#endif
+/* Publish a change of the current piece, which was at from. */
+static void publish_piece(TrnGame * const game, TrnGameEventType const type,
+                          TrnPiece const from)
+{
+  TrnGameEvent * const event = trn_game_events_push(&game->events, type);
+  event->from = from;
+  event->to = *game->current_piece;
+}
+
+/* With 20G gravity, make the current piece fall to the bottom at once. */
+static void apply_gravity_20g(TrnGame * const game)
+{
+  if (game->gravity_20g && game->status == TRN_GAME_ON)
+    game->current_piece->topLeftCorner.rowIndex +=
+      trn_grid_drop_distance(game->grid, game->current_piece);
 }
 
-static bool move_piece_to_column_center(TrnPiece * const piece,
-                                        TrnGame const * const game)
+TrnPiece trn_game_spawned_piece(TrnGame const * const game,
+                                TrnTetrominoType const type)
 {
   int columnIndex = (game->grid->numberOfColumns - 
                      TRN_TETROMINO_GRID_SIZE)/2;
 
-  piece->topLeftCorner.columnIndex = columnIndex;
-  bool success = trn_grid_can_set_cells_with_piece(game->grid,game->current_piece);
-  trn_grid_fill_piece(game->grid, game->current_piece);
-  return success;
+  return trn_piece_create(type, 0, columnIndex, TRN_ANGLE_0);
+}
+
+/* Counted move of a shift by columnOffset. */
+#define COUNTED_SHIFT(columnOffset) \
+  ((columnOffset) < 0 ? TRN_COUNTED_MOVE_LEFT : \
+   (columnOffset) > 0 ? TRN_COUNTED_MOVE_RIGHT : TRN_COUNTED_MOVE_DOWN)
+
+/* Make a piece of type the current piece, at its spawn position, and end the
+ * game if it does not fit there. */
+static void spawn_piece(TrnGame * const game, TrnTetrominoType const type)
+{
+  *game->current_piece = trn_game_spawned_piece(game, type);
+  if (!trn_grid_can_set_cells_with_piece(game->grid,game->current_piece))
+    trn_game_over(game);
+  apply_gravity_20g(game);
+  trn_game_clock_start_piece(&game->clock,
+                             game->current_piece->topLeftCorner.rowIndex);
+  if (game->status == TRN_GAME_ON)
+    publish_piece(game, TRN_GAME_EVENT_PIECE_SPAWNED, *game->current_piece);
+}
+
+/* Spawn the first type of the queue. */
+static void spawn_next_piece(TrnGame * const game)
+{
+  TrnTetrominoType const type = trn_piece_queue_pop(&game->queue);
+  TRN_COUNTER_ADD(&game->counters, spawnedPieces[type], 1);
+  spawn_piece(game, type);
 }
 
 void trn_game_next_piece(TrnGame * const game)
@@ -40,64 +73,200 @@ void trn_game_next_piece(TrnGame * const game)
   if (game->status != TRN_GAME_ON)
      return;
 
-  free(game->current_piece);
-  game->current_piece = game->next_piece;
-  bool success = move_piece_to_column_center(game->current_piece,game);
+  /* The current piece struct is reused, a running game does not allocate. */
+  spawn_next_piece(game);
+  game->hold_used = false;
+}
+
+bool trn_game_hold(TrnGame * const game)
+{
+  record(game, TRN_REPLAY_HOLD, NULL);
+  if (game->status != TRN_GAME_ON || game->hold_used)
+     return false;
+
+  TrnTetrominoType const held = game->hold_type;
+  TrnPiece const from = *game->current_piece;
+  game->hold_type = from.type;
+  if (held == TRN_TETROMINO_VOID)
+    spawn_next_piece(game);
+  else
+    spawn_piece(game, held);
+  /* Once per piece: holding again waits for the next lock. */
+  game->hold_used = true;
+  /* A piece topping out ends the game, the game over being the last event. */
+  if (game->status != TRN_GAME_ON)
+    return false;
+  publish_piece(game, TRN_GAME_EVENT_PIECE_HELD, from);
+  return true;
+}
 
-  game->next_piece = trn_piece_new(getRandomTrnTetrominoType());
+TrnTetrominoType trn_game_preview(TrnGame const * const game, int const index)
+{
+  return trn_piece_queue_peek(&game->queue, index);
+}
 
-  if (!success)
-    trn_game_over(game);
+void trn_game_set_preview_length(TrnGame * const game,
+                                 int const preview_length)
+{
+  trn_piece_queue_set_preview_length(&game->queue, preview_length);
+}
+
+void trn_game_set_randomizer(TrnGame * const game,
+                             TrnRandomizer * const randomizer)
+{
+  trn_piece_queue_init(&game->queue, randomizer, game->seed,
+                       game->queue.previewLength);
+  if (game->status != TRN_GAME_ON)
+    return;
+  trn_game_events_push(&game->events, TRN_GAME_EVENT_STARTED);
+  spawn_next_piece(game);
+  if (game->recorder)
+    trn_replay_recorder_start(game->recorder, game);
 }
 
 void trn_game_over(TrnGame * const game) {
     game->status = TRN_GAME_OVER;
     trn_grid_fill(game->grid, TRN_TETROMINO_I);
+    trn_game_events_push(&game->events, TRN_GAME_EVENT_GAME_OVER);
+    if (game->recorder)
+        trn_replay_recorder_finish(game->recorder, game);
+}
+
+TrnGame* trn_game_new(int const numberOfRows, int const numberOfColumns, int delay,
+                      uint64_t const seed)
+{
+    return trn_game_new_with_allocator(numberOfRows, numberOfColumns, delay,
+                                       seed, trn_allocator_heap());
 }
 
-TrnGame* trn_game_new(int const numberOfRows, int const numberOfColumns, int delay)
+TrnGame* trn_game_new_with_allocator(int const numberOfRows,
+                                     int const numberOfColumns,
+                                     int const delay,
+                                     uint64_t const seed,
+                                     TrnAllocator * const allocator)
 {
-    srand(time(NULL));
-    TrnGame* game = (TrnGame*) malloc(sizeof(TrnGame));
+    TrnGame* game = (TrnGame*) trn_allocator_allocate(allocator,
+                                                      sizeof(TrnGame),
+                                                      sizeof(void*));
+    if (!game)
+        return NULL;
+    game->allocator = allocator;
     game->status = TRN_GAME_ON;
-    game->grid = trn_grid_new(numberOfRows, numberOfColumns);
+    game->grid = trn_grid_new_with_allocator(numberOfRows, numberOfColumns,
+                                             allocator);
+    game->current_piece =
+      trn_piece_new_with_allocator(TRN_TETROMINO_VOID, allocator);
+    if (!game->grid || !game->current_piece) {
+        if (game->grid)
+            trn_grid_destroy(game->grid);
+        if (game->current_piece)
+            trn_piece_destroy_with_allocator(game->current_piece, allocator);
+        trn_allocator_release(allocator, game);
+        return NULL;
+    }
     game->score = 0;
     game->lines_count = 0;
     game->level = 0;
     game->initial_delay = delay;
-
-    game->current_piece = trn_piece_new(getRandomTrnTetrominoType());
-    move_piece_to_column_center(game->current_piece,game);
-
-    game->next_piece = trn_piece_new(getRandomTrnTetrominoType());
+    game->gravity_20g = false;
+    game->recorder = NULL;
+    game->hold_type = TRN_TETROMINO_VOID;
+    game->hold_used = false;
+    game->seed = seed;
+    trn_game_events_init(&game->events);
+    trn_game_clock_init(&game->clock, trn_game_default_timing());
+    memset(&game->counters, 0, sizeof(game->counters));
+    trn_game_events_push(&game->events, TRN_GAME_EVENT_STARTED);
+
+    trn_piece_queue_init(&game->queue, trn_randomizer_bag(), seed,
+                         TRN_GAME_DEFAULT_PREVIEW_LENGTH);
+    spawn_next_piece(game);
 
     return game;
 }
 
+void trn_game_reset(TrnGame * const game, uint64_t const seed)
+{
+    if (game->recorder)
+        trn_replay_recorder_finish(game->recorder, game);
+    game->status = TRN_GAME_ON;
+    trn_grid_clear(game->grid);
+    game->score = 0;
+    game->lines_count = 0;
+    game->level = 0;
+    game->hold_type = TRN_TETROMINO_VOID;
+    game->hold_used = false;
+    game->seed = seed;
+    trn_game_events_push(&game->events, TRN_GAME_EVENT_STARTED);
+    memset(&game->counters, 0, sizeof(game->counters));
+
+    trn_piece_queue_init(&game->queue, game->queue.randomizer, seed,
+                         game->queue.previewLength);
+    spawn_next_piece(game);
+    if (game->recorder)
+        trn_replay_recorder_start(game->recorder, game);
+}
+
 void trn_game_destroy(TrnGame * game)
 {
-    free(game->current_piece);
-    free(game->next_piece);
+    TrnAllocator * const allocator = game->allocator;
+    if (game->recorder)
+        trn_replay_recorder_finish(game->recorder, game);
+    trn_piece_destroy_with_allocator(game->current_piece, allocator);
     trn_grid_destroy(game->grid);
-    free(game);
+    trn_allocator_release(allocator, game);
+}
+
+void trn_game_set_recorder(TrnGame * const game,
+                           TrnReplayRecorder * const recorder)
+{
+  if (game->recorder)
+    trn_replay_recorder_finish(game->recorder, game);
+  game->recorder = recorder;
+  if (recorder)
+    trn_replay_recorder_start(recorder, game);
+}
+
+/* Move the current piece by the given offset if it fits there. */
+static bool try_to_shift(TrnGame * const game, int const rowOffset,
+                         int const columnOffset)
+{
+  if (game->status != TRN_GAME_ON)
+     return false;
+
+  TrnPiece moved = *game->current_piece;
+  moved.topLeftCorner.rowIndex += rowOffset;
+  moved.topLeftCorner.columnIndex += columnOffset;
+  TRN_COUNTER_ADD(&game->counters,
+                  moveAttempts[COUNTED_SHIFT(columnOffset)], 1);
+  if (!trn_grid_can_set_cells_with_piece(game->grid, &moved)) {
+    TRN_COUNTER_ADD(&game->counters,
+                    failedMoves[COUNTED_SHIFT(columnOffset)], 1);
+    return false;
+  }
+  TrnPiece const from = *game->current_piece;
+  *game->current_piece = moved;
+  apply_gravity_20g(game);
+  publish_piece(game, TRN_GAME_EVENT_PIECE_MOVED, from);
+  return true;
 }
 
 bool trn_game_try_to_move_right(TrnGame * const game)
 {
-  return  trn_game_try_to_move(game,trn_piece_move_to_right, 
-                                    trn_piece_move_to_left);
+  record(game, TRN_REPLAY_RIGHT, NULL);
+  return try_to_shift(game, 0, 1);
 }
 
 bool trn_game_try_to_move_left(TrnGame * const game)
 {
-  return trn_game_try_to_move(game,trn_piece_move_to_left, 
-                                   trn_piece_move_to_right);
+  record(game, TRN_REPLAY_LEFT, NULL);
+  return try_to_shift(game, 0, -1);
 }
 
 bool trn_game_try_to_move_down(TrnGame * const game)
 {
-  bool success = trn_game_try_to_move(game,trn_piece_move_to_bottom,
-                                      trn_piece_move_to_top);
+  record(game, TRN_REPLAY_DOWN, NULL);
+  bool success = try_to_shift(game, 1, 0);
   if (!success) {
     trn_game_end_piece(game);
   }
@@ -106,45 +275,160 @@ bool trn_game_try_to_move_down(TrnGame * const game)
 
 void trn_game_end_piece(TrnGame * const game)
 {
+  bool const is_locked = game->status == TRN_GAME_ON;
+  TRN_COUNTER_START(lock_time);
+
+  /* The current piece only becomes part of the grid when it is locked. */
+  if (is_locked) {
+    trn_grid_fill_piece(game->grid, game->current_piece);
+    publish_piece(game, TRN_GAME_EVENT_PIECE_LOCKED, *game->current_piece);
+  }
   trn_game_check_complete_rows(game);
   trn_game_next_piece(game);
+  if (is_locked)
+    TRN_COUNTER_ADD_DURATION(&game->counters, lockToSpawnNanoseconds,
+                             lockToSpawn, lock_time);
+  if (game->recorder && game->status == TRN_GAME_ON)
+    trn_replay_recorder_piece_locked(game->recorder, game);
 }
 
 void trn_game_move_to_bottom(TrnGame * const game)
 {
-  while (true) {
-    if (!trn_game_try_to_move_down(game)) {
-      break;
-    }
+  record(game, TRN_REPLAY_HARD_DROP, NULL);
+  if (game->status != TRN_GAME_ON)
+     return;
+
+  int const distance = trn_game_drop_distance(game);
+  if (distance > 0) {
+    TrnPiece const from = *game->current_piece;
+    game->current_piece->topLeftCorner.rowIndex += distance;
+    publish_piece(game, TRN_GAME_EVENT_PIECE_MOVED, from);
   }
+  trn_game_end_piece(game);
+}
+
+bool trn_game_place(TrnGame * const game, TrnPiece const * const placement)
+{
+  if (game->status != TRN_GAME_ON ||
+      placement->type != game->current_piece->type ||
+      !trn_grid_can_set_cells_with_piece(game->grid, placement) ||
+      trn_grid_drop_distance(game->grid, placement) != 0)
+    return false;
+
+  record(game, TRN_REPLAY_PLACE, placement);
+  TrnPiece const from = *game->current_piece;
+  *game->current_piece = *placement;
+  publish_piece(game, TRN_GAME_EVENT_PIECE_MOVED, from);
+  trn_game_end_piece(game);
+  return true;
+}
+
+int trn_game_drop_distance(TrnGame const * const game)
+{
+  return trn_grid_drop_distance(game->grid, game->current_piece);
+}
+
+TrnPiece trn_game_ghost_piece(TrnGame const * const game)
+{
+  TrnPiece ghost = *game->current_piece;
+  ghost.topLeftCorner.rowIndex += trn_game_drop_distance(game);
+  return ghost;
+}
+
+void trn_game_set_gravity_20g(TrnGame * const game, bool const gravity_20g)
+{
+  TrnPiece const from = *game->current_piece;
+  game->gravity_20g = gravity_20g;
+  apply_gravity_20g(game);
+  if (!trn_piece_equal(from, *game->current_piece))
+    publish_piece(game, TRN_GAME_EVENT_PIECE_MOVED, from);
 }
 
 bool trn_game_try_to_rotate_clockwise(TrnGame * const game)
 {
-  return trn_game_try_to_move(game,trn_piece_rotate_clockwise,
-                                   trn_piece_rotate_counter_clockwise);
+  return trn_game_try_to_rotate(game, TRN_ROTATION_CLOCKWISE);
+}
+
+bool trn_game_try_to_rotate_counter_clockwise(TrnGame * const game)
+{
+  return trn_game_try_to_rotate(game, TRN_ROTATION_COUNTER_CLOCKWISE);
+}
+
+bool trn_game_try_to_rotate_180(TrnGame * const game)
+{
+  return trn_game_try_to_rotate(game, TRN_ROTATION_180);
 }
 
-bool trn_game_try_to_move(TrnGame* game,void (*move)(TrnPiece * const),
-                                     void (*unmove)(TrnPiece * const))
+bool trn_game_try_to_rotate(TrnGame * const game,
+                            TrnRotationDirection const direction)
 {
+  record(game, direction == TRN_ROTATION_CLOCKWISE ?
+               TRN_REPLAY_ROTATE_CLOCKWISE :
+               direction == TRN_ROTATION_COUNTER_CLOCKWISE ?
+               TRN_REPLAY_ROTATE_COUNTER_CLOCKWISE : TRN_REPLAY_ROTATE_180,
+         NULL);
   if (game->status != TRN_GAME_ON)
      return false;
 
-  bool managedToMove = true;
+  TrnPiece rotated;
+  bool const managedToRotate =
+    trn_srs_find_kick(game->grid, game->current_piece, direction,
+                      &rotated) >= 0;
+  TRN_COUNTER_ADD(&game->counters, moveAttempts[TRN_COUNTED_ROTATION], 1);
+  if (!managedToRotate)
+    TRN_COUNTER_ADD(&game->counters, failedMoves[TRN_COUNTED_ROTATION], 1);
+  if (managedToRotate) {
+    TrnPiece const from = *game->current_piece;
+    *game->current_piece = rotated;
+    apply_gravity_20g(game);
+    publish_piece(game, TRN_GAME_EVENT_PIECE_ROTATED, from);
+  }
 
-  trn_grid_remove_piece(game->grid, game->current_piece);
-  
-  move(game->current_piece);
+  return managedToRotate;
+}
+
+bool trn_game_try_to_move(TrnGame* game,void (*move)(TrnPiece * const))
+{
+  if (game->status != TRN_GAME_ON)
+     return false;
 
-  if (! trn_grid_can_set_cells_with_piece(game->grid, game->current_piece)) {
-      managedToMove = false;
-      unmove(game->current_piece);
+  TrnPiece moved = *game->current_piece;
+  move(&moved);
+  TRN_COUNTER_ADD(&game->counters, moveAttempts[TRN_COUNTED_OTHER_MOVE], 1);
+  if (! trn_grid_can_set_cells_with_piece(game->grid, &moved)) {
+      TRN_COUNTER_ADD(&game->counters, failedMoves[TRN_COUNTED_OTHER_MOVE],
+                      1);
+      return false;
   }
+  TrnPiece const from = *game->current_piece;
+  *game->current_piece = moved;
+  apply_gravity_20g(game);
+  publish_piece(game, TRN_GAME_EVENT_PIECE_MOVED, from);
+  return true;
+}
 
-  trn_grid_fill_piece(game->grid, game->current_piece);
+bool trn_game_piece_covers(TrnGame const * const game,
+                           TrnPositionInGrid const pos)
+{
+  if (game->status == TRN_GAME_OVER)
+    return false;
+
+  TrnPiece const * const piece = game->current_piece;
+  int const rowIndex = pos.rowIndex - piece->topLeftCorner.rowIndex;
+  int const columnIndex = pos.columnIndex - piece->topLeftCorner.columnIndex;
+  if (rowIndex < 0 || rowIndex >= TRN_TETROMINO_GRID_SIZE ||
+      columnIndex < 0 || columnIndex >= TRN_TETROMINO_GRID_SIZE)
+    return false;
+  return (TRN_ALL_TETROMINO_SHAPES[piece->type][piece->angle]
+          .rowMasks[rowIndex] >> columnIndex) & 1;
+}
 
-  return managedToMove;
+TrnTetrominoType trn_game_get_cell(TrnGame const * const game,
+                                   TrnPositionInGrid const pos)
+{
+  if (trn_game_piece_covers(game, pos))
+    return game->current_piece->type;
+  return trn_grid_get_cell(game->grid, pos);
 }
 
 void trn_game_check_complete_rows(TrnGame* game)
@@ -152,32 +436,72 @@ void trn_game_check_complete_rows(TrnGame* game)
   if (game->status != TRN_GAME_ON)
      return;
   
-  int row_index;
-  int lines_count = 0;
-
-  for ( row_index=0; row_index<game->grid->numberOfRows; ++row_index)
-  {
-    if ( trn_grid_is_row_complete(game->grid, row_index) )
-    {
-      trn_grid_pop_row_and_make_above_fall(game->grid, row_index);
-      ++lines_count;
-    }
+  /* Only the rows of the piece that has just been locked can be complete. */
+  TrnPiece const * const piece = game->current_piece;
+  TrnTetrominoShape const * const shape =
+    &TRN_ALL_TETROMINO_SHAPES[piece->type][piece->angle];
+  int const top_row_index = piece->topLeftCorner.rowIndex;
+
+  int row_indices[TRN_TETROMINO_GRID_SIZE];
+  int lines_count =
+    trn_grid_pop_complete_rows_in_range(game->grid,
+                                        top_row_index + shape->firstRowIndex,
+                                        top_row_index + shape->lastRowIndex,
+                                        row_indices);
+  TRN_COUNTER_ADD(&game->counters, lineClears[lines_count], 1);
+
+  if (lines_count > 0) {
+    TrnGameEvent * const event =
+      trn_game_events_push(&game->events, TRN_GAME_EVENT_ROWS_CLEARED);
+    int index;
+    event->rowsCount = lines_count;
+    for (index = 0 ; index < lines_count ; index++)
+      event->rowIndices[index] = row_indices[index];
+    trn_game_update_score(game, lines_count);
   }
   game->lines_count += lines_count;
   if (game->lines_count > LINES_PER_LEVEL * (game->level+1))
   {
-    ++game->level;
+    trn_game_level_up(game);
   }
 }
 
+/* Publish the change of a counter of the game. */
+static void publish_value(TrnGame * const game, TrnGameEventType const type,
+                          int const previous_value, int const value)
+{
+  TrnGameEvent * const event = trn_game_events_push(&game->events, type);
+  event->previousValue = previous_value;
+  event->value = value;
+}
+
 void trn_game_update_score(TrnGame* game, int const lines_count)
 {
+  int const previous_score = game->score;
   game->score += NINTENDO_SCORING[lines_count] * (game->level+1);
+  if (game->score != previous_score)
+    publish_value(game, TRN_GAME_EVENT_SCORE_CHANGED, previous_score,
+                  game->score);
 }
 
 void trn_game_level_up(TrnGame* game)
 {
   ++game->level;
+  publish_value(game, TRN_GAME_EVENT_LEVEL_UP, game->level - 1, game->level);
+}
+
+void trn_game_read_counters(TrnGame const * const game,
+                            TrnCounters * const counters)
+{
+  *counters = game->counters;
+}
+
+int trn_game_poll_events(TrnGame * const game,
+                         TrnGameEvent batch[],
+                         int const capacity,
+                         uint64_t * const lost)
+{
+  return trn_game_events_poll(&game->events, batch, capacity, lost);
 }
 
 int trn_game_delay(TrnGame* game)
@@ -185,3 +509,266 @@ int trn_game_delay(TrnGame* game)
   return game->initial_delay * 1./(game->level+1);
 }
 
+static uint64_t pieces_hash(TrnGame const * const game)
+{
+  uint64_t hash = trn_zobrist_piece_key(game->current_piece) ^
+                  trn_zobrist_hold_key(game->hold_type, game->hold_used);
+  int index;
+  for (index = 0 ; index < game->queue.previewLength ; index++)
+    hash ^= trn_zobrist_preview_key(index, trn_game_preview(game, index));
+  return hash;
+}
+
+uint64_t trn_game_hash(TrnGame const * const game)
+{
+  return trn_grid_hash(game->grid) ^ pieces_hash(game);
+}
+
+uint64_t trn_game_compute_hash(TrnGame const * const game)
+{
+  return trn_grid_compute_hash(game->grid) ^ pieces_hash(game);
+}
+
+/* Fixed size head of a save, followed by the grid image. */
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t size;
+  int32_t numberOfRows;
+  int32_t numberOfColumns;
+  uint64_t seed;
+  TrnRandom random;
+  int32_t status;
+  int32_t score;
+  int32_t linesCount;
+  int32_t level;
+  int32_t initialDelay;
+  int32_t pieceType;
+  int32_t pieceRowIndex;
+  int32_t pieceColumnIndex;
+  int32_t pieceAngle;
+  int32_t queueFirst;
+  int32_t queueCount;
+  int32_t previewLength;
+  uint8_t queueTypes[TRN_PIECE_QUEUE_CAPACITY];
+  uint8_t holdType;
+  uint8_t holdUsed;
+  uint8_t gravity20g;
+  uint8_t randomizer;
+} SaveHead;
+
+static char const SAVE_MAGIC[4] = {'T', 'R', 'N', 'G'};
+
+/* Written as a native integer, read back the same only on a machine of the
+ * same byte order. */
+#define SAVE_BYTE_ORDER 0x01020304u
+
+enum { SAVE_RANDOMIZER_BAG, SAVE_RANDOMIZER_UNIFORM, SAVE_RANDOMIZER_OTHER };
+
+static size_t save_size(int const numberOfRows, int const numberOfColumns)
+{
+  return sizeof(SaveHead) +
+         trn_grid_image_size(numberOfRows, numberOfColumns);
+}
+
+size_t trn_game_save_size(TrnGame const * const game)
+{
+  return save_size(game->grid->numberOfRows, game->grid->numberOfColumns);
+}
+
+size_t trn_game_save(TrnGame const * const game, void * const buffer)
+{
+  TrnPieceQueue const * const queue = &game->queue;
+  TrnPiece const * const piece = game->current_piece;
+  SaveHead head;
+  int index;
+
+  /* Padding included, so that saves of equal games are equal. */
+  memset(&head, 0, sizeof(head));
+  memcpy(head.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC));
+  head.version = TRN_GAME_SAVE_VERSION;
+  head.byteOrder = SAVE_BYTE_ORDER;
+  head.size = trn_game_save_size(game);
+  head.numberOfRows = game->grid->numberOfRows;
+  head.numberOfColumns = game->grid->numberOfColumns;
+  head.seed = game->seed;
+  head.random = queue->random;
+  head.status = game->status;
+  head.score = game->score;
+  head.linesCount = game->lines_count;
+  head.level = game->level;
+  head.initialDelay = game->initial_delay;
+  head.pieceType = piece->type;
+  head.pieceRowIndex = piece->topLeftCorner.rowIndex;
+  head.pieceColumnIndex = piece->topLeftCorner.columnIndex;
+  head.pieceAngle = piece->angle;
+  head.queueFirst = queue->first;
+  head.queueCount = queue->count;
+  head.previewLength = queue->previewLength;
+  for (index = 0 ; index < TRN_PIECE_QUEUE_CAPACITY ; index++)
+    head.queueTypes[index] = queue->types[index];
+  head.holdType = game->hold_type;
+  head.holdUsed = game->hold_used;
+  head.gravity20g = game->gravity_20g;
+  head.randomizer =
+    queue->randomizer == trn_randomizer_bag() ? SAVE_RANDOMIZER_BAG :
+    queue->randomizer == trn_randomizer_uniform() ? SAVE_RANDOMIZER_UNIFORM :
+    SAVE_RANDOMIZER_OTHER;
+
+  memcpy(buffer, &head, sizeof(head));
+  trn_grid_save_image(game->grid, (char*) buffer + sizeof(head));
+  return head.size;
+}
+
+/* Read the head of a save, and check that it is one. */
+static bool read_save_head(void const * const buffer,
+                           size_t const size,
+                           SaveHead * const head)
+{
+  int index;
+  if (size < sizeof(SaveHead))
+    return false;
+  memcpy(head, buffer, sizeof(SaveHead));
+  if (memcmp(head->magic, SAVE_MAGIC, sizeof(SAVE_MAGIC)) ||
+      head->version != TRN_GAME_SAVE_VERSION ||
+      head->byteOrder != SAVE_BYTE_ORDER ||
+      head->numberOfRows <= 0 || head->numberOfColumns <= 0 ||
+      head->numberOfRows > TRN_GAME_SAVE_MAX_ROWS ||
+      head->numberOfColumns > TRN_GAME_SAVE_MAX_COLUMNS ||
+      head->size != save_size(head->numberOfRows, head->numberOfColumns) ||
+      head->size > size)
+    return false;
+  /* Values indexing tables or dividing, checked so that a corrupted save is
+   * refused rather than read out of bounds. */
+  if (!(head->status >= TRN_GAME_ON && head->status <= TRN_GAME_PAUSED &&
+        head->score >= 0 && head->linesCount >= 0 && head->level >= 0 &&
+        head->initialDelay >= 0 &&
+        head->pieceType >= 0 && head->pieceType < TRN_NUMBER_OF_TETROMINO &&
+        head->pieceAngle >= TRN_ANGLE_0 &&
+        head->pieceAngle <= TRN_ANGLE_270 &&
+        head->queueFirst >= 0 &&
+        head->queueFirst < TRN_PIECE_QUEUE_CAPACITY &&
+        head->queueCount >= 0 &&
+        head->queueCount <= TRN_PIECE_QUEUE_CAPACITY &&
+        head->previewLength >= 1 &&
+        head->previewLength <= TRN_PIECE_QUEUE_MAX_PREVIEW &&
+        head->holdType <= TRN_TETROMINO_VOID &&
+        head->randomizer <= SAVE_RANDOMIZER_OTHER))
+    return false;
+  /* Only the queued types are read, the other slots being left over. */
+  for (index = 0 ; index < head->queueCount ; index++)
+    if (head->queueTypes[(head->queueFirst + index) %
+                         TRN_PIECE_QUEUE_CAPACITY] >= TRN_TETROMINO_VOID)
+      return false;
+  /* The current piece is written to the grid when it locks. */
+  TrnPiece const piece =
+    trn_piece_create((TrnTetrominoType) head->pieceType,
+                     head->pieceRowIndex, head->pieceColumnIndex,
+                     (TrnTetrominoRotationAngle) head->pieceAngle);
+  for (index = 0 ; index < TRN_TETROMINO_NUMBER_OF_SQUARES ; index++) {
+    TrnPositionInGrid const position =
+      trn_piece_position_in_grid(&piece, index);
+    if (position.rowIndex < 0 || position.rowIndex >= head->numberOfRows ||
+        position.columnIndex < 0 ||
+        position.columnIndex >= head->numberOfColumns)
+      return false;
+  }
+  return true;
+}
+
+bool trn_game_restore(TrnGame * const game,
+                      void const * const buffer,
+                      size_t const size)
+{
+  TrnPieceQueue * const queue = &game->queue;
+  TrnPiece * const piece = game->current_piece;
+  SaveHead head;
+  int index;
+
+  /* Everything is checked before the game changes. */
+  if (!read_save_head(buffer, size, &head) ||
+      head.numberOfRows != game->grid->numberOfRows ||
+      head.numberOfColumns != game->grid->numberOfColumns ||
+      !trn_grid_image_is_valid(head.numberOfRows, head.numberOfColumns,
+                               (char const*) buffer + sizeof(head)))
+    return false;
+
+  game->seed = head.seed;
+  game->status = (TrnGameStatus) head.status;
+  game->score = head.score;
+  game->lines_count = head.linesCount;
+  game->level = head.level;
+  game->initial_delay = head.initialDelay;
+  *piece = trn_piece_create((TrnTetrominoType) head.pieceType,
+                            head.pieceRowIndex, head.pieceColumnIndex,
+                            (TrnTetrominoRotationAngle) head.pieceAngle);
+  queue->random = head.random;
+  queue->first = head.queueFirst;
+  queue->count = head.queueCount;
+  queue->previewLength = head.previewLength;
+  for (index = 0 ; index < TRN_PIECE_QUEUE_CAPACITY ; index++)
+    queue->types[index] = (TrnTetrominoType) head.queueTypes[index];
+  if (head.randomizer == SAVE_RANDOMIZER_BAG)
+    queue->randomizer = trn_randomizer_bag();
+  else if (head.randomizer == SAVE_RANDOMIZER_UNIFORM)
+    queue->randomizer = trn_randomizer_uniform();
+  game->hold_type = (TrnTetrominoType) head.holdType;
+  game->hold_used = head.holdUsed;
+  game->gravity_20g = head.gravity20g;
+
+  trn_grid_restore_image(game->grid, (char const*) buffer + sizeof(head));
+  trn_game_clock_start_piece(&game->clock, head.pieceRowIndex);
+  trn_game_events_push(&game->events, TRN_GAME_EVENT_STARTED);
+  return true;
+}
+
+TrnGame* trn_game_new_from_save(void const * const buffer,
+                                size_t const size,
+                                TrnAllocator * const allocator)
+{
+  SaveHead head;
+  if (!read_save_head(buffer, size, &head))
+    return NULL;
+
+  TrnGame * const game =
+    trn_game_new_with_allocator(head.numberOfRows, head.numberOfColumns,
+                                head.initialDelay, head.seed, allocator);
+  /* The restore tells that the game started, not its creation. */
+  if (game)
+    trn_game_events_init(&game->events);
+  if (game && !trn_game_restore(game, buffer, size)) {
+    trn_game_destroy(game);
+    return NULL;
+  }
+  return game;
+}
+
+bool trn_game_save_to_file(TrnGame const * const game, FILE * const file)
+{
+  size_t const size = trn_game_save_size(game);
+  void * const buffer = malloc(size);
+  bool const isWritten = buffer &&
+    fwrite(buffer, 1, trn_game_save(game, buffer), file) == size;
+  free(buffer);
+  return isWritten;
+}
+
+bool trn_game_restore_from_file(TrnGame * const game, FILE * const file)
+{
+  SaveHead head, checkedHead;
+  if (fread(&head, 1, sizeof(head), file) != sizeof(head) ||
+      !read_save_head(&head, head.size, &checkedHead))
+    return false;
+
+  char * const buffer = (char*) malloc(head.size);
+  if (!buffer)
+    return false;
+  memcpy(buffer, &head, sizeof(head));
+  bool const isRestored =
+    fread(buffer + sizeof(head), 1, head.size - sizeof(head), file) ==
+    head.size - sizeof(head) &&
+    trn_game_restore(game, buffer, head.size);
+  free(buffer);
+  return isRestored;
+}
@@ -1,38 +1,116 @@
 #ifndef TRN_GAME_H
 #define TRN_GAME_H
 
+#include <stdio.h>
+
+#include "counters.h"
+#include "game_events.h"
+#include "game_tick.h"
 #include "grid.h"
 #include "piece.h"
+#include "piece_queue.h"
+#include "tetromino_srs.h"
 
 
 typedef enum { TRN_GAME_ON, TRN_GAME_OVER, TRN_GAME_PAUSED} TrnGameStatus;
 
+/* Defined in replay.h. */
+typedef struct TrnReplayRecorder TrnReplayRecorder;
+
 static int const NINTENDO_SCORING[5] = {0, 40, 100, 300, 1200};
 
+/* The grid only holds the locked cells: the current piece is kept apart and
+ * merged into the grid when it locks, so that moves do not write the grid.
+ * Use trn_game_get_cell to read the grid with the current piece on it. */
 typedef struct {
     TrnGameStatus status;
     TrnGrid* grid;
     TrnPiece* current_piece;
-    TrnPiece* next_piece;
+    TrnPieceQueue queue;
+    TrnTetrominoType hold_type;
+    bool hold_used;
+    uint64_t seed;
     int score;
     int lines_count;
     int level;
     int initial_delay;
+    bool gravity_20g;
+    TrnReplayRecorder* recorder; /* NULL when not recorded */
+    TrnAllocator* allocator;
+    TrnGameEvents events; /* read with trn_game_poll_events */
+    TrnGameClock clock;   /* driven by trn_game_tick */
+    /* Since creation or the last reset, all 0 when compiled out: the field
+     * is there either way, so that the layout of the game does not depend
+     * on TRN_WITH_COUNTERS. */
+    TrnCounters counters;
 } TrnGame;
 
 #define LINES_PER_LEVEL 10
 
+#define TRN_GAME_DEFAULT_PREVIEW_LENGTH 1
+
+/* Spawn the first type of the queue as the current piece. */
 void trn_game_next_piece(TrnGame * const game);
 
-TrnGame* trn_game_new(int const numberOfRows, int const numberOfColumns, int const delay);
+/* Return a piece of type where the game spawns it: at the top of the grid, in
+ * the middle, at angle 0. */
+TrnPiece trn_game_spawned_piece(TrnGame const * const game,
+                                TrnTetrominoType const type);
+
+/* Return the type of the index-th upcoming piece, index being lower than the
+ * preview length. */
+TrnTetrominoType trn_game_preview(TrnGame const * const game, int const index);
+
+/* Show preview_length upcoming pieces, at most TRN_PIECE_QUEUE_MAX_PREVIEW. */
+void trn_game_set_preview_length(TrnGame * const game,
+                                 int const preview_length);
+
+/* Draw the pieces from randomizer, 7-bag by default. The pieces are drawn
+ * again from the seed and the current piece spawned again, so call it right
+ * after creation. */
+void trn_game_set_randomizer(TrnGame * const game,
+                             TrnRandomizer * const randomizer);
+
+/* Swap the current piece with the held one, or hold it and spawn the next
+ * piece when the hold is empty. Allowed once per piece: return false until
+ * the current piece locks. Return false as well when the piece taking its
+ * place does not fit, ending the game. */
+bool trn_game_hold(TrnGame * const game);
+
+/* The pieces are drawn from a random generator owned by the game: games with
+ * the same seed get the same pieces. */
+TrnGame* trn_game_new(int const numberOfRows, int const numberOfColumns, int const delay,
+                      uint64_t const seed);
+
+/* Same as trn_game_new, the game, its grid and its pieces being allocated with
+ * allocator. Once created, a game does not allocate any more: with an arena,
+ * a finished game is released at once by resetting the arena. Return NULL
+ * if allocator runs out of memory. */
+TrnGame* trn_game_new_with_allocator(int const numberOfRows,
+                                     int const numberOfColumns,
+                                     int const delay,
+                                     uint64_t const seed,
+                                     TrnAllocator * const allocator);
+
+/* Start a new game with seed in place, without allocating: the randomizer,
+ * the preview length and the gravity are kept. */
+void trn_game_reset(TrnGame * const game, uint64_t const seed);
 
 void trn_game_destroy(TrnGame * game);
 
+/* Record the inputs of the game entry points with recorder, NULL to stop.
+ * A replay starts when it is attached, so right after creation, and again
+ * at each reset and randomizer change. It ends with the game, a reset or
+ * the destruction of the game. trn_game_try_to_move is not recorded. */
+void trn_game_set_recorder(TrnGame * const game,
+                           TrnReplayRecorder * const recorder);
+
 void trn_game_over(TrnGame * const game);
 
+/* Apply move to a copy of the current piece, which takes its place if it
+ * fits in the grid. */
 bool trn_game_try_to_move(TrnGame* game,
-                          void (*move)(TrnPiece * const),
-                          void (*unmove)(TrnPiece * const));
+                          void (*move)(TrnPiece * const));
 
 bool trn_game_try_to_move_right(TrnGame * const game);
 
@@ -40,12 +118,47 @@ bool trn_game_try_to_move_left(TrnGame * const game);
 
 bool trn_game_try_to_move_down(TrnGame * const game);
 
+/* Hard drop: move the current piece down by its drop distance and lock it. */
 void trn_game_move_to_bottom(TrnGame * const game);
 
+/* Lock the current piece at placement, eg one found by a placement finder,
+ * without going through the moves. Return false, and change nothing, if
+ * placement is not a resting position of the current piece. */
+bool trn_game_place(TrnGame * const game, TrnPiece const * const placement);
+
+/* Return how many rows the current piece can fall. */
+int trn_game_drop_distance(TrnGame const * const game);
+
+/* Return the current piece where a hard drop would lock it. */
+TrnPiece trn_game_ghost_piece(TrnGame const * const game);
+
+/* With 20G gravity, the current piece falls to the bottom as soon as it
+ * spawns, moves or rotates, and locks on the next move down. */
+void trn_game_set_gravity_20g(TrnGame * const game, bool const gravity_20g);
+
 bool trn_game_try_to_rotate_clockwise(TrnGame * const game);
 
+bool trn_game_try_to_rotate_counter_clockwise(TrnGame * const game);
+
+bool trn_game_try_to_rotate_180(TrnGame * const game);
+
+/* Rotate the current piece with the SRS wall kicks: the piece ends at the
+ * first kick that fits, or stays in place if none does. */
+bool trn_game_try_to_rotate(TrnGame * const game,
+                            TrnRotationDirection const direction);
+
+/* Lock the current piece into the grid, pop the complete rows and spawn the
+ * next piece. */
 void trn_game_end_piece(TrnGame * const game);
 
+/* Return whether the current piece has a square at pos. */
+bool trn_game_piece_covers(TrnGame const * const game,
+                           TrnPositionInGrid const pos);
+
+/* Return the type of the cell at pos, the current piece included. */
+TrnTetrominoType trn_game_get_cell(TrnGame const * const game,
+                                   TrnPositionInGrid const pos);
+
 void trn_game_update_score(TrnGame* game, int const lines_count);
 
 void trn_game_level_up(TrnGame* game);
@@ -53,5 +166,82 @@ void trn_game_level_up(TrnGame* game);
 int trn_game_delay(TrnGame* game);
 
 void trn_game_check_complete_rows(TrnGame* game);
+
+/* Run the frames of the game due at nowNanoseconds, a monotonic time: the
+ * first tick runs frame 0, and each following one the frames elapsed since,
+ * so that the rate does not drift with the latency of the caller, and a
+ * headless caller runs as fast as it advances the time. inputs are the
+ * TrnInput held down, presses between two frames being kept for the next
+ * one. Each frame applies the inputs, gravity and the lock delay, and sets
+ * the tick of the recorder to its number. A tick runs at most
+ * TRN_GAME_TICK_MAX_FRAMES frames, eg after the process was suspended: the
+ * frames beyond are skipped, and the following ticks go on from now. Return
+ * the number of frames run. */
+uint64_t trn_game_tick(TrnGame * const game,
+                       uint64_t const nowNanoseconds,
+                       unsigned const inputs);
+
+/* Change the timing of trn_game_tick, trn_game_default_timing by default.
+ * The frames go on from the current one at the new rate. Return false,
+ * keeping the timing as is, if frameNanoseconds is not positive, a number of
+ * frames or of resets is negative, or softDropFactor is below 1. */
+bool trn_game_set_timing(TrnGame * const game, TrnGameTiming const timing);
+
+/* Copy the counters of the game since its creation or its last reset to
+ * counters, all 0 when compiled out. */
+void trn_game_read_counters(TrnGame const * const game,
+                            TrnCounters * const counters);
+
+/* Move up to capacity of the events published by the game since the last
+ * poll to batch, oldest first, and return how many. lost, when not NULL, is
+ * set to the number of events overwritten meanwhile: the consumer then reads
+ * the whole game again, as on TRN_GAME_EVENT_STARTED. */
+int trn_game_poll_events(TrnGame * const game,
+                         TrnGameEvent batch[],
+                         int const capacity,
+                         uint64_t * const lost);
+
+/* Zobrist hash of the game: the grid, the current piece, the preview and the
+ * hold. The grid hash is maintained incrementally, so this is O(1). */
+uint64_t trn_game_hash(TrnGame const * const game);
+
+/* Same as trn_game_hash, computed from scratch for validation. */
+uint64_t trn_game_compute_hash(TrnGame const * const game);
+
+/* Saves: a flat image of a game, its random generator and its queue
+ * included, so that a restored game goes on exactly as the saved one. Saves
+ * are versioned and in native byte order, checkpoints for the machine that
+ * wrote them. The randomizer is saved when it is one of the core, and the
+ * recorder is not saved. */
+#define TRN_GAME_SAVE_VERSION 1
+
+/* Largest grids of a save, so that the head of a file read from disk does not
+ * make a restore allocate without bounds. */
+#define TRN_GAME_SAVE_MAX_ROWS 256
+#define TRN_GAME_SAVE_MAX_COLUMNS 256
+
+size_t trn_game_save_size(TrnGame const * const game);
+
+/* Write the save of game to buffer, of trn_game_save_size bytes, and return
+ * its size. */
+size_t trn_game_save(TrnGame const * const game, void * const buffer);
+
+/* Restore a save of a game of the same grid size, without allocating: a
+ * handful of copies, cheap enough for every node of a search. Return false,
+ * leaving game as is, if buffer is not such a save. */
+bool trn_game_restore(TrnGame * const game,
+                      void const * const buffer,
+                      size_t const size);
+
+/* Return a new game restored from buffer, or NULL if it is not a save. */
+TrnGame* trn_game_new_from_save(void const * const buffer,
+                                size_t const size,
+                                TrnAllocator * const allocator);
+
+/* Append the save of game to file, eg to checkpoint a long run. */
+bool trn_game_save_to_file(TrnGame const * const game, FILE * const file);
+
+/* Restore game from the next save of file. */
+bool trn_game_restore_from_file(TrnGame * const game, FILE * const file);
   
 #endif
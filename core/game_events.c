@@ -0,0 +1,36 @@
+#include "game_events.h"
+
+void trn_game_events_init(TrnGameEvents * const events)
+{
+    events->first = 0;
+    events->last = 0;
+    events->lost = 0;
+}
+
+TrnGameEvent* trn_game_events_push(TrnGameEvents * const events,
+                                   TrnGameEventType const type)
+{
+    if (events->last - events->first == TRN_GAME_EVENTS_CAPACITY) {
+        events->first++;
+        events->lost++;
+    }
+    TrnGameEvent * const event =
+        &events->events[events->last++ % TRN_GAME_EVENTS_CAPACITY];
+    event->type = type;
+    return event;
+}
+
+int trn_game_events_poll(TrnGameEvents * const events,
+                         TrnGameEvent batch[],
+                         int const capacity,
+                         uint64_t * const lost)
+{
+    int count = 0;
+    while (count < capacity && events->first != events->last)
+        batch[count++] =
+            events->events[events->first++ % TRN_GAME_EVENTS_CAPACITY];
+    if (lost)
+        *lost = events->lost;
+    events->lost = 0;
+    return count;
+}
@@ -0,0 +1,64 @@
+#ifndef TRN_GAME_EVENTS_H
+#define TRN_GAME_EVENTS_H
+
+#include <stdint.h>
+
+#include "piece.h"
+
+typedef enum {
+    /* The game started from scratch, after creation, a reset, a restore or
+     * a change of randomizer: everything changed. */
+    TRN_GAME_EVENT_STARTED,
+    TRN_GAME_EVENT_PIECE_MOVED,   /* from, to */
+    TRN_GAME_EVENT_PIECE_ROTATED, /* from, to */
+    TRN_GAME_EVENT_PIECE_LOCKED,  /* to, now in the grid */
+    TRN_GAME_EVENT_ROWS_CLEARED,  /* rowsCount, rowIndices */
+    TRN_GAME_EVENT_PIECE_SPAWNED, /* to, the preview moving on */
+    TRN_GAME_EVENT_PIECE_HELD,    /* from, the held piece, to */
+    TRN_GAME_EVENT_LEVEL_UP,      /* previousValue, value */
+    TRN_GAME_EVENT_SCORE_CHANGED, /* previousValue, value */
+    TRN_GAME_EVENT_GAME_OVER,
+    TRN_NUMBER_OF_GAME_EVENT_TYPES
+} TrnGameEventType;
+
+/* A change of a game, one cache line. The cells of a piece, eg to redraw
+ * only them, are given by trn_piece_position_in_grid. Cleared rows are
+ * their indices before the clear, bottom first, the rows above them moving
+ * down. */
+typedef struct {
+    TrnGameEventType type;
+    TrnPiece from;
+    TrnPiece to;
+    int rowsCount;
+    int rowIndices[TRN_TETROMINO_GRID_SIZE];
+    int previousValue;
+    int value;
+} TrnGameEvent;
+
+#define TRN_GAME_EVENTS_CAPACITY 32
+
+/* Events published by a game, in a ring buffer of fixed size: publishing
+ * never allocates. When the consumer falls behind, the oldest events are
+ * overwritten and counted as lost, so that it knows to read the whole game
+ * again. A game with no consumer just keeps its last events. */
+typedef struct {
+    TrnGameEvent events[TRN_GAME_EVENTS_CAPACITY];
+    uint64_t first;  /* number of events read or lost */
+    uint64_t last;   /* number of events published */
+    uint64_t lost;   /* lost since the last poll */
+} TrnGameEvents;
+
+void trn_game_events_init(TrnGameEvents * const events);
+
+/* Return the next event to publish, to be filled in place. */
+TrnGameEvent* trn_game_events_push(TrnGameEvents * const events,
+                                   TrnGameEventType const type);
+
+/* Move up to capacity of the oldest events to batch, and return how many.
+ * lost is set to the number of events overwritten since the last poll. */
+int trn_game_events_poll(TrnGameEvents * const events,
+                         TrnGameEvent batch[],
+                         int const capacity,
+                         uint64_t * const lost);
+
+#endif
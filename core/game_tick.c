@@ -0,0 +1,216 @@
+#include "game.h"
+#include "replay.h"
+
+TrnGameTiming trn_game_default_timing()
+{
+    TrnGameTiming timing;
+    timing.frameNanoseconds = 1000000000 / 60;
+    timing.dasFrames = 10;
+    timing.arrFrames = 2;
+    timing.lockDelayFrames = 30;
+    timing.maxLockResets = 15;
+    timing.softDropFactor = 20;
+    return timing;
+}
+
+void trn_game_clock_init(TrnGameClock * const clock,
+                         TrnGameTiming const timing)
+{
+    clock->timing = timing;
+    clock->isStarted = false;
+    clock->originNanoseconds = 0;
+    clock->frames = 0;
+    clock->heldInputs = 0;
+    clock->pressedInputs = 0;
+    clock->shiftDirection = 0;
+    clock->shiftFrames = 0;
+    trn_game_clock_start_piece(clock, 0);
+}
+
+void trn_game_clock_start_piece(TrnGameClock * const clock,
+                                int const rowIndex)
+{
+    clock->gravity = 0;
+    clock->lockFrames = 0;
+    clock->lockResets = 0;
+    clock->lowestRowIndex = rowIndex;
+}
+
+bool trn_game_set_timing(TrnGame * const game, TrnGameTiming const timing)
+{
+    /* Frames divide the time, and frame counts are compared to counters
+     * starting at 0. */
+    if (timing.frameNanoseconds <= 0 || timing.dasFrames < 0 ||
+        timing.arrFrames < 0 || timing.lockDelayFrames < 0 ||
+        timing.maxLockResets < 0 || timing.softDropFactor < 1)
+        return false;
+    game->clock.timing = timing;
+    game->clock.isStarted = false;
+    return true;
+}
+
+/* A move of the current piece on the ground restarts its lock delay, a
+ * bounded number of times so that it cannot stay up forever. */
+static void moved(TrnGame * const game)
+{
+    TrnGameClock * const clock = &game->clock;
+    if (trn_game_drop_distance(game) == 0 &&
+        clock->lockResets < clock->timing.maxLockResets) {
+        clock->lockFrames = 0;
+        clock->lockResets++;
+    }
+}
+
+static bool shift(TrnGame * const game, int const direction)
+{
+    bool const isShifted = direction < 0 ? trn_game_try_to_move_left(game)
+                                         : trn_game_try_to_move_right(game);
+    if (isShifted)
+        moved(game);
+    return isShifted;
+}
+
+/* Left and right: a press shifts at once, then the shift repeats every
+ * arrFrames once held for dasFrames. */
+static void auto_shift(TrnGame * const game, unsigned const pressed,
+                       unsigned const held)
+{
+    TrnGameClock * const clock = &game->clock;
+    TrnGameTiming const * const timing = &clock->timing;
+
+    if (pressed & (TRN_INPUT_LEFT | TRN_INPUT_RIGHT)) {
+        clock->shiftDirection = pressed & TRN_INPUT_RIGHT ? 1 : -1;
+        clock->shiftFrames = 0;
+        shift(game, clock->shiftDirection);
+        return;
+    }
+    unsigned const shiftInput = clock->shiftDirection < 0 ? TRN_INPUT_LEFT
+                                                          : TRN_INPUT_RIGHT;
+    if (!clock->shiftDirection || !(held & shiftInput)) {
+        clock->shiftDirection = 0;
+        return;
+    }
+    clock->shiftFrames++;
+    if (clock->shiftFrames < timing->dasFrames)
+        return;
+    if (timing->arrFrames <= 0) {
+        while (shift(game, clock->shiftDirection))
+            ;
+    } else if ((clock->shiftFrames - timing->dasFrames) %
+               timing->arrFrames == 0) {
+        shift(game, clock->shiftDirection);
+    }
+}
+
+/* Make the current piece fall by the cells gravity owes it, and keep no
+ * credit while it rests on the ground. */
+static void fall(TrnGame * const game, unsigned const held)
+{
+    TrnGameClock * const clock = &game->clock;
+    TrnGameTiming const * const timing = &clock->timing;
+    uint64_t const delay = (uint64_t) game->initial_delay * 1000000;
+    uint64_t step = (uint64_t) timing->frameNanoseconds * (game->level + 1);
+    if (held & TRN_INPUT_SOFT_DROP)
+        step *= timing->softDropFactor;
+
+    if (trn_game_drop_distance(game) == 0) {
+        clock->gravity = 0;
+        return;
+    }
+    clock->gravity += step;
+    while (trn_game_drop_distance(game) > 0 &&
+           (delay == 0 || clock->gravity >= delay)) {
+        trn_game_try_to_move_down(game);
+        clock->gravity -= delay;
+    }
+    if (trn_game_drop_distance(game) == 0)
+        clock->gravity = 0;
+}
+
+static void run_frame(TrnGame * const game)
+{
+    TrnGameClock * const clock = &game->clock;
+    unsigned const pressed = clock->pressedInputs;
+    unsigned const held = clock->heldInputs;
+
+    clock->pressedInputs = 0;
+    if (game->recorder)
+        trn_replay_recorder_set_tick(game->recorder, clock->frames);
+    if (game->status != TRN_GAME_ON)
+        return;
+
+    if (pressed & TRN_INPUT_HOLD)
+        trn_game_hold(game);
+    if ((pressed & TRN_INPUT_ROTATE_CLOCKWISE) &&
+        trn_game_try_to_rotate_clockwise(game))
+        moved(game);
+    if ((pressed & TRN_INPUT_ROTATE_COUNTER_CLOCKWISE) &&
+        trn_game_try_to_rotate_counter_clockwise(game))
+        moved(game);
+    if ((pressed & TRN_INPUT_ROTATE_180) && trn_game_try_to_rotate_180(game))
+        moved(game);
+    auto_shift(game, pressed, held);
+    if (pressed & TRN_INPUT_HARD_DROP) {
+        trn_game_move_to_bottom(game);
+        return;
+    }
+
+    fall(game, held);
+    if (game->status != TRN_GAME_ON)
+        return;
+
+    /* Reaching a lower row gives the piece a whole lock delay again. */
+    int const rowIndex = game->current_piece->topLeftCorner.rowIndex;
+    if (rowIndex > clock->lowestRowIndex) {
+        clock->lowestRowIndex = rowIndex;
+        clock->lockFrames = 0;
+        clock->lockResets = 0;
+    }
+    if (trn_game_drop_distance(game) == 0 &&
+        ++clock->lockFrames >= clock->timing.lockDelayFrames)
+        trn_game_move_to_bottom(game);
+}
+
+uint64_t trn_game_tick(TrnGame * const game,
+                       uint64_t const nowNanoseconds,
+                       unsigned const inputs)
+{
+    TrnGameClock * const clock = &game->clock;
+    uint64_t count = 0;
+    TRN_COUNTER_START(tickTime);
+
+    /* The frames go on from the current one, eg after a change of rate. */
+    if (!clock->isStarted) {
+        uint64_t const elapsed =
+            clock->frames * (uint64_t) clock->timing.frameNanoseconds;
+        clock->isStarted = true;
+        clock->originNanoseconds =
+            nowNanoseconds > elapsed ? nowNanoseconds - elapsed : 0;
+    }
+    /* Presses are kept until a frame runs, however short they were. */
+    clock->pressedInputs |= inputs & ~clock->heldInputs;
+    clock->heldInputs = inputs;
+    if (nowNanoseconds < clock->originNanoseconds)
+        return 0;
+
+    /* Frame n runs once now reaches n frames after the origin. */
+    uint64_t const frameNanoseconds = clock->timing.frameNanoseconds;
+    uint64_t dueFrames =
+        (nowNanoseconds - clock->originNanoseconds) / frameNanoseconds + 1;
+    /* After a stall, eg a suspended process, skip the frames beyond the
+     * limit rather than running them all, the origin moving forward so that
+     * the next tick goes on from now. */
+    if (dueFrames - clock->frames > TRN_GAME_TICK_MAX_FRAMES) {
+        dueFrames = clock->frames + TRN_GAME_TICK_MAX_FRAMES;
+        clock->originNanoseconds =
+            nowNanoseconds - (dueFrames - 1) * frameNanoseconds;
+    }
+    while (clock->frames < dueFrames) {
+        run_frame(game);
+        clock->frames++;
+        count++;
+    }
+    TRN_COUNTER_ADD_DURATION(&game->counters, tickNanoseconds, ticks,
+                             tickTime);
+    return count;
+}
@@ -0,0 +1,64 @@
+#ifndef TRN_GAME_TICK_H
+#define TRN_GAME_TICK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Inputs held down at a tick, or-ed together. Rotations, the hard drop and
+ * the hold act once per press; left and right auto-repeat while held; the
+ * soft drop speeds gravity up while held. */
+typedef enum {
+    TRN_INPUT_LEFT = 1 << 0,
+    TRN_INPUT_RIGHT = 1 << 1,
+    TRN_INPUT_SOFT_DROP = 1 << 2,
+    TRN_INPUT_HARD_DROP = 1 << 3,
+    TRN_INPUT_ROTATE_CLOCKWISE = 1 << 4,
+    TRN_INPUT_ROTATE_COUNTER_CLOCKWISE = 1 << 5,
+    TRN_INPUT_ROTATE_180 = 1 << 6,
+    TRN_INPUT_HOLD = 1 << 7
+} TrnInput;
+
+/* Timing of a game, in frames of frameNanoseconds. */
+typedef struct {
+    int64_t frameNanoseconds;
+    int dasFrames;       /* delay before left and right repeat */
+    int arrFrames;       /* between two repeats, 0 to reach the wall at once */
+    int lockDelayFrames; /* on the ground before the piece locks */
+    int maxLockResets;   /* moves on the ground restarting the lock delay */
+    int softDropFactor;  /* gravity multiplier while soft dropping */
+} TrnGameTiming;
+
+/* Frames run by a tick at most, 5 seconds at 60 frames per second. */
+#define TRN_GAME_TICK_MAX_FRAMES 300
+
+/* 60 frames per second, DAS 10, ARR 2, lock delay 30 with 15 resets, soft
+ * drop 20 times faster. */
+TrnGameTiming trn_game_default_timing();
+
+/* Fixed timestep state of a game, driven by trn_game_tick. */
+typedef struct {
+    TrnGameTiming timing;
+    bool isStarted;
+    uint64_t originNanoseconds; /* time of frame 0 */
+    uint64_t frames;            /* frames run so far */
+    unsigned heldInputs;
+    unsigned pressedInputs;     /* pressed since the last frame run */
+    int shiftDirection;         /* -1 left, 1 right, 0 none */
+    int shiftFrames;            /* frames since the shift started */
+    /* Gravity accumulator: each frame adds (level + 1) frame durations, a
+     * cell falling each time it reaches the delay of the game, so fractions
+     * of cells carry over from frame to frame. */
+    uint64_t gravity;
+    int lockFrames;
+    int lockResets;
+    int lowestRowIndex; /* reached by the current piece */
+} TrnGameClock;
+
+void trn_game_clock_init(TrnGameClock * const clock,
+                         TrnGameTiming const timing);
+
+/* Restart gravity and the lock delay for a piece spawned at rowIndex. */
+void trn_game_clock_start_piece(TrnGameClock * const clock,
+                                int const rowIndex);
+
+#endif
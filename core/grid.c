@@ -1,44 +1,650 @@
 #include "grid.h"
+#include "zobrist.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-TrnGrid* trn_grid_new(int const numberOfRows, int const numberOfColumns)
+static TrnTetrominoShape const* piece_shape(TrnPiece const * const piece)
+{
+    return &TRN_ALL_TETROMINO_SHAPES[piece->type][piece->angle];
+}
+
+/* Place a piece row mask, whose box column 0 is at grid column columnIndex,
+ * in the words of a grid row: placed[0] goes to the returned word index and
+ * placed[1], not empty when the piece straddles two words, to the next one.
+ * The caller has checked that the piece is horizontally in the grid. */
+static int place_mask(TrnGridRowBits const mask, int const columnIndex,
+                      TrnGridRowBits placed[2])
+{
+    int const offset = columnIndex & (TRN_GRID_ROW_BITS_WIDTH - 1);
+
+    if (columnIndex < 0) {
+        placed[0] = mask >> -columnIndex;
+        placed[1] = 0;
+        return 0;
+    }
+    placed[0] = mask << offset;
+    placed[1] = offset ? mask >> (TRN_GRID_ROW_BITS_WIDTH - offset) : 0;
+    return columnIndex / TRN_GRID_ROW_BITS_WIDTH;
+}
+
+static int count_bits(TrnGridRowBits const bits)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    TrnGridRowBits remaining = bits;
+    while (remaining) {
+        remaining &= remaining - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static TrnGridRowBits* row_bits(TrnGrid const * const grid,
+                                int const rowIndex)
+{
+    return grid->rowBits + rowIndex * grid->rowWords;
+}
+
+/* Occupancy of the word wordIndex of a complete row. */
+static TrnGridRowBits full_word_bits(TrnGrid const * const grid,
+                                     int const wordIndex)
+{
+    return wordIndex == grid->rowWords - 1 ? grid->fullRowBits
+                                           : ~(TrnGridRowBits) 0;
+}
+
+static bool row_is_empty(TrnGrid const * const grid, int const rowIndex)
+{
+    TrnGridRowBits const * const bits = row_bits(grid, rowIndex);
+    int wordIndex;
+    for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++) {
+        if (bits[wordIndex])
+            return false;
+    }
+    return true;
+}
+
+static bool row_is_complete(TrnGrid const * const grid, int const rowIndex)
+{
+    TrnGridRowBits const * const bits = row_bits(grid, rowIndex);
+    int wordIndex;
+    for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++) {
+        if (bits[wordIndex] != full_word_bits(grid, wordIndex))
+            return false;
+    }
+    return true;
+}
+
+static void copy_row_bits(TrnGrid * const grid, int const destinationRowIndex,
+                          int const sourceRowIndex)
+{
+    memcpy(row_bits(grid, destinationRowIndex), row_bits(grid, sourceRowIndex),
+           sizeof(TrnGridRowBits) * grid->rowWords);
+}
+
+/* Find the stack top, knowing that every row above rowIndex is void. */
+static void update_stack_top(TrnGrid * const grid, int const rowIndex)
+{
+    int topRowIndex = rowIndex;
+    while (topRowIndex < grid->numberOfRows && row_is_empty(grid, topRowIndex))
+        topRowIndex++;
+    grid->stackTopRowIndex = topRowIndex;
+}
+
+/* Keep the stack top right after cells of row rowIndex changed. */
+static void update_stack_top_with_row(TrnGrid * const grid,
+                                      int const rowIndex,
+                                      TrnTetrominoType const type)
+{
+    if (type != TRN_TETROMINO_VOID) {
+        if (rowIndex < grid->stackTopRowIndex)
+            grid->stackTopRowIndex = rowIndex;
+    } else if (rowIndex == grid->stackTopRowIndex) {
+        update_stack_top(grid, rowIndex);
+    }
+}
+
+/* Return the height of a column whose cells are all void from row 0 down to
+ * rowIndex-1, by scanning the bitboard from rowIndex. */
+static int column_height_from(TrnGrid const * const grid,
+                              int const columnIndex,
+                              int const rowIndex)
+{
+    int const wordIndex = columnIndex / TRN_GRID_ROW_BITS_WIDTH;
+    TrnGridRowBits const bit =
+        (TrnGridRowBits) 1 << (columnIndex % TRN_GRID_ROW_BITS_WIDTH);
+    int scannedRowIndex;
+    for (scannedRowIndex = rowIndex > grid->stackTopRowIndex ?
+                           rowIndex : grid->stackTopRowIndex ;
+         scannedRowIndex < grid->numberOfRows ;
+         scannedRowIndex++)
+    {
+        if (row_bits(grid, scannedRowIndex)[wordIndex] & bit)
+            return grid->numberOfRows - scannedRowIndex;
+    }
+    return 0;
+}
+
+/* Recompute every column height, walking rows from the stack top until each
+ * column of a word has met its first occupied cell, one word at a time. */
+static void update_column_heights(TrnGrid * const grid)
+{
+    int wordIndex;
+    int rowIndex;
+    int columnIndex;
+
+    for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++)
+        grid->columnHeights[columnIndex] = 0;
+
+    for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++) {
+        TrnGridRowBits const full = full_word_bits(grid, wordIndex);
+        TrnGridRowBits seen = 0;
+        for (rowIndex = grid->stackTopRowIndex ;
+             rowIndex < grid->numberOfRows && seen != full ;
+             rowIndex++)
+        {
+            TrnGridRowBits const bits = row_bits(grid, rowIndex)[wordIndex];
+            TrnGridRowBits reached = bits & ~seen;
+            while (reached) {
+                columnIndex = wordIndex * TRN_GRID_ROW_BITS_WIDTH +
+                              count_bits((reached & -reached) - 1);
+                grid->columnHeights[columnIndex] =
+                    grid->numberOfRows - rowIndex;
+                reached &= reached - 1;
+            }
+            seen |= bits;
+        }
+    }
+}
+
+/* Keep the height of a column right after one of its cells changed. */
+static void update_column_height(TrnGrid * const grid,
+                                 TrnPositionInGrid const pos,
+                                 TrnTetrominoType const type)
+{
+    int const cellHeight = grid->numberOfRows - pos.rowIndex;
+    int * const height = &grid->columnHeights[pos.columnIndex];
+
+    if (type != TRN_TETROMINO_VOID) {
+        if (cellHeight > *height)
+            *height = cellHeight;
+    } else if (cellHeight == *height) {
+        *height = column_height_from(grid, pos.columnIndex, pos.rowIndex+1);
+    }
+}
+
+/* Change the hash of a row, and the grid hash accordingly. */
+static void set_row_hash(TrnGrid * const grid, int const rowIndex,
+                         uint64_t const rowHash)
+{
+    grid->hash ^= trn_zobrist_row_key(rowIndex, grid->rowHashes[rowIndex]) ^
+                  trn_zobrist_row_key(rowIndex, rowHash);
+    grid->rowHashes[rowIndex] = rowHash;
+}
+
+static void update_cell_hash(TrnGrid * const grid,
+                             TrnPositionInGrid const pos,
+                             TrnTetrominoType const previousType,
+                             TrnTetrominoType const type)
+{
+    set_row_hash(grid, pos.rowIndex,
+                 grid->rowHashes[pos.rowIndex] ^
+                 trn_zobrist_cell_key(pos.columnIndex, previousType) ^
+                 trn_zobrist_cell_key(pos.columnIndex, type));
+}
+
+/* Recompute the grid hash from the row hashes, once rows have moved. Void
+ * rows have a zero key, so rows above the stack top are skipped. */
+static void update_grid_hash(TrnGrid * const grid)
+{
+    int rowIndex;
+    grid->hash = 0;
+    for (rowIndex = grid->stackTopRowIndex ;
+         rowIndex < grid->numberOfRows ;
+         rowIndex++)
+        grid->hash ^= trn_zobrist_row_key(rowIndex, grid->rowHashes[rowIndex]);
+}
+
+/* Round size up to a multiple of TRN_GRID_ALIGNMENT. */
+static size_t align_size(size_t const size)
+{
+    return (size + TRN_GRID_ALIGNMENT - 1) & ~(size_t)(TRN_GRID_ALIGNMENT - 1);
+}
+
+/* Start of every allocated block: the number of live things in the block,
+ * ie the grid header it holds, if any, and its rows still referenced by a
+ * grid. The block is released to its allocator when it drops to zero. */
+typedef struct {
+    int references;
+    TrnAllocator* allocator;
+} TrnGridBlock;
+
+/* Stored just before the cells of each row. Rows are shared by a grid and
+ * its snapshots, and copied on the first write by one of them. */
+typedef struct {
+    int references;
+    TrnGridBlock* block;
+} TrnGridRowHeader;
+
+#define ROW_HEADER_SIZE \
+    ((sizeof(TrnGridRowHeader) + TRN_GRID_ROW_ALIGNMENT - 1) & \
+     ~(size_t)(TRN_GRID_ROW_ALIGNMENT - 1))
+
+static TrnGridRowHeader* row_header(TrnGridCell * const row)
+{
+    return (TrnGridRowHeader*) (row - ROW_HEADER_SIZE);
+}
+
+static void release_block(TrnGridBlock * const block)
+{
+    if (--block->references == 0)
+        trn_allocator_release(block->allocator, block);
+}
+
+static void release_row(TrnGridCell * const row)
+{
+    TrnGridRowHeader * const header = row_header(row);
+    if (--header->references == 0)
+        release_block(header->block);
+}
+
+/* Lay a row out at cursor, its header followed by its cells. */
+static TrnGridCell* init_row(TrnGridBlock * const block, char * const cursor)
+{
+    TrnGridRowHeader * const header = (TrnGridRowHeader*) cursor;
+    header->references = 1;
+    header->block = block;
+    block->references++;
+    return (TrnGridCell*) cursor + ROW_HEADER_SIZE;
+}
+
+static TrnGridBlock* grid_block(TrnGrid const * const grid)
+{
+    return (TrnGridBlock*) ((char*) grid - align_size(sizeof(TrnGridBlock)));
+}
+
+/* Return the row at rowIndex, copying it first if it is shared. */
+static TrnGridCell* writable_row(TrnGrid * const grid, int const rowIndex)
+{
+    TrnGridCell * const row = grid->tetrominoTypes[rowIndex];
+    if (row_header(row)->references == 1)
+        return row;
+
+    /* Rows are copied with the allocator of the grid writing them, which may
+     * not be the one of the grid they were shared from. */
+    TrnAllocator * const allocator = grid_block(grid)->allocator;
+    size_t const blockSize = align_size(sizeof(TrnGridBlock));
+    void * const block =
+        trn_allocator_allocate(allocator,
+                               blockSize + ROW_HEADER_SIZE + grid->rowStride,
+                               TRN_GRID_ALIGNMENT);
+    if (!block)
+        abort();
+    ((TrnGridBlock*) block)->references = 0;
+    ((TrnGridBlock*) block)->allocator = allocator;
+
+    TrnGridCell * const copy = init_row((TrnGridBlock*) block,
+                                        (char*) block + blockSize);
+    memcpy(copy, row, grid->rowStride);
+    release_row(row);
+    grid->tetrominoTypes[rowIndex] = copy;
+    return copy;
+}
+
+static void clear_row_cells(TrnGrid * const grid, int const rowIndex)
+{
+    trn_grid_kernel_fill_row(writable_row(grid, rowIndex), grid->rowStride,
+                             grid->numberOfColumns, TRN_TETROMINO_VOID);
+    memset(row_bits(grid, rowIndex), 0,
+           sizeof(TrnGridRowBits) * grid->rowWords);
+    set_row_hash(grid, rowIndex, 0);
+}
+
+/* Bytes of cells per row, rows being aligned for the kernels. */
+static int row_stride_for(int const numberOfColumns)
+{
+    return (numberOfColumns + TRN_GRID_ROW_ALIGNMENT - 1) &
+           ~(TRN_GRID_ROW_ALIGNMENT - 1);
+}
+
+static int row_words_for(int const numberOfColumns)
+{
+    return numberOfColumns > 0 ?
+        (numberOfColumns + TRN_GRID_ROW_BITS_WIDTH - 1) /
+        TRN_GRID_ROW_BITS_WIDTH : 1;
+}
+
+/* Size of a grid block, with storage for its rows when withRows is true. */
+static size_t grid_block_size(int const numberOfRows,
+                              int const numberOfColumns,
+                              bool const withRows)
+{
+    return align_size(sizeof(TrnGridBlock)) + align_size(sizeof(TrnGrid)) +
+           align_size(sizeof(TrnGridCell*) * numberOfRows) +
+           align_size(sizeof(TrnGridRowBits) *
+                      row_words_for(numberOfColumns) * numberOfRows) +
+           align_size(sizeof(uint64_t) * numberOfRows) +
+           align_size(sizeof(int) * numberOfColumns) +
+           (withRows ? align_size((ROW_HEADER_SIZE +
+                                   row_stride_for(numberOfColumns)) *
+                                  numberOfRows) : 0);
+}
+
+/* Size of the block of a row copied on write. */
+static size_t row_block_size(int const numberOfColumns)
+{
+    return align_size(sizeof(TrnGridBlock)) + ROW_HEADER_SIZE +
+           row_stride_for(numberOfColumns);
+}
+
+size_t trn_grid_snapshot_block_size(int const numberOfRows,
+                                    int const numberOfColumns)
+{
+    size_t const snapshotSize =
+        grid_block_size(numberOfRows, numberOfColumns, false);
+    size_t const rowSize = row_block_size(numberOfColumns);
+    return snapshotSize > rowSize ? snapshotSize : rowSize;
+}
+
+/* Allocate a grid block, with storage for its rows when withRows is true. */
+static TrnGrid* allocate_grid(int const numberOfRows,
+                              int const numberOfColumns,
+                              bool const withRows,
+                              TrnAllocator * const allocator)
 {
+    /* The grid is a single cache aligned block:
+     *
+     *   | block | TrnGrid | row pointers | row bits | row hashes |
+     *   | column heights | rows |
+     *
+     * Row pointers are what makes the classical C-style 2D array, they also
+     * let line clears rotate rows instead of copying cells, and snapshots
+     * share rows. Each row is its header followed by its cells. */
+    size_t const blockSize = align_size(sizeof(TrnGridBlock));
+    size_t const headerSize = align_size(sizeof(TrnGrid));
+    int const rowStride = row_stride_for(numberOfColumns);
+    int const rowWords = row_words_for(numberOfColumns);
+    size_t const rowPointersSize =
+        align_size(sizeof(TrnGridCell*) * numberOfRows);
+    size_t const rowBitsSize =
+        align_size(sizeof(TrnGridRowBits) * rowWords * numberOfRows);
+    size_t const rowHashesSize =
+        align_size(sizeof(uint64_t) * numberOfRows);
+    size_t const columnHeightsSize =
+        align_size(sizeof(int) * numberOfColumns);
+
     /* Allocate grid */
-    TrnGrid* grid = (TrnGrid*) malloc(sizeof(TrnGrid));
+    void * const block =
+        trn_allocator_allocate(allocator,
+                               grid_block_size(numberOfRows, numberOfColumns,
+                                               withRows),
+                               TRN_GRID_ALIGNMENT);
+    if (!block)
+        return NULL;
+    ((TrnGridBlock*) block)->references = 1;
+    ((TrnGridBlock*) block)->allocator = allocator;
+
+    char* cursor = (char*) block + blockSize;
+    TrnGrid* grid = (TrnGrid*) cursor;
+    cursor += headerSize;
+    grid->tetrominoTypes = (TrnGridCell**) cursor;
+    cursor += rowPointersSize;
+    grid->rowBits = (TrnGridRowBits*) cursor;
+    cursor += rowBitsSize;
+    grid->rowHashes = (uint64_t*) cursor;
+    cursor += rowHashesSize;
+    grid->columnHeights = (int*) cursor;
+    cursor += columnHeightsSize;
 
     /* Set number of rows and columns */
     grid->numberOfRows = numberOfRows;
     grid->numberOfColumns = numberOfColumns;
+    grid->rowStride = rowStride;
+    grid->rowWords = rowWords;
 
-    /* Allocate a classical C-style 2D array: creates an array of numberOfRows
-     * pointers, each one pointing to contiguous memory of the column data. */
-    grid->tetrominoTypes = (TrnTetrominoType**)
-        malloc(sizeof(TrnTetrominoType*) * numberOfRows);
     int rowIndex;
-    for (rowIndex = 0 ; rowIndex < numberOfRows ; rowIndex++)
-    {
-        grid->tetrominoTypes[rowIndex] = (TrnTetrominoType*)
-            malloc(sizeof(TrnTetrominoType) * numberOfColumns);
+    for (rowIndex = 0 ; withRows && rowIndex < numberOfRows ; rowIndex++) {
+        grid->tetrominoTypes[rowIndex] =
+            init_row((TrnGridBlock*) block, cursor);
+        cursor += ROW_HEADER_SIZE + rowStride;
     }
 
-    /* clear grid, ie intialize it to TRN_TETROMINO_VOID */
+    int const lastWordColumns =
+        numberOfColumns - (rowWords - 1) * TRN_GRID_ROW_BITS_WIDTH;
+    if (lastWordColumns == TRN_GRID_ROW_BITS_WIDTH)
+        grid->fullRowBits = ~(TrnGridRowBits) 0;
+    else
+        grid->fullRowBits = ((TrnGridRowBits) 1 << lastWordColumns) - 1;
+
+    return grid;
+}
+
+TrnGrid* trn_grid_new(int const numberOfRows, int const numberOfColumns)
+{
+    return trn_grid_new_with_allocator(numberOfRows, numberOfColumns,
+                                       trn_allocator_heap());
+}
+
+TrnGrid* trn_grid_new_with_allocator(int const numberOfRows,
+                                     int const numberOfColumns,
+                                     TrnAllocator * const allocator)
+{
+    TrnGrid* grid = allocate_grid(numberOfRows, numberOfColumns, true,
+                                  allocator);
+    if (!grid)
+        return NULL;
+
+    /* clear grid, ie intialize it to TRN_TETROMINO_VOID, every row of it */
+    memset(grid->rowHashes, 0, sizeof(uint64_t) * numberOfRows);
+    grid->hash = 0;
+    grid->stackTopRowIndex = 0;
     trn_grid_clear(grid);
 
     return grid;
 }
 
+TrnGrid* trn_grid_snapshot(TrnGrid const * const grid)
+{
+    return trn_grid_snapshot_with_allocator(grid,
+                                            grid_block(grid)->allocator);
+}
+
+TrnGrid* trn_grid_snapshot_with_allocator(TrnGrid const * const grid,
+                                          TrnAllocator * const allocator)
+{
+    TrnGrid* snapshot = allocate_grid(grid->numberOfRows,
+                                      grid->numberOfColumns, false,
+                                      allocator);
+    if (!snapshot)
+        return NULL;
+
+    /* Share every row, copy the small per row and per column data. */
+    int rowIndex;
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++) {
+        snapshot->tetrominoTypes[rowIndex] = grid->tetrominoTypes[rowIndex];
+        row_header(grid->tetrominoTypes[rowIndex])->references++;
+    }
+    memcpy(snapshot->rowBits, grid->rowBits,
+           sizeof(TrnGridRowBits) * grid->rowWords * grid->numberOfRows);
+    memcpy(snapshot->rowHashes, grid->rowHashes,
+           sizeof(uint64_t) * grid->numberOfRows);
+    memcpy(snapshot->columnHeights, grid->columnHeights,
+           sizeof(int) * grid->numberOfColumns);
+    snapshot->hash = grid->hash;
+    snapshot->stackTopRowIndex = grid->stackTopRowIndex;
+
+    return snapshot;
+}
+
 void trn_grid_destroy(TrnGrid* grid)
 {
-    /* Deallocate C-style 2D array */
+    /* Rows may outlive the grid if a snapshot still shares them, in which
+     * case the block is freed with its last row. */
     int rowIndex;
     for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++)
-    {
-        free(grid->tetrominoTypes[rowIndex]);
+        release_row(grid->tetrominoTypes[rowIndex]);
+    release_block(grid_block(grid));
+}
+
+/* Image layout: the grid hash, the stack top, then the row bits, the row
+ * hashes, the column heights and the rows, each at a multiple of 8 bytes. */
+typedef struct {
+    uint64_t hash;
+    int32_t stackTopRowIndex;
+    int32_t padding;
+} TrnGridImageHeader;
+
+static size_t image_align(size_t const size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+size_t trn_grid_image_size(int const numberOfRows, int const numberOfColumns)
+{
+    return sizeof(TrnGridImageHeader) +
+           sizeof(TrnGridRowBits) * row_words_for(numberOfColumns) *
+           numberOfRows +
+           sizeof(uint64_t) * numberOfRows +
+           image_align(sizeof(int) * numberOfColumns) +
+           (size_t) row_stride_for(numberOfColumns) * numberOfRows;
+}
+
+void trn_grid_save_image(TrnGrid const * const grid, void * const image)
+{
+    size_t const rowBitsSize =
+        sizeof(TrnGridRowBits) * grid->rowWords * grid->numberOfRows;
+    size_t const rowHashesSize = sizeof(uint64_t) * grid->numberOfRows;
+    char* cursor = (char*) image;
+    TrnGridImageHeader header = {grid->hash, grid->stackTopRowIndex, 0};
+    int rowIndex;
+
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, grid->rowBits, rowBitsSize);
+    cursor += rowBitsSize;
+    memcpy(cursor, grid->rowHashes, rowHashesSize);
+    cursor += rowHashesSize;
+    memcpy(cursor, grid->columnHeights, sizeof(int) * grid->numberOfColumns);
+    cursor += image_align(sizeof(int) * grid->numberOfColumns);
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++) {
+        memcpy(cursor, grid->tetrominoTypes[rowIndex], grid->rowStride);
+        cursor += grid->rowStride;
     }
-    free(grid->tetrominoTypes);
+}
 
-    /* Deallocate grid */
-    free(grid);
+bool trn_grid_image_is_valid(int const numberOfRows,
+                             int const numberOfColumns,
+                             void const * const image)
+{
+    int const rowWords = row_words_for(numberOfColumns);
+    int const rowStride = row_stride_for(numberOfColumns);
+    char const * const rowBitsImage =
+        (char const*) image + sizeof(TrnGridImageHeader);
+    char const * const rowHashesImage =
+        rowBitsImage + sizeof(TrnGridRowBits) * rowWords * numberOfRows;
+    char const * const columnHeightsImage =
+        rowHashesImage + sizeof(uint64_t) * numberOfRows;
+    char const * const rowsImage =
+        columnHeightsImage + image_align(sizeof(int) * numberOfColumns);
+    TrnGridImageHeader header;
+    uint64_t hash = 0;
+    int stackTopRowIndex = numberOfRows;
+    int rowIndex, columnIndex, wordIndex;
+
+    /* Everything else is derived from the cells, and must match them: the
+     * grid trusts its occupancy, heights and hashes, eg to index columns. */
+    for (rowIndex = 0 ; rowIndex < numberOfRows ; rowIndex++) {
+        TrnGridCell const * const cells =
+            (TrnGridCell const*) (rowsImage + (size_t) rowStride * rowIndex);
+        uint64_t rowHash = 0, savedRowHash;
+        for (wordIndex = 0 ; wordIndex < rowWords ; wordIndex++) {
+            TrnGridRowBits bits = 0, savedBits;
+            int const firstColumnIndex = wordIndex * TRN_GRID_ROW_BITS_WIDTH;
+            for (columnIndex = firstColumnIndex ;
+                 columnIndex < numberOfColumns &&
+                 columnIndex < firstColumnIndex + TRN_GRID_ROW_BITS_WIDTH ;
+                 columnIndex++) {
+                TrnGridCell const type = cells[columnIndex];
+                if (type > TRN_TETROMINO_VOID)
+                    return false;
+                if (type == TRN_TETROMINO_VOID)
+                    continue;
+                bits |= (TrnGridRowBits) 1 <<
+                        (columnIndex - firstColumnIndex);
+                rowHash ^= trn_zobrist_cell_key(columnIndex,
+                                                (TrnTetrominoType) type);
+            }
+            memcpy(&savedBits, rowBitsImage + sizeof(TrnGridRowBits) *
+                   ((size_t) rowWords * rowIndex + wordIndex),
+                   sizeof(savedBits));
+            if (savedBits != bits)
+                return false;
+            if (bits && stackTopRowIndex == numberOfRows)
+                stackTopRowIndex = rowIndex;
+        }
+        memcpy(&savedRowHash, rowHashesImage + sizeof(uint64_t) * rowIndex,
+               sizeof(savedRowHash));
+        if (savedRowHash != rowHash)
+            return false;
+        hash ^= trn_zobrist_row_key(rowIndex, rowHash);
+    }
+
+    for (columnIndex = 0 ; columnIndex < numberOfColumns ; columnIndex++) {
+        int height = 0, savedHeight;
+        for (rowIndex = stackTopRowIndex ; rowIndex < numberOfRows ;
+             rowIndex++) {
+            if (rowsImage[(size_t) rowStride * rowIndex + columnIndex] !=
+                TRN_TETROMINO_VOID) {
+                height = numberOfRows - rowIndex;
+                break;
+            }
+        }
+        memcpy(&savedHeight, columnHeightsImage + sizeof(int) * columnIndex,
+               sizeof(savedHeight));
+        if (savedHeight != height)
+            return false;
+    }
+
+    memcpy(&header, image, sizeof(header));
+    return header.stackTopRowIndex == stackTopRowIndex &&
+           header.hash == hash;
+}
+
+void trn_grid_restore_image(TrnGrid * const grid, void const * const image)
+{
+    size_t const rowBitsSize =
+        sizeof(TrnGridRowBits) * grid->rowWords * grid->numberOfRows;
+    size_t const rowHashesSize = sizeof(uint64_t) * grid->numberOfRows;
+    char const* cursor = (char const*) image;
+    TrnGridImageHeader header;
+    int rowIndex;
+
+    memcpy(&header, cursor, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(grid->rowBits, cursor, rowBitsSize);
+    cursor += rowBitsSize;
+    memcpy(grid->rowHashes, cursor, rowHashesSize);
+    cursor += rowHashesSize;
+    memcpy(grid->columnHeights, cursor, sizeof(int) * grid->numberOfColumns);
+    cursor += image_align(sizeof(int) * grid->numberOfColumns);
+
+    /* Rows above both stack tops are void in the grid and in the image. */
+    int firstRowIndex = header.stackTopRowIndex < grid->stackTopRowIndex ?
+                        header.stackTopRowIndex : grid->stackTopRowIndex;
+    if (firstRowIndex < 0)
+        firstRowIndex = 0;
+    cursor += (size_t) grid->rowStride * firstRowIndex;
+    for (rowIndex = firstRowIndex ; rowIndex < grid->numberOfRows ;
+         rowIndex++) {
+        memcpy(writable_row(grid, rowIndex), cursor, grid->rowStride);
+        cursor += grid->rowStride;
+    }
+    grid->hash = header.hash;
+    grid->stackTopRowIndex = header.stackTopRowIndex;
 }
 
 void trn_grid_clear(TrnGrid * const grid)
@@ -50,24 +656,104 @@ void trn_grid_fill(TrnGrid * const grid, TrnTetrominoType type)
 {
     int rowIndex;
     int columnIndex;
-    for (rowIndex = 0 ; rowIndex < grid->numberOfRows; rowIndex++) {
-        for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++) {
-            grid->tetrominoTypes[rowIndex][columnIndex] = type;
-        }
+    int wordIndex;
+    bool const isVoid = type == TRN_TETROMINO_VOID;
+    uint64_t rowHash = 0;
+    for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++)
+        rowHash ^= trn_zobrist_cell_key(columnIndex, type);
+
+    /* Rows above the stack top are already void. */
+    for (rowIndex = isVoid ? grid->stackTopRowIndex : 0 ;
+         rowIndex < grid->numberOfRows;
+         rowIndex++)
+    {
+        trn_grid_kernel_fill_row(writable_row(grid, rowIndex),
+                                 grid->rowStride, grid->numberOfColumns, type);
+        TrnGridRowBits * const bits = row_bits(grid, rowIndex);
+        for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++)
+            bits[wordIndex] = isVoid ? 0 : full_word_bits(grid, wordIndex);
+        grid->rowHashes[rowIndex] = rowHash;
     }
+    grid->stackTopRowIndex = isVoid ? grid->numberOfRows : 0;
+    update_grid_hash(grid);
+    for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++)
+        grid->columnHeights[columnIndex] = isVoid ? 0 : grid->numberOfRows;
 }
 
 void trn_grid_set_cell(TrnGrid * const grid,
                        TrnPositionInGrid const pos,
                        TrnTetrominoType const type)
 {
-    grid->tetrominoTypes[pos.rowIndex][pos.columnIndex] = type;
+    TrnGridRowBits * const word = row_bits(grid, pos.rowIndex) +
+                                  pos.columnIndex / TRN_GRID_ROW_BITS_WIDTH;
+    TrnGridRowBits const bit =
+        (TrnGridRowBits) 1 << (pos.columnIndex % TRN_GRID_ROW_BITS_WIDTH);
+
+    update_cell_hash(grid, pos, trn_grid_get_cell(grid, pos), type);
+    writable_row(grid, pos.rowIndex)[pos.columnIndex] = type;
+    if (type == TRN_TETROMINO_VOID)
+        *word &= ~bit;
+    else
+        *word |= bit;
+    update_stack_top_with_row(grid, pos.rowIndex, type);
+    update_column_height(grid, pos, type);
 }
 
 TrnTetrominoType trn_grid_get_cell(TrnGrid const *  const grid,
                                    TrnPositionInGrid const pos)
 {
-    return grid->tetrominoTypes[pos.rowIndex][pos.columnIndex];
+    return (TrnTetrominoType)
+        grid->tetrominoTypes[pos.rowIndex][pos.columnIndex];
+}
+
+uint64_t trn_grid_hash(TrnGrid const * const grid)
+{
+    return grid->hash;
+}
+
+static uint64_t compute_row_hash(TrnGrid const * const grid,
+                                 int const rowIndex)
+{
+    uint64_t rowHash = 0;
+    TrnPositionInGrid pos;
+    pos.rowIndex = rowIndex;
+    for (pos.columnIndex = 0 ; pos.columnIndex < grid->numberOfColumns ;
+         pos.columnIndex++) {
+        rowHash ^= trn_zobrist_cell_key(pos.columnIndex,
+                                        trn_grid_get_cell(grid, pos));
+    }
+    return rowHash;
+}
+
+uint64_t trn_grid_compute_hash(TrnGrid const * const grid)
+{
+    uint64_t hash = 0;
+    int rowIndex;
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++)
+        hash ^= trn_zobrist_row_key(rowIndex, compute_row_hash(grid, rowIndex));
+    return hash;
+}
+
+void trn_grid_refresh_occupancy(TrnGrid * const grid)
+{
+    int rowIndex;
+    int wordIndex;
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++) {
+        for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++) {
+            int const offset = wordIndex * TRN_GRID_ROW_BITS_WIDTH;
+            int const stride = grid->rowStride - offset;
+            row_bits(grid, rowIndex)[wordIndex] =
+                trn_grid_kernel_row_occupancy(
+                    grid->tetrominoTypes[rowIndex] + offset,
+                    stride < TRN_GRID_ROW_BITS_WIDTH ?
+                    stride : TRN_GRID_ROW_BITS_WIDTH);
+        }
+    }
+    for (rowIndex = 0 ; rowIndex < grid->numberOfRows ; rowIndex++)
+        grid->rowHashes[rowIndex] = compute_row_hash(grid, rowIndex);
+    update_stack_top(grid, 0);
+    update_column_heights(grid);
+    update_grid_hash(grid);
 }
 
 void trn_grid_remove_piece(TrnGrid * const grid,
@@ -87,14 +773,48 @@ void trn_grid_set_cells_with_piece(TrnGrid * const grid,
                                    TrnTetrominoType const type)
 {
     int squareIndex;
+    int rowIndex;
     TrnPositionInGrid pos;
+    TrnTetrominoShape const * const shape = piece_shape(piece);
 
+    /* Update the bitboard one piece row at a time... */
+    for (rowIndex = shape->firstRowIndex ;
+         rowIndex <= shape->lastRowIndex ;
+         rowIndex++)
+    {
+        TrnGridRowBits placed[2];
+        int const wordIndex = place_mask(shape->rowMasks[rowIndex],
+                                         piece->topLeftCorner.columnIndex,
+                                         placed);
+        int const gridRowIndex = piece->topLeftCorner.rowIndex + rowIndex;
+        TrnGridRowBits * const bits = row_bits(grid, gridRowIndex) + wordIndex;
+        if (type == TRN_TETROMINO_VOID) {
+            bits[0] &= ~placed[0];
+            if (placed[1])
+                bits[1] &= ~placed[1];
+        } else {
+            bits[0] |= placed[0];
+            if (placed[1])
+                bits[1] |= placed[1];
+        }
+    }
+    update_stack_top_with_row(grid,
+                              piece->topLeftCorner.rowIndex +
+                              shape->firstRowIndex,
+                              type);
+
+    /* ... then the tetromino types. */
     for (squareIndex = 0 ; 
          squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
          squareIndex++)
     {
-        pos = trn_piece_position_in_grid(piece, squareIndex);
-        trn_grid_set_cell(grid, pos, type);
+        pos.rowIndex = piece->topLeftCorner.rowIndex +
+                       shape->squares[squareIndex].rowIndex;
+        pos.columnIndex = piece->topLeftCorner.columnIndex +
+                          shape->squares[squareIndex].columnIndex;
+        update_cell_hash(grid, pos, trn_grid_get_cell(grid, pos), type);
+        writable_row(grid, pos.rowIndex)[pos.columnIndex] = type;
+        update_column_height(grid, pos, type);
     }
 }
 
@@ -109,26 +829,86 @@ bool trn_grid_cell_is_in_grid_and_is_void(TrnGrid const * const grid,
                                           TrnPositionInGrid const pos)
 {
     return trn_grid_cell_is_in_grid(grid,pos) &&
-           trn_grid_get_cell(grid, pos) == TRN_TETROMINO_VOID;
+           !(row_bits(grid, pos.rowIndex)[pos.columnIndex /
+                                          TRN_GRID_ROW_BITS_WIDTH] &
+             ((TrnGridRowBits) 1 << (pos.columnIndex %
+                                     TRN_GRID_ROW_BITS_WIDTH)));
 }
 
-bool trn_grid_can_set_cells_with_piece(TrnGrid * const grid,
+bool trn_grid_can_set_cells_with_piece(TrnGrid const * const grid,
                                        TrnPiece const * const piece)
 {
-    int squareIndex;
-    TrnPositionInGrid pos;
+    TrnTetrominoShape const * const shape = piece_shape(piece);
+    int const topRowIndex = piece->topLeftCorner.rowIndex;
+    int const leftColumnIndex = piece->topLeftCorner.columnIndex;
+    int rowIndex;
 
-    for (squareIndex = 0 ; 
-         squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
-         squareIndex++)
+    // Range tests on the piece extent...
+    if (topRowIndex + shape->firstRowIndex < 0 ||
+        topRowIndex + shape->lastRowIndex >= grid->numberOfRows ||
+        leftColumnIndex + shape->firstColumnIndex < 0 ||
+        leftColumnIndex + shape->lastColumnIndex >= grid->numberOfColumns)
+        return false;
+
+    // ... then one AND per piece row, two when it straddles two words.
+    for (rowIndex = shape->firstRowIndex ;
+         rowIndex <= shape->lastRowIndex ;
+         rowIndex++)
     {
-        pos = trn_piece_position_in_grid(piece, squareIndex);
-        if (! trn_grid_cell_is_in_grid_and_is_void(grid,pos) ) return false;
+        TrnGridRowBits placed[2];
+        int const wordIndex = place_mask(shape->rowMasks[rowIndex],
+                                         leftColumnIndex, placed);
+        TrnGridRowBits const * const bits =
+            row_bits(grid, topRowIndex + rowIndex) + wordIndex;
+        if ((bits[0] & placed[0]) || (placed[1] && (bits[1] & placed[1])))
+            return false;
     }
 
     return true;
 }
 
+int trn_grid_drop_distance(TrnGrid const * const grid,
+                           TrnPiece const * const piece)
+{
+    TrnTetrominoShape const * const shape = piece_shape(piece);
+    int distance = grid->numberOfRows;
+    int columnIndex;
+
+    /* A column of the piece whose lowest square is above the highest cell of
+     * the grid column only has void cells below it, down to that cell. */
+    for (columnIndex = shape->firstColumnIndex ;
+         columnIndex <= shape->lastColumnIndex ;
+         columnIndex++)
+    {
+        if (shape->columnBottoms[columnIndex] < 0)
+            continue;
+        int const gridColumnIndex =
+            piece->topLeftCorner.columnIndex + columnIndex;
+        int const bottomRowIndex =
+            piece->topLeftCorner.rowIndex + shape->columnBottoms[columnIndex];
+        int const floorRowIndex =
+            grid->numberOfRows - grid->columnHeights[gridColumnIndex];
+        if (bottomRowIndex >= floorRowIndex) {
+            distance = -1;
+            break;
+        }
+        if (floorRowIndex - 1 - bottomRowIndex < distance)
+            distance = floorRowIndex - 1 - bottomRowIndex;
+    }
+    if (distance >= 0)
+        return distance;
+
+    /* The piece is under an overhang: scan the bitboard one row at a time. */
+    TrnPiece dropped = *piece;
+    distance = 0;
+    dropped.topLeftCorner.rowIndex++;
+    while (trn_grid_can_set_cells_with_piece(grid, &dropped)) {
+        distance++;
+        dropped.topLeftCorner.rowIndex++;
+    }
+    return distance;
+}
+
 bool trn_grid_equal(TrnGrid const * const left, TrnGrid const * const right)
 {
     // Compare grid dimensions.
@@ -137,20 +917,31 @@ bool trn_grid_equal(TrnGrid const * const left, TrnGrid const * const right)
     if (left->numberOfColumns != right->numberOfColumns)
         return false;
 
-    // Compare grid values.
-    TrnPositionInGrid pos;
+    // Different hashes mean different grids.
+    if (left->hash != right->hash)
+        return false;
+
+    // Rows above the stack top are void in both grids.
+    if (left->stackTopRowIndex != right->stackTopRowIndex)
+        return false;
+    int const firstRowIndex = left->stackTopRowIndex;
+
+    // Compare occupancy first, it is cheaper than the tetromino types.
     int rowIndex;
-    int columnIndex;
+    for (rowIndex = firstRowIndex ; rowIndex < left->numberOfRows ;
+         rowIndex++) {
+        if (memcmp(row_bits(left, rowIndex), row_bits(right, rowIndex),
+                   sizeof(TrnGridRowBits) * left->rowWords))
+            return false;
+    }
 
-    for (rowIndex = 0 ; rowIndex < left->numberOfRows ; rowIndex++) {
-        pos.rowIndex = rowIndex;
-        for (columnIndex = 0 ; columnIndex < left->numberOfColumns ; columnIndex++) {
-            pos.columnIndex = columnIndex;
-            if (trn_grid_get_cell(left, pos) != trn_grid_get_cell(right,pos)) {
-               printf("sameGrid: (%u,%u): %u VS %u\n",pos.rowIndex, pos.columnIndex, trn_grid_get_cell(left, pos), trn_grid_get_cell(right,pos));
-               return false; 
-            }
-        }
+    // Compare grid values.
+    for (rowIndex = firstRowIndex ; rowIndex < left->numberOfRows ;
+         rowIndex++) {
+        if (!trn_grid_kernel_rows_equal(left->tetrominoTypes[rowIndex],
+                                        right->tetrominoTypes[rowIndex],
+                                        left->rowStride))
+            return false;
     }
     return true;
 }
@@ -197,21 +988,7 @@ void trn_grid_print(TrnGrid const * const grid)
 
 bool trn_grid_is_row_complete(TrnGrid const * const grid, int const rowIndex)
 {
-    int columnIndex;
-
-    TrnPositionInGrid pos;
-    pos.rowIndex = rowIndex;
-
-    TrnTetrominoType type;
-
-    for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++) {
-        pos.columnIndex = columnIndex;
-        type = trn_grid_get_cell(grid, pos);
-        if (type == TRN_TETROMINO_VOID)
-            return false;
-    }
-
-    return true;
+    return row_is_complete(grid, rowIndex);
 }
 
 void trn_grid_copy_row_bellow(TrnGrid * const grid, int const rowIndex)
@@ -222,6 +999,7 @@ void trn_grid_copy_row_bellow(TrnGrid * const grid, int const rowIndex)
   top_pos.rowIndex = rowIndex;
   bottom_pos.rowIndex = rowIndex+1;
 
+  TrnGridCell * const bottom_row = writable_row(grid, bottom_pos.rowIndex);
   int columnIndex;
   TrnTetrominoType top_type;
 
@@ -229,29 +1007,125 @@ void trn_grid_copy_row_bellow(TrnGrid * const grid, int const rowIndex)
       top_pos.columnIndex = columnIndex;
       bottom_pos.columnIndex = columnIndex;
       top_type = trn_grid_get_cell(grid, top_pos);
-      trn_grid_set_cell(grid, bottom_pos, top_type);
+      bottom_row[columnIndex] = top_type;
   }
+  copy_row_bits(grid, bottom_pos.rowIndex, top_pos.rowIndex);
+  set_row_hash(grid, bottom_pos.rowIndex, grid->rowHashes[top_pos.rowIndex]);
+  if (bottom_pos.rowIndex < grid->stackTopRowIndex)
+    grid->stackTopRowIndex = bottom_pos.rowIndex;
+  update_stack_top(grid, grid->stackTopRowIndex);
+  update_column_heights(grid);
 }
 
 void trn_grid_pop_row_and_make_above_fall(TrnGrid * const grid,
                                           int const rowIndexToPop)
 {
-  int rowIndex;
-  for (rowIndex = rowIndexToPop-1 ; rowIndex >= 0 ; rowIndex-- ) {
-    trn_grid_copy_row_bellow(grid, rowIndex);
-  }
+  /* Rotate rows [stack top, rowIndexToPop] by one: rows above fall of one
+   * row and the popped row, once cleared, takes the place of the stack top.
+   * Rows above the stack top are void and stay in place. */
+  int const topRowIndex = grid->stackTopRowIndex < rowIndexToPop ?
+                          grid->stackTopRowIndex : rowIndexToPop;
+  int const fallingRows = rowIndexToPop - topRowIndex;
+  TrnGridCell* poppedRow = grid->tetrominoTypes[rowIndexToPop];
+  memmove(grid->tetrominoTypes + topRowIndex + 1,
+          grid->tetrominoTypes + topRowIndex,
+          sizeof(TrnGridCell*) * fallingRows);
+  memmove(row_bits(grid, topRowIndex + 1), row_bits(grid, topRowIndex),
+          sizeof(TrnGridRowBits) * grid->rowWords * fallingRows);
+  memmove(grid->rowHashes + topRowIndex + 1, grid->rowHashes + topRowIndex,
+          sizeof(uint64_t) * fallingRows);
+  grid->tetrominoTypes[topRowIndex] = poppedRow;
 
-  int firstRowIndex = 0;
-  trn_grid_clear_row(grid,firstRowIndex);
+  clear_row_cells(grid, topRowIndex);
+  update_stack_top(grid, topRowIndex);
+  update_column_heights(grid);
+  update_grid_hash(grid);
 }
 
-int trn_grid_pop_first_complete_rows_block()
+int trn_grid_pop_first_complete_rows_block(TrnGrid * const grid,
+                                           int poppedRowIndices[])
+{
+    return trn_grid_pop_complete_rows_in_range(grid, 0, grid->numberOfRows-1,
+                                               poppedRowIndices);
+}
+
+int trn_grid_pop_complete_rows_in_range(TrnGrid * const grid,
+                                        int const firstRowIndex,
+                                        int const lastRowIndex,
+                                        int poppedRowIndices[])
 {
     int number_of_poped_rows = 0;
-    /* ... pop row blocs ... */
+    int const lastCheckedRowIndex = lastRowIndex < grid->numberOfRows ?
+                                    lastRowIndex : grid->numberOfRows-1;
+    int destinationRowIndex = lastCheckedRowIndex;
+    int rowIndex;
+
+    int const topRowIndex = grid->stackTopRowIndex;
+
+    /* Single bottom-up pass up to the stack top: incomplete rows are swapped
+     * down to their final position, which leaves the popped rows storage at
+     * the stack top. Rows above it are void and stay in place. */
+    for (rowIndex = lastCheckedRowIndex ; rowIndex >= topRowIndex ;
+         rowIndex--) {
+        if (rowIndex >= firstRowIndex && row_is_complete(grid, rowIndex)) {
+            if (poppedRowIndices)
+                poppedRowIndices[number_of_poped_rows] = rowIndex;
+            number_of_poped_rows++;
+            continue;
+        }
+        /* Nothing to pop in the range, the rows above stay in place. */
+        if (rowIndex < firstRowIndex && number_of_poped_rows == 0)
+            return 0;
+        if (destinationRowIndex != rowIndex) {
+            TrnGridCell* row = grid->tetrominoTypes[destinationRowIndex];
+            grid->tetrominoTypes[destinationRowIndex] =
+                grid->tetrominoTypes[rowIndex];
+            grid->tetrominoTypes[rowIndex] = row;
+            copy_row_bits(grid, destinationRowIndex, rowIndex);
+            grid->rowHashes[destinationRowIndex] = grid->rowHashes[rowIndex];
+        }
+        destinationRowIndex--;
+    }
+    if (number_of_poped_rows == 0)
+        return 0;
+
+    for (rowIndex = topRowIndex ;
+         rowIndex < topRowIndex + number_of_poped_rows ;
+         rowIndex++)
+        clear_row_cells(grid, rowIndex);
+    update_stack_top(grid, topRowIndex + number_of_poped_rows);
+    update_column_heights(grid);
+    update_grid_hash(grid);
+
     return number_of_poped_rows;
 }
 
+int trn_grid_row_filled_count(TrnGrid const * const grid, int const rowIndex)
+{
+    TrnGridRowBits const * const bits = row_bits(grid, rowIndex);
+    int count = 0;
+    int wordIndex;
+    for (wordIndex = 0 ; wordIndex < grid->rowWords ; wordIndex++)
+        count += count_bits(bits[wordIndex]);
+    return count;
+}
+
+int trn_grid_column_height(TrnGrid const * const grid, int const columnIndex)
+{
+    return grid->columnHeights[columnIndex];
+}
+
+TrnGridRowBits const* trn_grid_row_bits(TrnGrid const * const grid,
+                                        int const rowIndex)
+{
+    return row_bits(grid, rowIndex);
+}
+
+int trn_grid_stack_top_row_index(TrnGrid const * const grid)
+{
+    return grid->stackTopRowIndex;
+}
+
 /* Return -1 if no complete row */
 int tnr_grid_find_last_complete_row_index(TrnGrid const * const grid)
 {
@@ -265,11 +1139,7 @@ int tnr_grid_find_last_complete_row_index(TrnGrid const * const grid)
 
 void trn_grid_clear_row(TrnGrid * const grid, int const rowIndex)
 {
-  TrnPositionInGrid pos;
-  pos.rowIndex = rowIndex;
-  int columnIndex;
-  for (columnIndex = 0 ; columnIndex < grid->numberOfColumns ; columnIndex++) {
-    pos.columnIndex = columnIndex;
-    trn_grid_set_cell(grid, pos, TRN_TETROMINO_VOID);
-  }
+  clear_row_cells(grid, rowIndex);
+  update_stack_top_with_row(grid, rowIndex, TRN_TETROMINO_VOID);
+  update_column_heights(grid);
 }
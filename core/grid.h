@@ -2,20 +2,87 @@
 #define TRN_GRID_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "tetromino.h"
 #include "piece.h"
-
+#include "allocator.h"
+#include "grid_kernels.h"
+
+/* Alignment of the grid storage, one cache line. */
+#define TRN_GRID_ALIGNMENT 64
+
+/* The grid keeps two planes: the occupancy bitboard (rowWords words per row,
+ * a single one up to 64 columns), used for collision and row completion, and
+ * the tetromino types, one byte per cell, only needed to know the color of
+ * each cell. Column heights (number of rows from the bottom up to the highest
+ * occupied cell) are kept up to date along the way, as well as a Zobrist hash
+ * of the cells.
+ *
+ * Rows above stackTopRowIndex, the highest row holding an occupied cell, are
+ * all void and skipped by clears, line clears and comparisons, so that their
+ * cost depends on the occupied rows rather than on the grid height. */
 typedef struct {
-    TrnTetrominoType** tetrominoTypes;
+    TrnGridCell** tetrominoTypes;
+    TrnGridRowBits* rowBits;
+    TrnGridRowBits fullRowBits; /* last word of a complete row */
+    uint64_t* rowHashes;
+    uint64_t hash;
+    int* columnHeights;
+    int stackTopRowIndex; /* numberOfRows when the grid is empty */
     int numberOfRows;
     int numberOfColumns;
+    int rowStride;
+    int rowWords;
 } TrnGrid;
 
 TrnGrid* trn_grid_new(int const numberOfRows, int const numberOfColumns);
 
+/* Same as trn_grid_new, the grid, its rows and its snapshots being allocated
+ * with allocator. The allocator must outlive the grid and its snapshots. */
+TrnGrid* trn_grid_new_with_allocator(int const numberOfRows,
+                                     int const numberOfColumns,
+                                     TrnAllocator * const allocator);
+
+/* Return a grid equal to grid that shares its rows: a row is only copied when
+ * the grid or the snapshot first writes it, so the cost of a snapshot and of
+ * the following changes depends on the number of rows changed. Snapshots are
+ * destroyed with trn_grid_destroy, in any order. A grid and its snapshots
+ * must be used from a single thread, and cells must not be written directly
+ * through tetrominoTypes once shared. */
+TrnGrid* trn_grid_snapshot(TrnGrid const * const grid);
+
+/* Same as trn_grid_snapshot, the snapshot and the rows it copies being
+ * allocated with allocator rather than with the one of grid, eg a pool of
+ * blocks of trn_grid_snapshot_block_size. */
+TrnGrid* trn_grid_snapshot_with_allocator(TrnGrid const * const grid,
+                                          TrnAllocator * const allocator);
+
+/* Largest allocation of a snapshot of a grid of this size: the snapshot
+ * itself, or a row it copies. */
+size_t trn_grid_snapshot_block_size(int const numberOfRows,
+                                    int const numberOfColumns);
+
 void trn_grid_destroy(TrnGrid* grid);
 
+/* Flat image of a grid, eg for checkpoints: its cells, occupancy, row hashes
+ * and column heights, laid out as in the grid so that saving and restoring
+ * are a few copies. Images are in native byte order. */
+size_t trn_grid_image_size(int const numberOfRows, int const numberOfColumns);
+
+void trn_grid_save_image(TrnGrid const * const grid, void * const image);
+
+/* Whether an image of a grid of this size, eg read from a file, holds cells
+ * in range and the occupancy, hashes, column heights and stack top of these
+ * cells, so that the restored grid is consistent. */
+bool trn_grid_image_is_valid(int const numberOfRows,
+                             int const numberOfColumns,
+                             void const * const image);
+
+/* Restore an image saved from a grid of the same size, without allocating
+ * unless rows are shared with snapshots. The image must be valid. */
+void trn_grid_restore_image(TrnGrid * const grid, void const * const image);
+
 void trn_grid_clear(TrnGrid * const grid);
 
 void trn_grid_fill(TrnGrid * const grid, TrnTetrominoType type);
@@ -27,6 +94,16 @@ void trn_grid_set_cell(TrnGrid * const grid,
 TrnTetrominoType trn_grid_get_cell(TrnGrid const * const grid,
                                    TrnPositionInGrid const pos);
 
+/* Return the Zobrist hash of the grid, kept up to date by every change. */
+uint64_t trn_grid_hash(TrnGrid const * const grid);
+
+/* Compute the Zobrist hash from scratch, to validate trn_grid_hash. */
+uint64_t trn_grid_compute_hash(TrnGrid const * const grid);
+
+/* Recompute the bitboard, the column heights and the hash from the cells,
+ * after cells have been written directly through tetrominoTypes. */
+void trn_grid_refresh_occupancy(TrnGrid * const grid);
+
 void trn_grid_set_cells_with_piece(TrnGrid * const grid,
                                    TrnPiece const * const piece,
                                    TrnTetrominoType const type);
@@ -44,8 +121,14 @@ void trn_grid_remove_piece(TrnGrid * const grid,
 void trn_grid_fill_piece(TrnGrid * const grid,
                          TrnPiece const * const piece);
   
-bool trn_grid_can_set_cells_with_piece(TrnGrid * const grid,
-                                       TrnPiece const *  const piece);
+bool trn_grid_can_set_cells_with_piece(TrnGrid const * const grid,
+                                       TrnPiece const * const piece);
+
+/* Return how many rows piece, which fits in grid, can fall. Column heights
+ * give it at once when the piece is above the stack, otherwise the bitboard
+ * is scanned down from the piece. */
+int trn_grid_drop_distance(TrnGrid const * const grid,
+                           TrnPiece const * const piece);
 
 bool trn_grid_equal(TrnGrid const * const left, TrnGrid const * const right);
 
@@ -58,7 +141,32 @@ void trn_grid_copy_row_bellow(TrnGrid * const grid, int const rowIndex);
 void trn_grid_pop_row_and_make_above_fall(TrnGrid * const grid,
                                           int const rowIndexToPop);
 
-int trn_grid_pop_first_complete_rows_block();
+/* Pop every complete row and make the rows above fall, in a single pass.
+ * When poppedRowIndices is not NULL, it must have room for numberOfRows
+ * indices and receives the popped row indices, from bottom to top.
+ * Return the number of popped rows. */
+int trn_grid_pop_first_complete_rows_block(TrnGrid * const grid,
+                                           int poppedRowIndices[]);
+
+/* Same as trn_grid_pop_first_complete_rows_block, but only rows within
+ * [firstRowIndex, lastRowIndex] are checked, eg the rows of a locked piece. */
+int trn_grid_pop_complete_rows_in_range(TrnGrid * const grid,
+                                        int const firstRowIndex,
+                                        int const lastRowIndex,
+                                        int poppedRowIndices[]);
+
+int trn_grid_row_filled_count(TrnGrid const * const grid, int const rowIndex);
+
+int trn_grid_column_height(TrnGrid const * const grid, int const columnIndex);
+
+/* Return the rowWords occupancy words of a row, column c being bit c % 64 of
+ * word c / 64. */
+TrnGridRowBits const* trn_grid_row_bits(TrnGrid const * const grid,
+                                        int const rowIndex);
+
+/* Return the index of the highest row holding an occupied cell, or
+ * numberOfRows when the grid is empty. */
+int trn_grid_stack_top_row_index(TrnGrid const * const grid);
 
 int tnr_grid_find_last_complete_row_index(TrnGrid const * const grid);
 
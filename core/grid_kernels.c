@@ -0,0 +1,234 @@
+#include "grid_kernels.h"
+#include "tetromino.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define TRN_GRID_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#ifndef TRN_GRID_KERNELS_X86
+
+/* Scalar kernels, used when no vector instruction set is available. */
+
+static void fill_row_scalar(TrnGridCell * const row, int const rowStride,
+                            int const numberOfColumns,
+                            TrnGridCell const value)
+{
+    memset(row, value, numberOfColumns);
+    memset(row + numberOfColumns, TRN_TETROMINO_VOID,
+           rowStride - numberOfColumns);
+}
+
+static bool rows_equal_scalar(TrnGridCell const * const left,
+                              TrnGridCell const * const right,
+                              int const rowStride)
+{
+    return memcmp(left, right, rowStride) == 0;
+}
+
+static TrnGridRowBits row_occupancy_scalar(TrnGridCell const * const row,
+                                           int const rowStride)
+{
+    TrnGridRowBits bits = 0;
+    int columnIndex;
+    for (columnIndex = 0 ;
+         columnIndex < rowStride && columnIndex < 64 ;
+         columnIndex++)
+    {
+        if (row[columnIndex] != TRN_TETROMINO_VOID)
+            bits |= (TrnGridRowBits) 1 << columnIndex;
+    }
+    return bits;
+}
+
+#else
+
+/* Number of leading cells of a chunk of width cells, starting at offset, that
+ * belong to the row. */
+static int cells_in_chunk(int const numberOfColumns, int const offset,
+                          int const width)
+{
+    int const count = numberOfColumns - offset;
+    if (count < 0)
+        return 0;
+    return count < width ? count : width;
+}
+
+/* SSE2 kernels, 16 cells at a time. Rows are 16 bytes aligned. */
+
+static void fill_chunks_sse2(TrnGridCell * const row, int const firstOffset,
+                             int const rowStride, int const numberOfColumns,
+                             TrnGridCell const value)
+{
+    __m128i const lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                        8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i const filled = _mm_set1_epi8((char) value);
+    __m128i const empty = _mm_set1_epi8(TRN_TETROMINO_VOID);
+    int offset;
+
+    for (offset = firstOffset ; offset < rowStride ; offset += 16) {
+        __m128i const limit =
+            _mm_set1_epi8((char) cells_in_chunk(numberOfColumns, offset, 16));
+        __m128i const inside = _mm_cmplt_epi8(lanes, limit);
+        _mm_store_si128((__m128i*) (row + offset),
+                        _mm_or_si128(_mm_and_si128(inside, filled),
+                                     _mm_andnot_si128(inside, empty)));
+    }
+}
+
+static void fill_row_sse2(TrnGridCell * const row, int const rowStride,
+                          int const numberOfColumns, TrnGridCell const value)
+{
+    fill_chunks_sse2(row, 0, rowStride, numberOfColumns, value);
+}
+
+static bool rows_equal_sse2(TrnGridCell const * const left,
+                            TrnGridCell const * const right,
+                            int const rowStride)
+{
+    int offset;
+    for (offset = 0 ; offset < rowStride ; offset += 16) {
+        __m128i const l = _mm_load_si128((__m128i const*) (left + offset));
+        __m128i const r = _mm_load_si128((__m128i const*) (right + offset));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF)
+            return false;
+    }
+    return true;
+}
+
+static TrnGridRowBits occupancy_chunks_sse2(TrnGridCell const * const row,
+                                            int const firstOffset,
+                                            int const rowStride)
+{
+    __m128i const empty = _mm_set1_epi8(TRN_TETROMINO_VOID);
+    TrnGridRowBits bits = 0;
+    int offset;
+
+    for (offset = firstOffset ; offset < rowStride && offset < 64 ;
+         offset += 16) {
+        __m128i const cells = _mm_load_si128((__m128i const*) (row + offset));
+        int const voids = _mm_movemask_epi8(_mm_cmpeq_epi8(cells, empty));
+        bits |= (TrnGridRowBits) (~voids & 0xFFFF) << offset;
+    }
+    return bits;
+}
+
+static TrnGridRowBits row_occupancy_sse2(TrnGridCell const * const row,
+                                         int const rowStride)
+{
+    return occupancy_chunks_sse2(row, 0, rowStride);
+}
+
+/* AVX2 kernels, 32 cells at a time, the remaining 16 cells if any go through
+ * the SSE2 kernels. */
+
+__attribute__((target("avx2")))
+static void fill_row_avx2(TrnGridCell * const row, int const rowStride,
+                          int const numberOfColumns, TrnGridCell const value)
+{
+    __m256i const lanes = _mm256_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+    __m256i const filled = _mm256_set1_epi8((char) value);
+    __m256i const empty = _mm256_set1_epi8(TRN_TETROMINO_VOID);
+    int offset;
+
+    for (offset = 0 ; offset + 32 <= rowStride ; offset += 32) {
+        int const cellCount = cells_in_chunk(numberOfColumns, offset, 32);
+        __m256i const limit = _mm256_set1_epi8((char) cellCount);
+        __m256i const inside = _mm256_cmpgt_epi8(limit, lanes);
+        _mm256_storeu_si256((__m256i*) (row + offset),
+                            _mm256_blendv_epi8(empty, filled, inside));
+    }
+    fill_chunks_sse2(row, offset, rowStride, numberOfColumns, value);
+}
+
+__attribute__((target("avx2")))
+static bool rows_equal_avx2(TrnGridCell const * const left,
+                            TrnGridCell const * const right,
+                            int const rowStride)
+{
+    int offset;
+    for (offset = 0 ; offset + 32 <= rowStride ; offset += 32) {
+        __m256i const l = _mm256_loadu_si256((__m256i const*) (left + offset));
+        __m256i const r = _mm256_loadu_si256((__m256i const*) (right + offset));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r)) != -1)
+            return false;
+    }
+    return offset == rowStride ||
+           rows_equal_sse2(left + offset, right + offset, rowStride - offset);
+}
+
+__attribute__((target("avx2")))
+static TrnGridRowBits row_occupancy_avx2(TrnGridCell const * const row,
+                                         int const rowStride)
+{
+    __m256i const empty = _mm256_set1_epi8(TRN_TETROMINO_VOID);
+    TrnGridRowBits bits = 0;
+    int offset;
+
+    for (offset = 0 ; offset + 32 <= rowStride && offset < 64 ; offset += 32) {
+        __m256i const cells =
+            _mm256_loadu_si256((__m256i const*) (row + offset));
+        uint32_t const voids = (uint32_t)
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, empty));
+        bits |= (TrnGridRowBits) ~voids << offset;
+    }
+    return bits | occupancy_chunks_sse2(row, offset, rowStride);
+}
+
+#endif
+
+/* Kernels in use, selected once at load time. */
+
+#ifdef TRN_GRID_KERNELS_X86
+static void (*fill_row_kernel)(TrnGridCell * const, int const, int const,
+                               TrnGridCell const) = fill_row_sse2;
+static bool (*rows_equal_kernel)(TrnGridCell const * const,
+                                 TrnGridCell const * const,
+                                 int const) = rows_equal_sse2;
+static TrnGridRowBits (*row_occupancy_kernel)(TrnGridCell const * const,
+                                              int const) = row_occupancy_sse2;
+
+__attribute__((constructor))
+static void select_kernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fill_row_kernel = fill_row_avx2;
+        rows_equal_kernel = rows_equal_avx2;
+        row_occupancy_kernel = row_occupancy_avx2;
+    }
+}
+#else
+static void (*fill_row_kernel)(TrnGridCell * const, int const, int const,
+                               TrnGridCell const) = fill_row_scalar;
+static bool (*rows_equal_kernel)(TrnGridCell const * const,
+                                 TrnGridCell const * const,
+                                 int const) = rows_equal_scalar;
+static TrnGridRowBits (*row_occupancy_kernel)(TrnGridCell const * const,
+                                              int const) = row_occupancy_scalar;
+#endif
+
+void trn_grid_kernel_fill_row(TrnGridCell * const row,
+                              int const rowStride,
+                              int const numberOfColumns,
+                              TrnGridCell const value)
+{
+    fill_row_kernel(row, rowStride, numberOfColumns, value);
+}
+
+bool trn_grid_kernel_rows_equal(TrnGridCell const * const left,
+                                TrnGridCell const * const right,
+                                int const rowStride)
+{
+    return rows_equal_kernel(left, right, rowStride);
+}
+
+TrnGridRowBits trn_grid_kernel_row_occupancy(TrnGridCell const * const row,
+                                             int const rowStride)
+{
+    return row_occupancy_kernel(row, rowStride);
+}
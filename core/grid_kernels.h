@@ -0,0 +1,38 @@
+#ifndef TRN_GRID_KERNELS_H
+#define TRN_GRID_KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* One grid cell: a TrnTetrominoType stored on a single byte. */
+typedef uint8_t TrnGridCell;
+
+/* Occupancy of up to 64 cells of a grid row: bit i is set when the i-th cell
+ * is not TRN_TETROMINO_VOID. Wider rows take several words. */
+typedef uint64_t TrnGridRowBits;
+
+#define TRN_GRID_ROW_BITS_WIDTH 64
+
+/* Rows are padded to a multiple of this many cells so that kernels only do
+ * whole vector loads and stores. Padding cells always stay void. */
+#define TRN_GRID_ROW_ALIGNMENT 16
+
+/* Row kernels, vectorized with SSE2 and, when the CPU supports it, AVX2 for
+ * rows of 32 cells or more. rowStride is the padded row length. */
+
+/* Set the numberOfColumns first cells of row to value, padding to void. */
+void trn_grid_kernel_fill_row(TrnGridCell * const row,
+                              int const rowStride,
+                              int const numberOfColumns,
+                              TrnGridCell const value);
+
+bool trn_grid_kernel_rows_equal(TrnGridCell const * const left,
+                                TrnGridCell const * const right,
+                                int const rowStride);
+
+/* Return the occupancy bits of at most TRN_GRID_ROW_BITS_WIDTH cells, ie a
+ * rowStride of at most 64: wider rows are done one word at a time. */
+TrnGridRowBits trn_grid_kernel_row_occupancy(TrnGridCell const * const row,
+                                             int const rowStride);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef TRN_INIT_H
 #define TRN_INIT_H
 
+/* Kept for the existing callers, the core needs no initialization. */
 void trn_init();
 
 #endif
@@ -2,7 +2,17 @@
 
 TrnPiece* trn_piece_new(TrnTetrominoType const type)
 {
-  TrnPiece* piece = (TrnPiece*) malloc(sizeof(TrnPiece));
+  return trn_piece_new_with_allocator(type, trn_allocator_heap());
+}
+
+TrnPiece* trn_piece_new_with_allocator(TrnTetrominoType const type,
+                                       TrnAllocator * const allocator)
+{
+  TrnPiece* piece = (TrnPiece*) trn_allocator_allocate(allocator,
+                                                       sizeof(TrnPiece),
+                                                       sizeof(int));
+  if (!piece)
+    return NULL;
   piece->type = type;
   piece->topLeftCorner.rowIndex = 0;
   piece->topLeftCorner.columnIndex = 0;
@@ -25,7 +35,13 @@ TrnPiece trn_piece_create(TrnTetrominoType const type,
 
 void trn_piece_destroy(TrnPiece* piece)
 {
-  free(piece);
+  trn_piece_destroy_with_allocator(piece, trn_allocator_heap());
+}
+
+void trn_piece_destroy_with_allocator(TrnPiece* piece,
+                                      TrnAllocator * const allocator)
+{
+  trn_allocator_release(allocator, piece);
 }
 
 void trn_piece_move_to_left(TrnPiece * const toBeMoved)
@@ -70,10 +86,9 @@ bool trn_piece_equal(TrnPiece const left, TrnPiece const right)
 TrnPositionInGrid trn_piece_position_in_grid(TrnPiece const * const piece, 
                                              int squareIndex)
 {
-    TrnTetrominoRotation rotation = 
-        TRN_ALL_TETROMINO_FOUR_ROTATIONS[piece->type][piece->angle];
-
-    const TrnPositionInGrid square = rotation[squareIndex];
+    TrnTetrominoShape const * const shape =
+        &TRN_ALL_TETROMINO_SHAPES[piece->type][piece->angle];
+    const TrnPositionInGrid square = shape->squares[squareIndex];
 
     TrnPositionInGrid pos;
     pos.rowIndex = piece->topLeftCorner.rowIndex + square.rowIndex;
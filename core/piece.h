@@ -5,6 +5,7 @@
 #include <stdbool.h>
 
 #include "tetromino.h"
+#include "allocator.h"
 
 #include <malloc.h>
 
@@ -19,12 +20,20 @@ typedef struct piece
 
 TrnPiece* trn_piece_new(TrnTetrominoType const type);
 
+/* Same as trn_piece_new, the piece being allocated with allocator, and
+ * destroyed with trn_piece_destroy_with_allocator and the same allocator. */
+TrnPiece* trn_piece_new_with_allocator(TrnTetrominoType const type,
+                                       TrnAllocator * const allocator);
+
 TrnPiece trn_piece_create(TrnTetrominoType const type,
                           int const topLeftCornerRowIndex,
                           int const topLeftCornerColumIndex,
                           TrnTetrominoRotationAngle const angle);
 void trn_piece_destroy(TrnPiece* piece);
 
+void trn_piece_destroy_with_allocator(TrnPiece* piece,
+                                      TrnAllocator * const allocator);
+
 void trn_piece_move_to_left(TrnPiece * const toBeMoved);
 
 void trn_piece_move_to_right(TrnPiece * const toBeMoved);
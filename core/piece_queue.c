@@ -0,0 +1,132 @@
+#include "piece_queue.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// Randomizers
+//////////////////////////////////////////////////////////////////////////////
+
+static int uniform_next_batch(TrnRandomizer * const randomizer,
+                              TrnRandom * const random,
+                              TrnTetrominoType types[])
+{
+    (void) randomizer;
+    uint64_t values[TRN_RANDOMIZER_MAX_BATCH];
+    int index;
+    trn_random_fill(random, values, TRN_RANDOMIZER_MAX_BATCH);
+    for (index = 0 ; index < TRN_RANDOMIZER_MAX_BATCH ; index++)
+        types[index] = trn_random_scale(values[index],
+                                        TRN_NUMBER_OF_TETROMINO);
+    return TRN_RANDOMIZER_MAX_BATCH;
+}
+
+static int bag_next_batch(TrnRandomizer * const randomizer,
+                          TrnRandom * const random,
+                          TrnTetrominoType types[])
+{
+    (void) randomizer;
+    uint64_t values[TRN_NUMBER_OF_TETROMINO - 1];
+    int index;
+    trn_random_fill(random, values, TRN_NUMBER_OF_TETROMINO - 1);
+    for (index = 0 ; index < TRN_NUMBER_OF_TETROMINO ; index++)
+        types[index] = (TrnTetrominoType) index;
+
+    /* Fisher-Yates shuffle. */
+    for (index = TRN_NUMBER_OF_TETROMINO - 1 ; index > 0 ; index--) {
+        int const swapped = trn_random_scale(values[index - 1], index + 1);
+        TrnTetrominoType const type = types[index];
+        types[index] = types[swapped];
+        types[swapped] = type;
+    }
+    return TRN_NUMBER_OF_TETROMINO;
+}
+
+/* Stateless, never written. */
+static TrnRandomizer uniform = {uniform_next_batch};
+static TrnRandomizer bag = {bag_next_batch};
+
+TrnRandomizer* trn_randomizer_uniform()
+{
+    return &uniform;
+}
+
+TrnRandomizer* trn_randomizer_bag()
+{
+    return &bag;
+}
+
+void trn_randomizer_generate(TrnRandomizer * const randomizer,
+                             TrnRandom * const random,
+                             TrnTetrominoType types[],
+                             int const count)
+{
+    TrnTetrominoType batch[TRN_RANDOMIZER_MAX_BATCH];
+    int generated = 0;
+    while (generated < count) {
+        int batchSize = randomizer->next_batch(randomizer, random, batch);
+        if (batchSize > count - generated)
+            batchSize = count - generated;
+        int index;
+        for (index = 0 ; index < batchSize ; index++)
+            types[generated++] = batch[index];
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue
+//////////////////////////////////////////////////////////////////////////////
+
+static void fill(TrnPieceQueue * const queue)
+{
+    while (queue->count < queue->previewLength) {
+        TrnTetrominoType batch[TRN_RANDOMIZER_MAX_BATCH];
+        int const batchSize = queue->randomizer->next_batch(
+            queue->randomizer, &queue->random, batch);
+        int index;
+        for (index = 0 ; index < batchSize ; index++) {
+            queue->types[(queue->first + queue->count) %
+                         TRN_PIECE_QUEUE_CAPACITY] = batch[index];
+            queue->count++;
+        }
+    }
+}
+
+void trn_piece_queue_init(TrnPieceQueue * const queue,
+                          TrnRandomizer * const randomizer,
+                          uint64_t const seed,
+                          int const previewLength)
+{
+    int index;
+    /* Slots out of the queued types are void, so that they are saved the
+     * same for equal queues. */
+    for (index = 0 ; index < TRN_PIECE_QUEUE_CAPACITY ; index++)
+        queue->types[index] = TRN_TETROMINO_VOID;
+    queue->first = 0;
+    queue->count = 0;
+    queue->randomizer = randomizer;
+    trn_random_seed(&queue->random, seed);
+    trn_piece_queue_set_preview_length(queue, previewLength);
+}
+
+void trn_piece_queue_set_preview_length(TrnPieceQueue * const queue,
+                                        int const previewLength)
+{
+    /* Keep at least one type, the next piece. */
+    queue->previewLength = previewLength < 1 ? 1 :
+        previewLength > TRN_PIECE_QUEUE_MAX_PREVIEW ?
+        TRN_PIECE_QUEUE_MAX_PREVIEW : previewLength;
+    fill(queue);
+}
+
+TrnTetrominoType trn_piece_queue_pop(TrnPieceQueue * const queue)
+{
+    TrnTetrominoType const type = queue->types[queue->first];
+    queue->first = (queue->first + 1) % TRN_PIECE_QUEUE_CAPACITY;
+    queue->count--;
+    fill(queue);
+    return type;
+}
+
+TrnTetrominoType trn_piece_queue_peek(TrnPieceQueue const * const queue,
+                                      int const index)
+{
+    return queue->types[(queue->first + index) % TRN_PIECE_QUEUE_CAPACITY];
+}
@@ -0,0 +1,66 @@
+#ifndef TRN_PIECE_QUEUE_H
+#define TRN_PIECE_QUEUE_H
+
+#include "tetromino.h"
+#include "random.h"
+
+/* Source of the tetromino types of a game. A randomizer writes them a batch
+ * at a time, eg a whole bag, drawing from the random generator of the game.
+ * It may keep its own state by extending this struct, as TrnArena extends
+ * TrnAllocator. */
+typedef struct TrnRandomizer {
+    int (*next_batch)(struct TrnRandomizer * const randomizer,
+                      TrnRandom * const random,
+                      TrnTetrominoType types[]);
+} TrnRandomizer;
+
+/* Largest batch a randomizer may write. */
+#define TRN_RANDOMIZER_MAX_BATCH 16
+
+/* Every tetromino type is equally likely, one at a time. */
+TrnRandomizer* trn_randomizer_uniform();
+
+/* 7-bag: the seven tetrominos, shuffled, one bag after another. */
+TrnRandomizer* trn_randomizer_bag();
+
+/* Write a sequence of count types, eg for simulations that do not need a
+ * queue. */
+void trn_randomizer_generate(TrnRandomizer * const randomizer,
+                             TrnRandom * const random,
+                             TrnTetrominoType types[],
+                             int const count);
+
+#define TRN_PIECE_QUEUE_CAPACITY 32
+#define TRN_PIECE_QUEUE_MAX_PREVIEW \
+    (TRN_PIECE_QUEUE_CAPACITY - TRN_RANDOMIZER_MAX_BATCH)
+
+/* Upcoming tetromino types, in a ring buffer kept filled with at least
+ * previewLength types by the randomizer. */
+typedef struct {
+    TrnTetrominoType types[TRN_PIECE_QUEUE_CAPACITY];
+    int first;
+    int count;
+    int previewLength;
+    TrnRandomizer* randomizer;
+    TrnRandom random;
+} TrnPieceQueue;
+
+void trn_piece_queue_init(TrnPieceQueue * const queue,
+                          TrnRandomizer * const randomizer,
+                          uint64_t const seed,
+                          int const previewLength);
+
+/* Change the number of types kept ahead, at most
+ * TRN_PIECE_QUEUE_MAX_PREVIEW. */
+void trn_piece_queue_set_preview_length(TrnPieceQueue * const queue,
+                                        int const previewLength);
+
+/* Remove and return the first type of the queue. */
+TrnTetrominoType trn_piece_queue_pop(TrnPieceQueue * const queue);
+
+/* Return the type at index in the queue, index being lower than
+ * previewLength. */
+TrnTetrominoType trn_piece_queue_peek(TrnPieceQueue const * const queue,
+                                      int const index);
+
+#endif
@@ -0,0 +1,330 @@
+#include "placement.h"
+#include "tetromino_srs.h"
+
+#include <string.h>
+
+/* A piece fitting in the grid has its top left corner at most this far above
+ * or left of the grid. */
+#define CORNER_MARGIN (TRN_TETROMINO_GRID_SIZE - 1)
+
+/* The largest SRS kick down. */
+#define MAX_KICK_DOWN_ROWS 2
+
+/* A rotation puts the bottom of a piece at most this many rows below its top
+ * left corner: the bottom of its box, plus the largest kick down. */
+#define ROTATION_REACH_ROWS (TRN_TETROMINO_GRID_SIZE - 1 + MAX_KICK_DOWN_ROWS)
+
+/* Rows above the stack a piece must spawn at for the rotations near the
+ * stack, ROTATION_REACH_ROWS above the lowest rows, to be reachable. */
+#define FREE_BAND_ROWS (TRN_TETROMINO_GRID_SIZE + ROTATION_REACH_ROWS)
+
+static int words_for_bits(int const count)
+{
+    return (count + 63) / 64;
+}
+
+static bool test_and_set(uint64_t * const bits, int const index)
+{
+    uint64_t const mask = (uint64_t) 1 << (index % 64);
+    if (bits[index / 64] & mask)
+        return true;
+    bits[index / 64] |= mask;
+    return false;
+}
+
+/* Occupancy of a shape moved to the top left of its box, 4 bits per row. */
+static uint16_t normalized_cells(TrnTetrominoShape const * const shape)
+{
+    uint16_t cells = 0;
+    int rowIndex;
+    for (rowIndex = shape->firstRowIndex ; rowIndex <= shape->lastRowIndex ;
+         rowIndex++)
+        cells |= (uint16_t) (shape->rowMasks[rowIndex] >>
+                             shape->firstColumnIndex) <<
+                 (4 * (rowIndex - shape->firstRowIndex));
+    return cells;
+}
+
+TrnPlacementFinder* trn_placement_finder_new(int const numberOfRows,
+                                             int const numberOfColumns)
+{
+    return trn_placement_finder_new_with_allocator(numberOfRows,
+                                                   numberOfColumns,
+                                                   trn_allocator_heap());
+}
+
+TrnPlacementFinder* trn_placement_finder_new_with_allocator(
+    int const numberOfRows,
+    int const numberOfColumns,
+    TrnAllocator * const allocator)
+{
+    TrnPlacementFinder* finder = (TrnPlacementFinder*)
+        trn_allocator_allocate(allocator, sizeof(TrnPlacementFinder),
+                               sizeof(void*));
+    int type, angle, other;
+
+    finder->allocator = allocator;
+    finder->numberOfRows = numberOfRows;
+    finder->numberOfColumns = numberOfColumns;
+    finder->stateRows = numberOfRows + CORNER_MARGIN;
+    finder->stateColumns = numberOfColumns + CORNER_MARGIN;
+
+    int const numberOfStates = TRN_TETROMINO_NUMBER_OF_ROTATIONS *
+                               finder->stateRows * finder->stateColumns;
+    finder->visitedWords = words_for_bits(numberOfStates);
+    finder->landedWords = words_for_bits(TRN_TETROMINO_NUMBER_OF_ROTATIONS *
+                                         numberOfRows * numberOfColumns);
+    finder->visited = (uint64_t*) trn_allocator_allocate(
+        allocator, finder->visitedWords * sizeof(uint64_t),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+    finder->landed = (uint64_t*) trn_allocator_allocate(
+        allocator, finder->landedWords * sizeof(uint64_t),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+    /* Each state is queued once, and gives at most one placement. */
+    finder->queue = (TrnPiece*) trn_allocator_allocate(
+        allocator, numberOfStates * sizeof(TrnPiece), sizeof(void*));
+    finder->placements = (TrnPiece*) trn_allocator_allocate(
+        allocator, numberOfStates * sizeof(TrnPiece), sizeof(void*));
+    finder->numberOfPlacements = 0;
+
+    for (type = 0 ; type < TRN_NUMBER_OF_TETROMINO ; type++)
+        for (angle = 0 ; angle < TRN_TETROMINO_NUMBER_OF_ROTATIONS ; angle++) {
+            TrnTetrominoShape const * const shapes =
+                TRN_ALL_TETROMINO_SHAPES[type];
+            for (other = 0 ; other <= angle ; other++)
+                if (normalized_cells(&shapes[other]) ==
+                    normalized_cells(&shapes[angle])) {
+                    finder->canonicalAngles[type][angle] = other;
+                    break;
+                }
+        }
+    return finder;
+}
+
+void trn_placement_finder_destroy(TrnPlacementFinder * finder)
+{
+    TrnAllocator * const allocator = finder->allocator;
+    trn_allocator_release(allocator, finder->placements);
+    trn_allocator_release(allocator, finder->queue);
+    trn_allocator_release(allocator, finder->landed);
+    trn_allocator_release(allocator, finder->visited);
+    trn_allocator_release(allocator, finder);
+}
+
+static int state_index(TrnPlacementFinder const * const finder,
+                       TrnPiece const * const piece)
+{
+    return (piece->angle * finder->stateRows +
+            piece->topLeftCorner.rowIndex + CORNER_MARGIN) *
+           finder->stateColumns +
+           piece->topLeftCorner.columnIndex + CORNER_MARGIN;
+}
+
+/* Queue piece, which fits in the grid, unless it has been visited. */
+static int visit(TrnPlacementFinder * const finder,
+                 TrnPiece const * const piece,
+                 int const queueLength)
+{
+    if (test_and_set(finder->visited, state_index(finder, piece)))
+        return queueLength;
+    finder->queue[queueLength] = *piece;
+    return queueLength + 1;
+}
+
+/* Record the placement of piece dropped to the bottom, unless one with the
+ * same cells has been. */
+static void land(TrnPlacementFinder * const finder,
+                 TrnGrid const * const grid,
+                 TrnPiece const * const piece)
+{
+    TrnPiece landed = *piece;
+    landed.topLeftCorner.rowIndex += trn_grid_drop_distance(grid, piece);
+
+    TrnTetrominoShape const * const shape =
+        &TRN_ALL_TETROMINO_SHAPES[landed.type][landed.angle];
+    int const index =
+        (finder->canonicalAngles[landed.type][landed.angle] *
+         finder->numberOfRows +
+         landed.topLeftCorner.rowIndex + shape->firstRowIndex) *
+        finder->numberOfColumns +
+        landed.topLeftCorner.columnIndex + shape->firstColumnIndex;
+    if (!test_and_set(finder->landed, index))
+        finder->placements[finder->numberOfPlacements++] = landed;
+}
+
+/* Land piece at every column, for each distinct angle. */
+static void land_all_columns(TrnPlacementFinder * const finder,
+                             TrnGrid const * const grid,
+                             TrnPiece const * const piece)
+{
+    TrnPiece moved = *piece;
+    int angle;
+
+    for (angle = 0 ; angle < TRN_TETROMINO_NUMBER_OF_ROTATIONS ; angle++) {
+        TrnTetrominoShape const * const shape =
+            &TRN_ALL_TETROMINO_SHAPES[piece->type][angle];
+        if (finder->canonicalAngles[piece->type][angle] != angle)
+            continue;
+        moved.angle = angle;
+        for (moved.topLeftCorner.columnIndex = -shape->firstColumnIndex ;
+             moved.topLeftCorner.columnIndex + shape->lastColumnIndex <
+                 finder->numberOfColumns ;
+             moved.topLeftCorner.columnIndex++)
+            land(finder, grid, &moved);
+    }
+}
+
+/* Whether piece only covers rows above the stack top. */
+static bool above_stack(TrnPiece const * const piece,
+                        int const stackTopRowIndex)
+{
+    return piece->topLeftCorner.rowIndex +
+           TRN_ALL_TETROMINO_SHAPES[piece->type][piece->angle].lastRowIndex <
+           stackTopRowIndex;
+}
+
+/* Queue next unless it is above the stack, the states above the stack being
+ * all reached already when stackTopRowIndex is not -1. */
+static int visit_below(TrnPlacementFinder * const finder,
+                       TrnPiece const * const next,
+                       int const stackTopRowIndex,
+                       int const queueLength)
+{
+    if (stackTopRowIndex >= 0 && above_stack(next, stackTopRowIndex))
+        return queueLength;
+    return visit(finder, next, queueLength);
+}
+
+/* Queue the states a move leads to from the lowest states above the stack,
+ * for every angle and column, and land the ones resting on the stack. */
+static int visit_from_above_stack(TrnPlacementFinder * const finder,
+                                  TrnGrid const * const grid,
+                                  TrnPiece const * const piece,
+                                  int const stackTopRowIndex,
+                                  bool const rotates)
+{
+    TrnPiece current = *piece, next;
+    int queueLength = 0, angle, direction;
+
+    for (angle = 0 ; angle < TRN_TETROMINO_NUMBER_OF_ROTATIONS ; angle++) {
+        TrnTetrominoShape const * const shape =
+            &TRN_ALL_TETROMINO_SHAPES[piece->type][angle];
+        int const lowestRowIndex =
+            stackTopRowIndex - 1 - shape->lastRowIndex;
+        current.angle = angle;
+        for (current.topLeftCorner.columnIndex = -shape->firstColumnIndex ;
+             current.topLeftCorner.columnIndex + shape->lastColumnIndex <
+                 finder->numberOfColumns ;
+             current.topLeftCorner.columnIndex++) {
+            /* Moving sideways stays above the stack, moving down and
+             * rotating may not. */
+            current.topLeftCorner.rowIndex = lowestRowIndex;
+            next = current;
+            next.topLeftCorner.rowIndex++;
+            if (trn_grid_can_set_cells_with_piece(grid, &next))
+                queueLength = visit(finder, &next, queueLength);
+            else
+                land(finder, grid, &current);
+
+            for (direction = 0 ;
+                 rotates && direction < TRN_NUMBER_OF_ROTATION_DIRECTIONS ;
+                 direction++) {
+                /* Only the rows from which the rotated piece can reach the
+                 * stack, with its largest kick down. */
+                TrnTetrominoShape const * const rotatedShape =
+                    &TRN_ALL_TETROMINO_SHAPES[piece->type]
+                        [trn_srs_rotated_angle(angle, direction)];
+                for (current.topLeftCorner.rowIndex = stackTopRowIndex -
+                         rotatedShape->lastRowIndex - MAX_KICK_DOWN_ROWS ;
+                     current.topLeftCorner.rowIndex <= lowestRowIndex ;
+                     current.topLeftCorner.rowIndex++)
+                    if (trn_srs_find_kick(grid, &current,
+                                          (TrnRotationDirection) direction,
+                                          &next) >= 0)
+                        queueLength = visit_below(finder, &next,
+                                                  stackTopRowIndex,
+                                                  queueLength);
+            }
+        }
+    }
+    return queueLength;
+}
+
+int trn_placement_finder_find(TrnPlacementFinder * const finder,
+                              TrnGrid const * const grid,
+                              TrnPiece const * const piece,
+                              bool const withTucks)
+{
+    int queueStart = 0, queueLength = 0;
+    int direction;
+    /* Rotating a piece that looks the same at every angle, the O, leads
+     * nowhere new. */
+    bool const rotates = finder->canonicalAngles[piece->type]
+                             [TRN_TETROMINO_NUMBER_OF_ROTATIONS - 1] != 0;
+    int const stackTopRowIndex = trn_grid_stack_top_row_index(grid);
+
+    memset(finder->landed, 0, finder->landedWords * sizeof(uint64_t));
+    finder->numberOfPlacements = 0;
+    if (!trn_grid_can_set_cells_with_piece(grid, piece))
+        return 0;
+
+    /* When the piece spawns well above the stack, with room to rotate
+     * between the walls, it reaches every angle and column above the
+     * stack: that gives all the placements without tucks, and the search
+     * of tucks only has to start from there. */
+    bool const spawnsAboveStack =
+        piece->topLeftCorner.rowIndex + FREE_BAND_ROWS <= stackTopRowIndex &&
+        piece->topLeftCorner.columnIndex >= 0 &&
+        piece->topLeftCorner.columnIndex + TRN_TETROMINO_GRID_SIZE <=
+            finder->numberOfColumns;
+    if (spawnsAboveStack && !withTucks) {
+        land_all_columns(finder, grid, piece);
+        return finder->numberOfPlacements;
+    }
+
+    memset(finder->visited, 0, finder->visitedWords * sizeof(uint64_t));
+    int const skippedAboveRowIndex = spawnsAboveStack ? stackTopRowIndex : -1;
+    if (spawnsAboveStack)
+        queueLength = visit_from_above_stack(finder, grid, piece,
+                                             stackTopRowIndex, rotates);
+    else
+        queueLength = visit(finder, piece, queueLength);
+
+    /* Breadth first, over the moves a player can make. */
+    while (queueStart < queueLength) {
+        TrnPiece const current = finder->queue[queueStart++];
+        TrnPiece next;
+
+        /* With tucks, every lock position is a state of its own, where the
+         * piece cannot move down. */
+        if (withTucks) {
+            next = current;
+            next.topLeftCorner.rowIndex++;
+            if (trn_grid_can_set_cells_with_piece(grid, &next))
+                queueLength = visit(finder, &next, queueLength);
+            else
+                land(finder, grid, &current);
+        }
+        else
+            land(finder, grid, &current);
+
+        next = current;
+        next.topLeftCorner.columnIndex--;
+        if (trn_grid_can_set_cells_with_piece(grid, &next))
+            queueLength = visit_below(finder, &next, skippedAboveRowIndex,
+                                      queueLength);
+        next.topLeftCorner.columnIndex += 2;
+        if (trn_grid_can_set_cells_with_piece(grid, &next))
+            queueLength = visit_below(finder, &next, skippedAboveRowIndex,
+                                      queueLength);
+        for (direction = 0 ;
+             rotates && direction < TRN_NUMBER_OF_ROTATION_DIRECTIONS ;
+             direction++)
+            if (trn_srs_find_kick(grid, &current,
+                                  (TrnRotationDirection) direction,
+                                  &next) >= 0)
+                queueLength = visit_below(finder, &next, skippedAboveRowIndex,
+                                          queueLength);
+    }
+    return finder->numberOfPlacements;
+}
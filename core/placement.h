@@ -0,0 +1,56 @@
+#ifndef TRN_PLACEMENT_H
+#define TRN_PLACEMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "grid.h"
+#include "piece.h"
+#include "allocator.h"
+
+/* Move generator: every distinct position where a piece can lock, reached
+ * from its spawn position by moves, rotations with their SRS kicks and, with
+ * tucks, soft drops. Each state (angle, row, column) is explored once thanks
+ * to a visited bitset, and placements covering the same cells are only
+ * listed once, eg the two horizontal I placements.
+ *
+ * A finder is made for a grid size and reused for every piece, it does not
+ * allocate while searching. It must be used from a single thread. */
+typedef struct {
+    int numberOfRows;
+    int numberOfColumns;
+    int stateRows;    /* rows of the state space, top left corners above */
+    int stateColumns; /* the grid included */
+    uint64_t* visited;
+    uint64_t* landed;
+    int visitedWords;
+    int landedWords;
+    TrnPiece* queue;
+    TrnPiece* placements;
+    int numberOfPlacements;
+    /* Smallest angle with the same cells, by tetromino and angle. */
+    int8_t canonicalAngles[TRN_NUMBER_OF_TETROMINO]
+                          [TRN_TETROMINO_NUMBER_OF_ROTATIONS];
+    TrnAllocator* allocator;
+} TrnPlacementFinder;
+
+TrnPlacementFinder* trn_placement_finder_new(int const numberOfRows,
+                                             int const numberOfColumns);
+
+TrnPlacementFinder* trn_placement_finder_new_with_allocator(
+    int const numberOfRows,
+    int const numberOfColumns,
+    TrnAllocator * const allocator);
+
+void trn_placement_finder_destroy(TrnPlacementFinder * finder);
+
+/* Find the placements of piece, at its spawn position in grid, in
+ * finder->placements, as pieces at their lock positions. Without tucks,
+ * pieces only move and rotate before a hard drop. Return the number of
+ * placements, 0 when piece does not fit where it is. */
+int trn_placement_finder_find(TrnPlacementFinder * const finder,
+                              TrnGrid const * const grid,
+                              TrnPiece const * const piece,
+                              bool const withTucks);
+
+#endif
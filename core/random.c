@@ -0,0 +1,57 @@
+#include "random.h"
+
+static inline uint64_t rotate_left(uint64_t const value, int const shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+/* splitmix64, spreads the seed over the whole state, which must not be all
+ * zeros. */
+static uint64_t splitmix64(uint64_t * const seed)
+{
+    uint64_t value = (*seed += 0x9E3779B97F4A7C15ull);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+void trn_random_seed(TrnRandom * const random, uint64_t const seed)
+{
+    uint64_t state = seed;
+    int index;
+    for (index = 0 ; index < 4 ; index++)
+        random->state[index] = splitmix64(&state);
+}
+
+uint64_t trn_random_next(TrnRandom * const random)
+{
+    uint64_t * const s = random->state;
+    uint64_t const result = rotate_left(s[1] * 5, 7) * 9;
+    uint64_t const t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 45);
+
+    return result;
+}
+
+void trn_random_fill(TrnRandom * const random,
+                     uint64_t values[],
+                     int const count)
+{
+    /* Work on a local copy of the state, kept in registers by the loop. */
+    TrnRandom local = *random;
+    int index;
+    for (index = 0 ; index < count ; index++)
+        values[index] = trn_random_next(&local);
+    *random = local;
+}
+
+int trn_random_below(TrnRandom * const random, int const bound)
+{
+    return trn_random_scale(trn_random_next(random), bound);
+}
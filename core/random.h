@@ -0,0 +1,33 @@
+#ifndef TRN_RANDOM_H
+#define TRN_RANDOM_H
+
+#include <stdint.h>
+
+/* xoshiro256** pseudo random generator. Each game owns one, seeded
+ * explicitly, so that games are reproducible and can run on several threads
+ * without sharing the C library generator. */
+typedef struct {
+    uint64_t state[4];
+} TrnRandom;
+
+/* The same seed always gives the same sequence, any seed is valid. */
+void trn_random_seed(TrnRandom * const random, uint64_t const seed);
+
+uint64_t trn_random_next(TrnRandom * const random);
+
+/* Write count random values at once. */
+void trn_random_fill(TrnRandom * const random,
+                     uint64_t values[],
+                     int const count);
+
+/* Map a random value to [0, bound) with a multiplication by its high 32
+ * bits, bound being small enough for the bias to be negligible. */
+static inline int trn_random_scale(uint64_t const value, int const bound)
+{
+    return (int) (((value >> 32) * (uint64_t) bound) >> 32);
+}
+
+/* Return a random integer in [0, bound). */
+int trn_random_below(TrnRandom * const random, int const bound);
+
+#endif
@@ -0,0 +1,475 @@
+#include "replay.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t const MAGIC[4] = {'T', 'R', 'N', 'R'};
+
+/* Offsets keeping the columns and rows of placements positive, the box of a
+ * piece sticking out of the grid by less than its size. */
+#define PLACEMENT_OFFSET TRN_TETROMINO_GRID_SIZE
+
+#define VARINT_MAX_SIZE 10
+
+//////////////////////////////////////////////////////////////////////////////
+// Writer
+//////////////////////////////////////////////////////////////////////////////
+
+typedef struct Submission {
+    struct Submission* next;
+    uint8_t* bytes;
+    size_t size;
+} Submission;
+
+struct TrnReplayWriter {
+    FILE* file;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    Submission* first; /* oldest first */
+    Submission* last;
+    bool isStopping;
+};
+
+static size_t write_varint(uint8_t * const bytes, uint64_t value)
+{
+    size_t size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = (uint8_t) value;
+    return size;
+}
+
+/* Take the whole list at once, so that submitters never wait for the
+ * file. */
+static void* run_writer(void * const argument)
+{
+    TrnReplayWriter * const writer = (TrnReplayWriter*) argument;
+    for (;;) {
+        pthread_mutex_lock(&writer->lock);
+        while (!writer->first && !writer->isStopping)
+            pthread_cond_wait(&writer->submitted, &writer->lock);
+        Submission* submission = writer->first;
+        bool const isStopping = writer->isStopping;
+        writer->first = NULL;
+        writer->last = NULL;
+        pthread_mutex_unlock(&writer->lock);
+
+        if (!submission && isStopping)
+            return NULL;
+        while (submission) {
+            Submission * const next = submission->next;
+            uint8_t sizeBytes[VARINT_MAX_SIZE];
+            fwrite(sizeBytes, 1, write_varint(sizeBytes, submission->size),
+                   writer->file);
+            fwrite(submission->bytes, 1, submission->size, writer->file);
+            free(submission->bytes);
+            free(submission);
+            submission = next;
+        }
+        fflush(writer->file);
+    }
+}
+
+TrnReplayWriter* trn_replay_writer_new(char const * const path)
+{
+    FILE * const file = fopen(path, "ab");
+    if (!file)
+        return NULL;
+
+    TrnReplayWriter* writer =
+        (TrnReplayWriter*) malloc(sizeof(TrnReplayWriter));
+    writer->file = file;
+    writer->first = NULL;
+    writer->last = NULL;
+    writer->isStopping = false;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->submitted, NULL);
+    if (pthread_create(&writer->thread, NULL, run_writer, writer)) {
+        pthread_cond_destroy(&writer->submitted);
+        pthread_mutex_destroy(&writer->lock);
+        fclose(file);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void trn_replay_writer_destroy(TrnReplayWriter * writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->isStopping = true;
+    pthread_cond_signal(&writer->submitted);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    fclose(writer->file);
+    pthread_cond_destroy(&writer->submitted);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer);
+}
+
+void trn_replay_writer_submit(TrnReplayWriter * const writer,
+                              uint8_t * const bytes,
+                              size_t const size)
+{
+    Submission * const submission =
+        (Submission*) malloc(sizeof(Submission));
+    submission->next = NULL;
+    submission->bytes = bytes;
+    submission->size = size;
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->last)
+        writer->last->next = submission;
+    else
+        writer->first = submission;
+    writer->last = submission;
+    pthread_cond_signal(&writer->submitted);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+uint8_t* trn_replay_read(FILE * const file, size_t * const size)
+{
+    uint64_t length = 0;
+    int shift, byte = 0;
+    for (shift = 0 ; shift < 64 ; shift += 7) {
+        byte = fgetc(file);
+        if (byte == EOF)
+            return NULL;
+        length |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    if (byte & 0x80)
+        return NULL;
+
+    uint8_t * const bytes = (uint8_t*) malloc(length ? length : 1);
+    if (!bytes || fread(bytes, 1, length, file) != length) {
+        free(bytes);
+        return NULL;
+    }
+    *size = length;
+    return bytes;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Recorder
+//////////////////////////////////////////////////////////////////////////////
+
+#define RECORDER_INITIAL_CAPACITY 1024
+
+TrnReplayRecorder* trn_replay_recorder_new(TrnReplayWriter * const writer)
+{
+    TrnReplayRecorder* recorder =
+        (TrnReplayRecorder*) malloc(sizeof(TrnReplayRecorder));
+    recorder->writer = writer;
+    recorder->capacity = RECORDER_INITIAL_CAPACITY;
+    recorder->bytes = (uint8_t*) malloc(recorder->capacity);
+    recorder->size = 0;
+    recorder->tick = 0;
+    recorder->lastTick = 0;
+    recorder->lockedPieces = 0;
+    recorder->isRecording = false;
+    return recorder;
+}
+
+void trn_replay_recorder_destroy(TrnReplayRecorder * recorder)
+{
+    free(recorder->bytes);
+    free(recorder);
+}
+
+void trn_replay_recorder_set_tick(TrnReplayRecorder * const recorder,
+                                  uint64_t const tick)
+{
+    if (tick > recorder->lastTick)
+        recorder->tick = tick;
+}
+
+/* Make room for size more bytes, doubling the buffer. */
+static void reserve(TrnReplayRecorder * const recorder, size_t const size)
+{
+    if (recorder->size + size <= recorder->capacity)
+        return;
+    while (recorder->size + size > recorder->capacity)
+        recorder->capacity *= 2;
+    recorder->bytes = (uint8_t*) realloc(recorder->bytes,
+                                         recorder->capacity);
+}
+
+static void append_varint(TrnReplayRecorder * const recorder,
+                          uint64_t const value)
+{
+    reserve(recorder, VARINT_MAX_SIZE);
+    recorder->size += write_varint(recorder->bytes + recorder->size, value);
+}
+
+static void append_fixed64(TrnReplayRecorder * const recorder,
+                           uint64_t const value)
+{
+    int index;
+    reserve(recorder, 8);
+    for (index = 0 ; index < 8 ; index++)
+        recorder->bytes[recorder->size++] = (uint8_t) (value >> (8 * index));
+}
+
+static void append_input(TrnReplayRecorder * const recorder,
+                         TrnReplayInput const input)
+{
+    append_varint(recorder,
+                  (recorder->tick - recorder->lastTick) << 4 | input);
+    recorder->lastTick = recorder->tick;
+}
+
+void trn_replay_recorder_start(TrnReplayRecorder * const recorder,
+                               TrnGame const * const game)
+{
+    int flags = 0;
+    if (game->gravity_20g)
+        flags |= TRN_REPLAY_FLAG_GRAVITY_20G;
+    if (game->queue.randomizer == trn_randomizer_uniform())
+        flags |= TRN_REPLAY_FLAG_UNIFORM_RANDOMIZER;
+    else if (game->queue.randomizer != trn_randomizer_bag())
+        flags |= TRN_REPLAY_FLAG_OTHER_RANDOMIZER;
+
+    recorder->size = 0;
+    recorder->tick = 0;
+    recorder->lastTick = 0;
+    recorder->lockedPieces = 0;
+    recorder->isRecording = true;
+    reserve(recorder, sizeof(MAGIC));
+    memcpy(recorder->bytes, MAGIC, sizeof(MAGIC));
+    recorder->size = sizeof(MAGIC);
+    append_varint(recorder, TRN_REPLAY_VERSION);
+    append_fixed64(recorder, game->seed);
+    append_varint(recorder, game->grid->numberOfRows);
+    append_varint(recorder, game->grid->numberOfColumns);
+    append_varint(recorder, game->initial_delay);
+    append_varint(recorder, flags);
+    append_varint(recorder, game->queue.previewLength);
+}
+
+void trn_replay_recorder_record(TrnReplayRecorder * const recorder,
+                                TrnReplayInput const input,
+                                TrnPiece const * const placement)
+{
+    if (!recorder->isRecording)
+        return;
+    append_input(recorder, input);
+    if (input != TRN_REPLAY_PLACE)
+        return;
+    append_varint(recorder, (uint64_t) (placement->topLeftCorner.columnIndex +
+                                        PLACEMENT_OFFSET) << 2 |
+                            placement->angle);
+    append_varint(recorder,
+                  placement->topLeftCorner.rowIndex + PLACEMENT_OFFSET);
+}
+
+void trn_replay_recorder_piece_locked(TrnReplayRecorder * const recorder,
+                                      TrnGame const * const game)
+{
+    if (!recorder->isRecording ||
+        ++recorder->lockedPieces % TRN_REPLAY_CHECKPOINT_PERIOD)
+        return;
+    append_input(recorder, TRN_REPLAY_CHECKPOINT);
+    append_fixed64(recorder, trn_game_hash(game));
+}
+
+void trn_replay_recorder_finish(TrnReplayRecorder * const recorder,
+                                TrnGame const * const game)
+{
+    if (!recorder->isRecording)
+        return;
+    append_input(recorder, TRN_REPLAY_END);
+    append_varint(recorder, game->status);
+    append_varint(recorder, game->score);
+    append_varint(recorder, game->lines_count);
+    append_varint(recorder, game->level);
+    append_fixed64(recorder, trn_game_hash(game));
+    recorder->isRecording = false;
+
+    /* The writer takes the buffer, the next replay gets one as big. */
+    trn_replay_writer_submit(recorder->writer, recorder->bytes,
+                             recorder->size);
+    recorder->bytes = (uint8_t*) malloc(recorder->capacity);
+    recorder->size = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reader
+//////////////////////////////////////////////////////////////////////////////
+
+static bool read_varint(TrnReplayReader * const reader,
+                        uint64_t * const value)
+{
+    int shift;
+    *value = 0;
+    for (shift = 0 ; shift < 64 && reader->position < reader->size ;
+         shift += 7) {
+        uint8_t const byte = reader->bytes[reader->position++];
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/* Read a varint into an int, failing when out of [0, limit]. */
+static bool read_int(TrnReplayReader * const reader,
+                     int * const value,
+                     int const limit)
+{
+    uint64_t read;
+    if (!read_varint(reader, &read) || read > (uint64_t) limit)
+        return false;
+    *value = (int) read;
+    return true;
+}
+
+static bool read_fixed64(TrnReplayReader * const reader,
+                         uint64_t * const value)
+{
+    int index;
+    if (reader->size - reader->position < 8)
+        return false;
+    *value = 0;
+    for (index = 0 ; index < 8 ; index++)
+        *value |= (uint64_t) reader->bytes[reader->position++] << (8 * index);
+    return true;
+}
+
+bool trn_replay_reader_open(TrnReplayReader * const reader,
+                            uint8_t const * const bytes,
+                            size_t const size)
+{
+    uint64_t version;
+    memset(reader, 0, sizeof(TrnReplayReader));
+    reader->bytes = bytes;
+    reader->size = size;
+    if (size < sizeof(MAGIC) || memcmp(bytes, MAGIC, sizeof(MAGIC)))
+        return false;
+    reader->position = sizeof(MAGIC);
+    return read_varint(reader, &version) && version == TRN_REPLAY_VERSION &&
+           read_fixed64(reader, &reader->seed) &&
+           read_int(reader, &reader->numberOfRows, TRN_REPLAY_MAX_ROWS) &&
+           read_int(reader, &reader->numberOfColumns,
+                    TRN_REPLAY_MAX_COLUMNS) &&
+           read_int(reader, &reader->delay, INT32_MAX) &&
+           read_int(reader, &reader->flags, 0xFF) &&
+           read_int(reader, &reader->previewLength,
+                    TRN_PIECE_QUEUE_MAX_PREVIEW) &&
+           reader->numberOfRows > 0 && reader->numberOfColumns > 0;
+}
+
+bool trn_replay_reader_next(TrnReplayReader * const reader,
+                            TrnReplayEvent * const event)
+{
+    uint64_t value;
+    int status;
+    if (reader->isComplete || !read_varint(reader, &value))
+        return false;
+    reader->tick += value >> 4;
+    event->tick = reader->tick;
+    event->input = (TrnReplayInput) (value & 0xF);
+
+    if (event->input == TRN_REPLAY_END) {
+        reader->isComplete = read_int(reader, &status, TRN_GAME_PAUSED) &&
+                             read_int(reader, &reader->score, INT32_MAX) &&
+                             read_int(reader, &reader->lines, INT32_MAX) &&
+                             read_int(reader, &reader->level, INT32_MAX) &&
+                             read_fixed64(reader, &reader->hash);
+        reader->status = (TrnGameStatus) status;
+        return false;
+    }
+    if (event->input >= TRN_NUMBER_OF_REPLAY_INPUTS)
+        return false;
+    if (event->input == TRN_REPLAY_CHECKPOINT)
+        return read_fixed64(reader, &event->hash);
+    if (event->input != TRN_REPLAY_PLACE)
+        return true;
+
+    int columnAndAngle, rowIndex;
+    if (!read_int(reader, &columnAndAngle,
+                  (reader->numberOfColumns + 2 * PLACEMENT_OFFSET) << 2) ||
+        !read_int(reader, &rowIndex,
+                  reader->numberOfRows + 2 * PLACEMENT_OFFSET))
+        return false;
+    event->placement =
+        trn_piece_create(TRN_TETROMINO_VOID,
+                         rowIndex - PLACEMENT_OFFSET,
+                         (columnAndAngle >> 2) - PLACEMENT_OFFSET,
+                         (TrnTetrominoRotationAngle) (columnAndAngle & 3));
+    return true;
+}
+
+TrnGame* trn_replay_new_game(TrnReplayReader const * const reader,
+                             TrnAllocator * const allocator)
+{
+    if (reader->flags & TRN_REPLAY_FLAG_OTHER_RANDOMIZER)
+        return NULL;
+    TrnGame * const game =
+        trn_game_new_with_allocator(reader->numberOfRows,
+                                    reader->numberOfColumns, reader->delay,
+                                    reader->seed, allocator);
+    if (!game)
+        return NULL;
+    trn_game_set_preview_length(game, reader->previewLength);
+    if (reader->flags & TRN_REPLAY_FLAG_UNIFORM_RANDOMIZER)
+        trn_game_set_randomizer(game, trn_randomizer_uniform());
+    trn_game_set_gravity_20g(game,
+                             reader->flags & TRN_REPLAY_FLAG_GRAVITY_20G);
+    return game;
+}
+
+bool trn_replay_reset_game(TrnReplayReader const * const reader,
+                           TrnGame * const game)
+{
+    if (reader->flags & TRN_REPLAY_FLAG_OTHER_RANDOMIZER ||
+        game->grid->numberOfRows != reader->numberOfRows ||
+        game->grid->numberOfColumns != reader->numberOfColumns)
+        return false;
+    game->initial_delay = reader->delay;
+    trn_game_set_preview_length(game, reader->previewLength);
+    trn_game_reset(game, reader->seed);
+    trn_game_set_randomizer(game,
+                            reader->flags & TRN_REPLAY_FLAG_UNIFORM_RANDOMIZER ?
+                            trn_randomizer_uniform() : trn_randomizer_bag());
+    trn_game_set_gravity_20g(game,
+                             reader->flags & TRN_REPLAY_FLAG_GRAVITY_20G);
+    return true;
+}
+
+bool trn_replay_apply(TrnGame * const game,
+                      TrnReplayEvent const * const event)
+{
+    switch (event->input) {
+    case TRN_REPLAY_LEFT:
+        return trn_game_try_to_move_left(game);
+    case TRN_REPLAY_RIGHT:
+        return trn_game_try_to_move_right(game);
+    case TRN_REPLAY_DOWN:
+        return trn_game_try_to_move_down(game);
+    case TRN_REPLAY_ROTATE_CLOCKWISE:
+        return trn_game_try_to_rotate_clockwise(game);
+    case TRN_REPLAY_ROTATE_COUNTER_CLOCKWISE:
+        return trn_game_try_to_rotate_counter_clockwise(game);
+    case TRN_REPLAY_ROTATE_180:
+        return trn_game_try_to_rotate_180(game);
+    case TRN_REPLAY_HARD_DROP:
+        trn_game_move_to_bottom(game);
+        return true;
+    case TRN_REPLAY_HOLD:
+        return trn_game_hold(game);
+    case TRN_REPLAY_PLACE: {
+        TrnPiece placement = event->placement;
+        placement.type = game->current_piece->type;
+        return trn_game_place(game, &placement);
+    }
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,173 @@
+#ifndef TRN_REPLAY_H
+#define TRN_REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "allocator.h"
+
+/* Replays: everything needed to play a game again, the pieces being drawn
+ * from its seed. A replay is a header followed by events, integers being
+ * varints, 7 bits per byte, low bits first:
+ *
+ *   "TRNR" version seed(8 bytes, little endian) rows columns delay flags
+ *           previewLength
+ *   event*  (tickDelta << 4 | input) [placement | hash(8 bytes)]
+ *   end     (tickDelta << 4 | TRN_REPLAY_END) status score lines level
+ *           hash(8 bytes)
+ *
+ * A placement is (column + 4) << 2 | angle, then row + 4, its type being the
+ * one of the current piece. An input is a byte per event while ticks are
+ * close together, a placement three bytes per piece. Every
+ * TRN_REPLAY_CHECKPOINT_PERIOD locked pieces, a checkpoint holds the game
+ * hash, so that a verifier finds where a replay stops matching. */
+
+#define TRN_REPLAY_VERSION 2
+
+#define TRN_REPLAY_CHECKPOINT_PERIOD 64
+
+/* Largest grids of a replay: replays may come from anyone, and a header must
+ * not make a reader allocate without bounds. */
+#define TRN_REPLAY_MAX_ROWS 256
+#define TRN_REPLAY_MAX_COLUMNS 256
+
+#define TRN_REPLAY_FLAG_GRAVITY_20G 1
+#define TRN_REPLAY_FLAG_UNIFORM_RANDOMIZER 2
+/* Pieces drawn by a randomizer of the caller, not replayable. */
+#define TRN_REPLAY_FLAG_OTHER_RANDOMIZER 4
+
+typedef enum {
+    TRN_REPLAY_END,
+    TRN_REPLAY_LEFT,
+    TRN_REPLAY_RIGHT,
+    TRN_REPLAY_DOWN,
+    TRN_REPLAY_ROTATE_CLOCKWISE,
+    TRN_REPLAY_ROTATE_COUNTER_CLOCKWISE,
+    TRN_REPLAY_ROTATE_180,
+    TRN_REPLAY_HARD_DROP,
+    TRN_REPLAY_HOLD,
+    TRN_REPLAY_PLACE,
+    TRN_REPLAY_CHECKPOINT,
+    TRN_NUMBER_OF_REPLAY_INPUTS
+} TrnReplayInput;
+
+/* Writes replays to a file from a thread of its own: recorders hand over
+ * whole replays, under a lock only held to link them in a list, and never
+ * wait for the file. Each replay is written as its size, a varint, then its
+ * bytes. A writer is shared by any number of recorders and threads. */
+typedef struct TrnReplayWriter TrnReplayWriter;
+
+/* Append to the file at path. Return NULL if it cannot be opened. */
+TrnReplayWriter* trn_replay_writer_new(char const * const path);
+
+/* Write the replays handed over so far, then close the file. */
+void trn_replay_writer_destroy(TrnReplayWriter * writer);
+
+/* Hand bytes over to the writer, which releases them with free once
+ * written. */
+void trn_replay_writer_submit(TrnReplayWriter * const writer,
+                              uint8_t * const bytes,
+                              size_t const size);
+
+/* Records the inputs of a game, attached with trn_game_set_recorder, and
+ * hands its replay over to writer when the game ends, is reset or is
+ * destroyed. A recorder is used from the thread of its game. */
+struct TrnReplayRecorder {
+    TrnReplayWriter* writer;
+    uint8_t* bytes;
+    size_t size;
+    size_t capacity;
+    uint64_t tick;     /* current tick, set by the game loop */
+    uint64_t lastTick; /* tick of the last event */
+    int lockedPieces;
+    bool isRecording;
+};
+
+TrnReplayRecorder* trn_replay_recorder_new(TrnReplayWriter * const writer);
+
+void trn_replay_recorder_destroy(TrnReplayRecorder * recorder);
+
+/* Tick of the next events, eg frames or milliseconds, never decreasing
+ * within a replay. Each replay starts at tick 0. */
+void trn_replay_recorder_set_tick(TrnReplayRecorder * const recorder,
+                                  uint64_t const tick);
+
+/* Start a replay of game, from its current settings. */
+void trn_replay_recorder_start(TrnReplayRecorder * const recorder,
+                               TrnGame const * const game);
+
+void trn_replay_recorder_record(TrnReplayRecorder * const recorder,
+                                TrnReplayInput const input,
+                                TrnPiece const * const placement);
+
+/* Count a piece locked in game, and write a checkpoint every
+ * TRN_REPLAY_CHECKPOINT_PERIOD of them. */
+void trn_replay_recorder_piece_locked(TrnReplayRecorder * const recorder,
+                                      TrnGame const * const game);
+
+/* End the replay with the state of game, and hand it over to the writer. */
+void trn_replay_recorder_finish(TrnReplayRecorder * const recorder,
+                                TrnGame const * const game);
+
+/* Read the next replay of a file written by a writer, in memory allocated
+ * with malloc. Return NULL at the end of the file. */
+uint8_t* trn_replay_read(FILE * const file, size_t * const size);
+
+typedef struct {
+    uint64_t tick;
+    TrnReplayInput input;
+    TrnPiece placement; /* of TRN_REPLAY_PLACE, with a void type */
+    uint64_t hash;      /* of TRN_REPLAY_CHECKPOINT */
+} TrnReplayEvent;
+
+/* Reads the header, then the events of a replay in memory. */
+typedef struct {
+    uint8_t const* bytes;
+    size_t size;
+    size_t position;
+    uint64_t seed;
+    int numberOfRows;
+    int numberOfColumns;
+    int delay;
+    int flags;
+    int previewLength;
+    uint64_t tick;
+    /* Set by the end event. */
+    bool isComplete;
+    TrnGameStatus status;
+    int score;
+    int lines;
+    int level;
+    uint64_t hash;
+} TrnReplayReader;
+
+/* Return false if bytes do not start with a valid header. */
+bool trn_replay_reader_open(TrnReplayReader * const reader,
+                            uint8_t const * const bytes,
+                            size_t const size);
+
+/* Return false at the end event, or if the replay is truncated or
+ * corrupted, isComplete telling them apart. */
+bool trn_replay_reader_next(TrnReplayReader * const reader,
+                            TrnReplayEvent * const event);
+
+/* Return a new game with the settings of the replay header, or NULL if its
+ * pieces cannot be drawn again or if it cannot be allocated. */
+TrnGame* trn_replay_new_game(TrnReplayReader const * const reader,
+                             TrnAllocator * const allocator);
+
+/* Start game again with the settings of the replay header, without
+ * allocating. Return false if the grid size differs, or if the pieces of the
+ * replay cannot be drawn again. */
+bool trn_replay_reset_game(TrnReplayReader const * const reader,
+                           TrnGame * const game);
+
+/* Apply the input of event to game, as the game entry points would.
+ * Checkpoints are not inputs, and are left to the caller. */
+bool trn_replay_apply(TrnGame * const game,
+                      TrnReplayEvent const * const event);
+
+#endif
@@ -0,0 +1,251 @@
+#include "scheduler.h"
+#include "allocator.h"
+#include "random.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Ranges are only split in halves, so a deque holds at most one range per
+ * bit of an int, plus the one it was given. The deque is a ring buffer, top
+ * and bottom wrapping around together. */
+#define DEQUE_CAPACITY 64
+
+typedef struct {
+    int begin;
+    int end;
+} Range;
+
+/* Each worker on its own cache lines, so that the deque of a worker is only
+ * shared with the occasional thief. */
+typedef struct {
+    pthread_mutex_t lock;
+    Range ranges[DEQUE_CAPACITY];
+    unsigned top;    /* stolen from */
+    unsigned bottom; /* pushed and popped by the owner */
+    TrnRandom random; /* victims to steal from */
+    pthread_t thread;
+    TrnScheduler* scheduler;
+    int index;
+} __attribute__((aligned(TRN_ALLOCATOR_MAX_ALIGNMENT))) Worker;
+
+struct TrnScheduler {
+    Worker* workers;
+    int numberOfWorkers;
+
+    /* Current loop. */
+    TrnSchedulerTask task;
+    void* context;
+    int grain;
+    int remaining; /* indices not run yet, atomic */
+
+    /* Wakes the threads up for each loop, or for their end. */
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+    pthread_cond_t idle;
+    unsigned generation;
+    int activeThreads;
+    bool shuttingDown;
+};
+
+static void push(Worker * const worker, Range const range)
+{
+    pthread_mutex_lock(&worker->lock);
+    worker->ranges[worker->bottom++ % DEQUE_CAPACITY] = range;
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static bool pop(Worker * const worker, Range * const range)
+{
+    bool found = false;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->bottom != worker->top) {
+        *range = worker->ranges[--worker->bottom % DEQUE_CAPACITY];
+        found = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+static bool steal_from(Worker * const victim, Range * const range)
+{
+    bool found = false;
+    pthread_mutex_lock(&victim->lock);
+    if (victim->bottom != victim->top) {
+        *range = victim->ranges[victim->top++ % DEQUE_CAPACITY];
+        found = true;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return found;
+}
+
+static bool steal(Worker * const worker, Range * const range)
+{
+    TrnScheduler * const scheduler = worker->scheduler;
+    int const count = scheduler->numberOfWorkers;
+    int const first = trn_random_below(&worker->random, count);
+    int offset;
+    for (offset = 0 ; offset < count ; offset++) {
+        Worker * const victim =
+            &scheduler->workers[(first + offset) % count];
+        if (victim != worker && steal_from(victim, range))
+            return true;
+    }
+    return false;
+}
+
+/* Run ranges until the whole loop is done. */
+static void run_loop(Worker * const worker)
+{
+    TrnScheduler * const scheduler = worker->scheduler;
+    Range range;
+
+    while (__atomic_load_n(&scheduler->remaining, __ATOMIC_ACQUIRE) > 0) {
+        if (!pop(worker, &range) && !steal(worker, &range)) {
+            sched_yield();
+            continue;
+        }
+        while (range.end - range.begin > scheduler->grain) {
+            int const middle = range.begin + (range.end - range.begin) / 2;
+            Range const upper = {middle, range.end};
+            push(worker, upper);
+            range.end = middle;
+        }
+        scheduler->task(scheduler->context, range.begin, range.end,
+                        worker->index);
+        __atomic_sub_fetch(&scheduler->remaining, range.end - range.begin,
+                           __ATOMIC_RELEASE);
+    }
+}
+
+static void* run_thread(void* argument)
+{
+    Worker * const worker = (Worker*) argument;
+    TrnScheduler * const scheduler = worker->scheduler;
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&scheduler->lock);
+    while (true) {
+        while (scheduler->generation == generation &&
+               !scheduler->shuttingDown)
+            pthread_cond_wait(&scheduler->wakeUp, &scheduler->lock);
+        if (scheduler->shuttingDown)
+            break;
+        generation = scheduler->generation;
+        pthread_mutex_unlock(&scheduler->lock);
+
+        run_loop(worker);
+
+        pthread_mutex_lock(&scheduler->lock);
+        if (--scheduler->activeThreads == 0)
+            pthread_cond_signal(&scheduler->idle);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return NULL;
+}
+
+TrnScheduler* trn_scheduler_new(int const numberOfWorkers)
+{
+    TrnScheduler* scheduler = (TrnScheduler*) malloc(sizeof(TrnScheduler));
+    int workerIndex;
+
+    scheduler->numberOfWorkers = numberOfWorkers > 0 ? numberOfWorkers :
+                                 (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (scheduler->numberOfWorkers < 1)
+        scheduler->numberOfWorkers = 1;
+    scheduler->workers = (Worker*) trn_allocator_allocate(
+        trn_allocator_heap(), scheduler->numberOfWorkers * sizeof(Worker),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+    scheduler->remaining = 0;
+    scheduler->generation = 0;
+    scheduler->activeThreads = 0;
+    scheduler->shuttingDown = false;
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->wakeUp, NULL);
+    pthread_cond_init(&scheduler->idle, NULL);
+
+    for (workerIndex = 0 ; workerIndex < scheduler->numberOfWorkers ;
+         workerIndex++) {
+        Worker * const worker = &scheduler->workers[workerIndex];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->top = worker->bottom = 0;
+        trn_random_seed(&worker->random, workerIndex);
+        worker->scheduler = scheduler;
+        worker->index = workerIndex;
+        /* Worker 0 is the thread calling trn_scheduler_parallel_for. */
+        if (workerIndex > 0)
+            pthread_create(&worker->thread, NULL, run_thread, worker);
+    }
+    return scheduler;
+}
+
+void trn_scheduler_destroy(TrnScheduler * scheduler)
+{
+    int workerIndex;
+
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->shuttingDown = true;
+    pthread_cond_broadcast(&scheduler->wakeUp);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (workerIndex = 0 ; workerIndex < scheduler->numberOfWorkers ;
+         workerIndex++) {
+        if (workerIndex > 0)
+            pthread_join(scheduler->workers[workerIndex].thread, NULL);
+        pthread_mutex_destroy(&scheduler->workers[workerIndex].lock);
+    }
+    pthread_cond_destroy(&scheduler->idle);
+    pthread_cond_destroy(&scheduler->wakeUp);
+    pthread_mutex_destroy(&scheduler->lock);
+    trn_allocator_release(trn_allocator_heap(), scheduler->workers);
+    free(scheduler);
+}
+
+int trn_scheduler_number_of_workers(TrnScheduler const * const scheduler)
+{
+    return scheduler->numberOfWorkers;
+}
+
+void trn_scheduler_parallel_for(TrnScheduler * const scheduler,
+                                int const count,
+                                int const grain,
+                                TrnSchedulerTask const task,
+                                void * const context)
+{
+    int const numberOfWorkers = scheduler->numberOfWorkers;
+    int workerIndex;
+
+    if (count <= 0)
+        return;
+    scheduler->task = task;
+    scheduler->context = context;
+    scheduler->grain = grain > 0 ? grain : 1;
+    __atomic_store_n(&scheduler->remaining, count, __ATOMIC_RELEASE);
+
+    /* An even share for each worker to start with. */
+    for (workerIndex = 0 ; workerIndex < numberOfWorkers ; workerIndex++) {
+        Range const share = {
+            (int) ((long long) count * workerIndex / numberOfWorkers),
+            (int) ((long long) count * (workerIndex + 1) / numberOfWorkers)
+        };
+        if (share.end > share.begin)
+            push(&scheduler->workers[workerIndex], share);
+    }
+
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->generation++;
+    scheduler->activeThreads = numberOfWorkers - 1;
+    pthread_cond_broadcast(&scheduler->wakeUp);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    run_loop(&scheduler->workers[0]);
+
+    /* The task and its context are not used any more once every thread is
+     * back to sleep. */
+    pthread_mutex_lock(&scheduler->lock);
+    while (scheduler->activeThreads > 0)
+        pthread_cond_wait(&scheduler->idle, &scheduler->lock);
+    pthread_mutex_unlock(&scheduler->lock);
+}
@@ -0,0 +1,35 @@
+#ifndef TRN_SCHEDULER_H
+#define TRN_SCHEDULER_H
+
+/* Pool of worker threads running parallel loops with work stealing: the
+ * range of a loop is spread over the workers, each one splitting its part in
+ * halves on demand and running the smaller half first, while idle workers
+ * steal the bigger halves left by the others.
+ *
+ * Tasks get the index of the worker running them, in [0, numberOfWorkers),
+ * to reach per-worker state without locks. The thread calling
+ * trn_scheduler_parallel_for is worker 0. A scheduler runs one loop at a
+ * time, and tasks must not start loops on it. */
+typedef struct TrnScheduler TrnScheduler;
+
+typedef void (*TrnSchedulerTask)(void * const context,
+                                 int const begin,
+                                 int const end,
+                                 int const workerIndex);
+
+/* numberOfWorkers being 0 means one worker per online processor. */
+TrnScheduler* trn_scheduler_new(int const numberOfWorkers);
+
+void trn_scheduler_destroy(TrnScheduler * scheduler);
+
+int trn_scheduler_number_of_workers(TrnScheduler const * const scheduler);
+
+/* Run task over [0, count), in ranges of at most grain indices, and return
+ * once all of them are done. */
+void trn_scheduler_parallel_for(TrnScheduler * const scheduler,
+                                int const count,
+                                int const grain,
+                                TrnSchedulerTask const task,
+                                void * const context);
+
+#endif
@@ -7,6 +7,12 @@
 #include "tetromino_srs.h"
 #include "grid.h"
 #include "game.h"
+#include "env.h"
+#include "scheduler.h"
+#include "placement.h"
+#include "bot.h"
+#include "replay.h"
+#include "verifier.h"
 #include "init.h"
 
 /* Suite initialization */
@@ -402,6 +408,279 @@ void test_grid_pop_row_and_make_above_fall()
 }
 
 
+void test_grid_pop_middle_row()
+{
+  int numberOfRows = 4;
+  int numberOfColumns = 2;
+  TrnPositionInGrid pos;
+
+  /* Initial grid, one tetromino type per row
+   * +--+
+   * |II| 0
+   * |OO| 1
+   * |TT| 2
+   * |SS| 3
+   * +--+
+   */
+  TrnTetrominoType types[4] = {TRN_TETROMINO_I, TRN_TETROMINO_O,
+                               TRN_TETROMINO_T, TRN_TETROMINO_S};
+  TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnGrid* expected_grid = trn_grid_new(numberOfRows, numberOfColumns);
+  for (pos.rowIndex = 0 ; pos.rowIndex < numberOfRows ; pos.rowIndex++) {
+      for (pos.columnIndex = 0 ; pos.columnIndex < numberOfColumns ;
+           pos.columnIndex++) {
+          trn_grid_set_cell(grid, pos, types[pos.rowIndex]);
+      }
+  }
+
+  trn_grid_pop_row_and_make_above_fall(grid, 2);
+  trn_grid_pop_row_and_make_above_fall(grid, 3);
+
+  /* Expected grid
+   * +--+
+   * |  |
+   * |  |
+   * |II|
+   * |OO|
+   * +--+
+   */
+  for (pos.rowIndex = 2 ; pos.rowIndex < numberOfRows ; pos.rowIndex++) {
+      for (pos.columnIndex = 0 ; pos.columnIndex < numberOfColumns ;
+           pos.columnIndex++) {
+          trn_grid_set_cell(expected_grid, pos, types[pos.rowIndex-2]);
+      }
+  }
+
+  CU_ASSERT_TRUE( trn_grid_equal(grid, expected_grid) );
+
+  trn_grid_destroy(grid);
+  trn_grid_destroy(expected_grid);
+}
+
+void test_grid_pop_first_complete_rows_block()
+{
+  int numberOfRows = 5;
+  int numberOfColumns = 2;
+  TrnPositionInGrid pos;
+
+  /* Initial grid, complete rows are 1, 3 and 4
+   * +--+
+   * |I | 0
+   * |OO| 1
+   * | T| 2
+   * |SS| 3
+   * |ZZ| 4
+   * +--+
+   */
+  TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnPositionInGrid pos0 = {0,0};
+  trn_grid_set_cell(grid, pos0, TRN_TETROMINO_I);
+  TrnPositionInGrid pos2 = {2,1};
+  trn_grid_set_cell(grid, pos2, TRN_TETROMINO_T);
+  TrnTetrominoType types[3] = {TRN_TETROMINO_O, TRN_TETROMINO_S,
+                               TRN_TETROMINO_Z};
+  int completeRowIndices[3] = {1, 3, 4};
+  int index;
+  for (index = 0 ; index < 3 ; index++) {
+      pos.rowIndex = completeRowIndices[index];
+      for (pos.columnIndex = 0 ; pos.columnIndex < numberOfColumns ;
+           pos.columnIndex++) {
+          trn_grid_set_cell(grid, pos, types[index]);
+      }
+  }
+
+  int poppedRowIndices[5];
+  CU_ASSERT_EQUAL(trn_grid_pop_first_complete_rows_block(grid,
+                                                         poppedRowIndices), 3);
+  CU_ASSERT_EQUAL(poppedRowIndices[0], 4);
+  CU_ASSERT_EQUAL(poppedRowIndices[1], 3);
+  CU_ASSERT_EQUAL(poppedRowIndices[2], 1);
+
+  /* Expected grid
+   * +--+
+   * |  |
+   * |  |
+   * |  |
+   * |I |
+   * | T|
+   * +--+
+   */
+  TrnGrid* expected_grid = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnPositionInGrid expectedPos0 = {3,0};
+  trn_grid_set_cell(expected_grid, expectedPos0, TRN_TETROMINO_I);
+  TrnPositionInGrid expectedPos2 = {4,1};
+  trn_grid_set_cell(expected_grid, expectedPos2, TRN_TETROMINO_T);
+
+  CU_ASSERT_TRUE( trn_grid_equal(grid, expected_grid) );
+
+  // Nothing left to pop.
+  CU_ASSERT_EQUAL(trn_grid_pop_first_complete_rows_block(grid, NULL), 0);
+
+  trn_grid_destroy(grid);
+  trn_grid_destroy(expected_grid);
+}
+
+void test_grid_column_heights()
+{
+  int numberOfRows = 6;
+  int numberOfColumns = 4;
+  TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+
+  /* An L piece at TRN_ANGLE_90 in the bottom left corner
+   * +----+
+   * |    | 0
+   * |    | 1
+   * |    | 2
+   * | L  | 3
+   * | L  | 4
+   * | LL | 5
+   * +----+
+   */
+  TrnPiece piece = trn_piece_create(TRN_TETROMINO_L,3,0,TRN_ANGLE_90);
+  trn_grid_fill_piece(grid, &piece);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 0), 0);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 1), 3);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 2), 1);
+  CU_ASSERT_EQUAL(trn_grid_row_filled_count(grid, 5), 2);
+
+  // Removing the top cell of column 1 lowers it to the next one.
+  TrnPositionInGrid pos = {3,1};
+  trn_grid_set_cell(grid, pos, TRN_TETROMINO_VOID);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 1), 2);
+
+  // Complete the bottom row, then pop it from the rows of the piece only.
+  pos.rowIndex = 5;
+  for (pos.columnIndex = 0 ; pos.columnIndex < numberOfColumns ;
+       pos.columnIndex++) {
+      trn_grid_set_cell(grid, pos, TRN_TETROMINO_I);
+  }
+  CU_ASSERT_EQUAL(trn_grid_row_filled_count(grid, 5), 4);
+  CU_ASSERT_EQUAL(trn_grid_pop_complete_rows_in_range(grid, 0, 2, NULL), 0);
+  CU_ASSERT_EQUAL(trn_grid_pop_complete_rows_in_range(grid, 3, 5, NULL), 1);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 0), 0);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 1), 1);
+  CU_ASSERT_EQUAL(trn_grid_column_height(grid, 3), 0);
+
+  trn_grid_destroy(grid);
+}
+
+void test_grid_equal_and_refresh_occupancy()
+{
+  // Wide enough for the rows to span several vector registers.
+  int numberOfRows = 3;
+  int numberOfColumns = 50;
+  TrnGrid* left = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnGrid* right = trn_grid_new(numberOfRows, numberOfColumns);
+
+  CU_ASSERT_TRUE( trn_grid_equal(left, right) );
+
+  // Same occupancy, different tetromino types.
+  TrnPositionInGrid pos = {1,45};
+  trn_grid_set_cell(left, pos, TRN_TETROMINO_S);
+  trn_grid_set_cell(right, pos, TRN_TETROMINO_Z);
+  CU_ASSERT_FALSE( trn_grid_equal(left, right) );
+  trn_grid_set_cell(right, pos, TRN_TETROMINO_S);
+  CU_ASSERT_TRUE( trn_grid_equal(left, right) );
+
+  // Filling then clearing a row leaves the row as a void one.
+  trn_grid_fill(left, TRN_TETROMINO_T);
+  CU_ASSERT_TRUE( trn_grid_is_row_complete(left, 2) );
+  trn_grid_clear_row(left, 0);
+  trn_grid_clear_row(left, 2);
+  trn_grid_clear_row(right, 1);
+  CU_ASSERT_FALSE( trn_grid_equal(left, right) );
+  trn_grid_clear_row(left, 1);
+  CU_ASSERT_TRUE( trn_grid_equal(left, right) );
+
+  // Cells written directly are taken into account once refreshed.
+  left->tetrominoTypes[2][0] = TRN_TETROMINO_J;
+  left->tetrominoTypes[2][49] = TRN_TETROMINO_L;
+  trn_grid_refresh_occupancy(left);
+  CU_ASSERT_EQUAL(left->rowBits[2], ((TrnGridRowBits) 1 << 49) | 1);
+  CU_ASSERT_EQUAL(trn_grid_column_height(left, 49), 1);
+
+  trn_grid_destroy(left);
+  trn_grid_destroy(right);
+}
+
+void test_grid_snapshot()
+{
+  int numberOfRows = 6;
+  int numberOfColumns = 4;
+  TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnPiece piece = trn_piece_create(TRN_TETROMINO_O,3,0,TRN_ANGLE_0);
+  trn_grid_fill_piece(grid, &piece);
+
+  TrnGrid* snapshot = trn_grid_snapshot(grid);
+  CU_ASSERT_TRUE( trn_grid_equal(grid, snapshot) );
+  CU_ASSERT_PTR_EQUAL(grid->tetrominoTypes[4], snapshot->tetrominoTypes[4]);
+
+  // Writing a snapshot row copies that row only.
+  TrnPiece other = trn_piece_create(TRN_TETROMINO_O,3,2,TRN_ANGLE_0);
+  trn_grid_fill_piece(snapshot, &other);
+  CU_ASSERT_TRUE( trn_grid_is_row_complete(snapshot, 4) );
+  CU_ASSERT_FALSE( trn_grid_is_row_complete(grid, 4) );
+  CU_ASSERT_PTR_NOT_EQUAL(grid->tetrominoTypes[4], snapshot->tetrominoTypes[4]);
+  CU_ASSERT_PTR_EQUAL(grid->tetrominoTypes[0], snapshot->tetrominoTypes[0]);
+  TrnPositionInGrid pos = {4,2};
+  CU_ASSERT_EQUAL(trn_grid_get_cell(grid, pos), TRN_TETROMINO_VOID);
+  CU_ASSERT_EQUAL(trn_grid_get_cell(snapshot, pos), TRN_TETROMINO_O);
+
+  // Snapshot of a snapshot, then clear lines in it.
+  TrnGrid* child = trn_grid_snapshot(snapshot);
+  CU_ASSERT_EQUAL(trn_grid_pop_first_complete_rows_block(child, NULL), 2);
+  CU_ASSERT_EQUAL(trn_grid_column_height(child, 0), 0);
+  CU_ASSERT_EQUAL(trn_grid_column_height(snapshot, 0), 2);
+  CU_ASSERT_TRUE( trn_grid_is_row_complete(snapshot, 4) );
+
+  // The parent can go first, its rows live as long as they are shared.
+  trn_grid_destroy(grid);
+  CU_ASSERT_EQUAL(trn_grid_get_cell(snapshot, pos), TRN_TETROMINO_O);
+  pos.columnIndex = 0;
+  CU_ASSERT_EQUAL(trn_grid_get_cell(snapshot, pos), TRN_TETROMINO_O);
+  trn_grid_destroy(snapshot);
+  trn_grid_destroy(child);
+}
+
+void test_grid_hash()
+{
+  int numberOfRows = 4;
+  int numberOfColumns = 4;
+  TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+  TrnGrid* other = trn_grid_new(numberOfRows, numberOfColumns);
+
+  CU_ASSERT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+
+  // Same cells set in a different order give the same hash.
+  TrnPositionInGrid pos0 = {3,0};
+  TrnPositionInGrid pos1 = {2,1};
+  trn_grid_set_cell(grid, pos0, TRN_TETROMINO_T);
+  trn_grid_set_cell(grid, pos1, TRN_TETROMINO_Z);
+  CU_ASSERT_NOT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+  trn_grid_set_cell(other, pos1, TRN_TETROMINO_Z);
+  trn_grid_set_cell(other, pos0, TRN_TETROMINO_T);
+  CU_ASSERT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+
+  // Fill row 1, then pop it: the grids are the same again.
+  TrnPiece piece = trn_piece_create(TRN_TETROMINO_I,0,0,TRN_ANGLE_0);
+  trn_grid_fill_piece(grid, &piece);
+  CU_ASSERT_NOT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+  CU_ASSERT_EQUAL(trn_grid_hash(grid), trn_grid_compute_hash(grid));
+  trn_grid_pop_first_complete_rows_block(grid, NULL);
+  CU_ASSERT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+
+  // The Z cell falling to the last row changes the hash.
+  trn_grid_pop_row_and_make_above_fall(other, 3);
+  CU_ASSERT_NOT_EQUAL(trn_grid_hash(grid), trn_grid_hash(other));
+  CU_ASSERT_EQUAL(trn_grid_hash(other), trn_grid_compute_hash(other));
+
+  trn_grid_clear(grid);
+  CU_ASSERT_EQUAL(trn_grid_hash(grid), 0);
+
+  trn_grid_destroy(grid);
+  trn_grid_destroy(other);
+}
+
 void test_grid_find_last_complete_row_index()
 {
   int numberOfRows = 4;
@@ -437,10 +716,207 @@ void test_grid_find_last_complete_row_index()
   CU_ASSERT_EQUAL(tnr_grid_find_last_complete_row_index(grid), -1)
 }
 
+void test_grid_row_bits()
+{
+    // Create a grid.
+    int numberOfRows = 10;
+    int numberOfColumns = 10;
+    TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+
+    CU_ASSERT_EQUAL(grid->fullRowBits, 0x3FF);
+
+    // A T piece at TRN_ANGLE_0 with its top left corner on (2,3).
+    TrnPiece piece = trn_piece_create(TRN_TETROMINO_T,2,3,TRN_ANGLE_0);
+    trn_grid_fill_piece(grid, &piece);
+    CU_ASSERT_EQUAL(grid->rowBits[2], 0x10);
+    CU_ASSERT_EQUAL(grid->rowBits[3], 0x38);
+
+    // The same piece, one row below, overlaps the first one.
+    TrnPiece below = trn_piece_create(TRN_TETROMINO_T,3,3,TRN_ANGLE_0);
+    CU_ASSERT_FALSE( trn_grid_can_set_cells_with_piece(grid, &below) );
+    trn_grid_remove_piece(grid, &piece);
+    CU_ASSERT_TRUE( trn_grid_can_set_cells_with_piece(grid, &below) );
+    CU_ASSERT_EQUAL(grid->rowBits[2], 0);
+    CU_ASSERT_EQUAL(grid->rowBits[3], 0);
+
+    // Single cells update the bitboard too.
+    TrnPositionInGrid pos = {9,9};
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_O);
+    CU_ASSERT_EQUAL(grid->rowBits[9], 0x200);
+    trn_grid_fill(grid, TRN_TETROMINO_O);
+    CU_ASSERT_TRUE( trn_grid_is_row_complete(grid, 0) );
+    trn_grid_clear_row(grid, 0);
+    CU_ASSERT_FALSE( trn_grid_is_row_complete(grid, 0) );
+    CU_ASSERT_EQUAL(grid->rowBits[0], 0);
+
+    trn_grid_destroy(grid);
+}
+
+void test_grid_wide_rows()
+{
+    // 130 columns take three words per row, the last one of 2 columns.
+    int numberOfRows = 6;
+    int numberOfColumns = 130;
+    TrnGrid* grid = trn_grid_new(numberOfRows, numberOfColumns);
+    CU_ASSERT_EQUAL(grid->rowWords, 3);
+    CU_ASSERT_EQUAL(grid->fullRowBits, 0x3);
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), numberOfRows);
+
+    // A T piece straddling the first two words.
+    TrnPiece piece = trn_piece_create(TRN_TETROMINO_T,2,62,TRN_ANGLE_0);
+    trn_grid_fill_piece(grid, &piece);
+    CU_ASSERT_EQUAL(trn_grid_row_bits(grid, 2)[0], (TrnGridRowBits) 1 << 63);
+    CU_ASSERT_EQUAL(trn_grid_row_bits(grid, 3)[0], (TrnGridRowBits) 3 << 62);
+    CU_ASSERT_EQUAL(trn_grid_row_bits(grid, 3)[1], 1);
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), 2);
+    CU_ASSERT_EQUAL(trn_grid_column_height(grid, 64), 3);
+    TrnPiece below = trn_piece_create(TRN_TETROMINO_T,3,62,TRN_ANGLE_0);
+    CU_ASSERT_FALSE( trn_grid_can_set_cells_with_piece(grid, &below) );
+    trn_grid_remove_piece(grid, &piece);
+    CU_ASSERT_TRUE( trn_grid_can_set_cells_with_piece(grid, &below) );
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), numberOfRows);
+
+    // Complete the bottom row and pop it.
+    TrnPositionInGrid pos = {numberOfRows-1, 0};
+    for (pos.columnIndex = 0 ; pos.columnIndex < numberOfColumns ;
+         pos.columnIndex++)
+        trn_grid_set_cell(grid, pos, TRN_TETROMINO_I);
+    pos.rowIndex = numberOfRows-2;
+    pos.columnIndex = 129;
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_O);
+    CU_ASSERT_TRUE( trn_grid_is_row_complete(grid, numberOfRows-1) );
+    CU_ASSERT_EQUAL(trn_grid_row_filled_count(grid, numberOfRows-1), 130);
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), numberOfRows-2);
+    CU_ASSERT_EQUAL(trn_grid_pop_first_complete_rows_block(grid, NULL), 1);
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), numberOfRows-1);
+    CU_ASSERT_EQUAL(trn_grid_row_bits(grid, numberOfRows-1)[2], 0x2);
+    CU_ASSERT_EQUAL(trn_grid_column_height(grid, 129), 1);
+    CU_ASSERT_EQUAL(trn_grid_column_height(grid, 0), 0);
+    CU_ASSERT_EQUAL(trn_grid_hash(grid), trn_grid_compute_hash(grid));
+
+    trn_grid_destroy(grid);
+}
+
+void test_grid_drop_distance()
+{
+    TrnGrid* grid = trn_grid_new(10, 10);
+    TrnPositionInGrid pos = {7, 4};
+
+    // An empty grid: down to the floor.
+    TrnPiece piece = trn_piece_create(TRN_TETROMINO_T,0,3,TRN_ANGLE_0);
+    CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, &piece), 8);
+
+    // Above the stack: down to the highest cell of the piece columns.
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_O);
+    CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, &piece), 5);
+    piece.topLeftCorner.rowIndex = 5;
+    CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, &piece), 0);
+
+    // Under an overhang: down to the floor.
+    pos.rowIndex = 3;
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_O);
+    pos.rowIndex = 7;
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_VOID);
+    piece = trn_piece_create(TRN_TETROMINO_I,4,2,TRN_ANGLE_0);
+    CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, &piece), 4);
+
+    trn_grid_destroy(grid);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // TrnTetrominos suite tests
 //////////////////////////////////////////////////////////////////////////////
 
+void test_tetromino_shapes()
+{
+    int type, angle, squareIndex, index;
+    for (type = 0 ; type < TRN_NUMBER_OF_TETROMINO ; type++) {
+        for (angle = 0 ; angle < TRN_TETROMINO_NUMBER_OF_ROTATIONS ; angle++) {
+            TrnTetrominoShape const * const shape =
+                &TRN_ALL_TETROMINO_SHAPES[type][angle];
+            int rowMasks[TRN_TETROMINO_GRID_SIZE] = {0, 0, 0, 0};
+            int columnBottoms[TRN_TETROMINO_GRID_SIZE] = {-1, -1, -1, -1};
+            int firstRowIndex = TRN_TETROMINO_GRID_SIZE, lastRowIndex = -1;
+            int firstColumnIndex = TRN_TETROMINO_GRID_SIZE;
+            int lastColumnIndex = -1;
+
+            // Derive everything again from the coordinates.
+            for (squareIndex = 0 ;
+                 squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
+                 squareIndex++) {
+                TrnPositionInGrid const square =
+                    TRN_ALL_TETROMINO_FOUR_ROTATIONS[type][angle][squareIndex];
+                CU_ASSERT_TRUE( trn_position_in_grid_equal(
+                    square, shape->squares[squareIndex]) );
+                rowMasks[square.rowIndex] |= 1 << square.columnIndex;
+                if (square.rowIndex > columnBottoms[square.columnIndex])
+                    columnBottoms[square.columnIndex] = square.rowIndex;
+                if (square.rowIndex < firstRowIndex)
+                    firstRowIndex = square.rowIndex;
+                if (square.rowIndex > lastRowIndex)
+                    lastRowIndex = square.rowIndex;
+                if (square.columnIndex < firstColumnIndex)
+                    firstColumnIndex = square.columnIndex;
+                if (square.columnIndex > lastColumnIndex)
+                    lastColumnIndex = square.columnIndex;
+            }
+
+            for (index = 0 ; index < TRN_TETROMINO_GRID_SIZE ; index++) {
+                CU_ASSERT_EQUAL(shape->rowMasks[index], rowMasks[index]);
+                CU_ASSERT_EQUAL(shape->columnBottoms[index],
+                                columnBottoms[index]);
+            }
+            CU_ASSERT_EQUAL(shape->firstRowIndex, firstRowIndex);
+            CU_ASSERT_EQUAL(shape->lastRowIndex, lastRowIndex);
+            CU_ASSERT_EQUAL(shape->firstColumnIndex, firstColumnIndex);
+            CU_ASSERT_EQUAL(shape->lastColumnIndex, lastColumnIndex);
+        }
+    }
+}
+
+
+
+void test_srs_find_kick()
+{
+    TrnGrid* grid = trn_grid_new(10, 10);
+    TrnPiece rotated;
+
+    // In the open, rotations happen in place.
+    TrnPiece piece = trn_piece_create(TRN_TETROMINO_T,4,4,TRN_ANGLE_0);
+    CU_ASSERT_EQUAL(trn_srs_find_kick(grid, &piece, TRN_ROTATION_CLOCKWISE,
+                                      &rotated), 0);
+    CU_ASSERT_TRUE( trn_piece_equal(rotated,
+        trn_piece_create(TRN_TETROMINO_T,4,4,TRN_ANGLE_90)) );
+    CU_ASSERT_EQUAL(trn_srs_find_kick(grid, &piece,
+                                      TRN_ROTATION_COUNTER_CLOCKWISE,
+                                      &rotated), 0);
+    CU_ASSERT_EQUAL(rotated.angle, TRN_ANGLE_270);
+    CU_ASSERT_EQUAL(trn_srs_find_kick(grid, &piece, TRN_ROTATION_180,
+                                      &rotated), 0);
+    CU_ASSERT_EQUAL(rotated.angle, TRN_ANGLE_180);
+
+    // Against the left wall, R -> 2 is kicked one column to the right.
+    piece = trn_piece_create(TRN_TETROMINO_T,4,-1,TRN_ANGLE_90);
+    CU_ASSERT_TRUE( trn_grid_can_set_cells_with_piece(grid, &piece) );
+    CU_ASSERT_EQUAL(trn_srs_find_kick(grid, &piece, TRN_ROTATION_CLOCKWISE,
+                                      &rotated), 1);
+    CU_ASSERT_TRUE( trn_piece_equal(rotated,
+        trn_piece_create(TRN_TETROMINO_T,4,0,TRN_ANGLE_180)) );
+
+    // An I piece in a one column well cannot lie down.
+    trn_grid_fill(grid, TRN_TETROMINO_O);
+    TrnPositionInGrid pos = {0, 5};
+    for (pos.rowIndex = 0 ; pos.rowIndex < 10 ; pos.rowIndex++)
+        trn_grid_set_cell(grid, pos, TRN_TETROMINO_VOID);
+    piece = trn_piece_create(TRN_TETROMINO_I,4,3,TRN_ANGLE_90);
+    CU_ASSERT_TRUE( trn_grid_can_set_cells_with_piece(grid, &piece) );
+    rotated = piece;
+    CU_ASSERT_EQUAL(trn_srs_find_kick(grid, &piece, TRN_ROTATION_CLOCKWISE,
+                                      &rotated), -1);
+    CU_ASSERT_TRUE( trn_piece_equal(rotated, piece) );
+
+    trn_grid_destroy(grid);
+}
 
 //////////////////////////////////////////////////////////////////////////////
 // TrnPiece suite tests
@@ -511,13 +987,1108 @@ void test_game_new_destroy()
     int numberOfRows = 3;
     int numberOfColumns = 2;
     int delay = 500;
-    TrnGame* game = trn_game_new(numberOfRows, numberOfColumns, delay);
+    TrnGame* game = trn_game_new(numberOfRows, numberOfColumns, delay, 1);
 
     // Destroy the game.
     trn_game_destroy(game);
 }
 
 
+void test_game_hash()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 1);
+    uint64_t spawnHash = trn_game_hash(game);
+    CU_ASSERT_EQUAL(spawnHash, trn_game_compute_hash(game));
+
+    // Moving the piece changes the hash, moving it back restores it.
+    CU_ASSERT_TRUE( trn_game_try_to_move_left(game) );
+    CU_ASSERT_NOT_EQUAL(trn_game_hash(game), spawnHash);
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+    CU_ASSERT_TRUE( trn_game_try_to_move_right(game) );
+    CU_ASSERT_EQUAL(trn_game_hash(game), spawnHash);
+
+    trn_game_move_to_bottom(game);
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+
+    trn_game_destroy(game);
+}
+
+
+void test_game_piece_overlay()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 1);
+    TrnGrid* grid = game->grid;
+    TrnPiece* piece = game->current_piece;
+    int squareIndex;
+
+    // The falling piece is not written in the grid, only seen through it.
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), 20);
+    CU_ASSERT_TRUE( trn_game_try_to_move_down(game) );
+    CU_ASSERT_TRUE( trn_game_try_to_rotate_clockwise(game) );
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(grid), 20);
+    for (squareIndex = 0 ;
+         squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
+         squareIndex++) {
+        TrnPositionInGrid pos = trn_piece_position_in_grid(piece, squareIndex);
+        CU_ASSERT_TRUE( trn_game_piece_covers(game, pos) );
+        CU_ASSERT_EQUAL(trn_game_get_cell(game, pos), piece->type);
+        CU_ASSERT_EQUAL(trn_grid_get_cell(grid, pos), TRN_TETROMINO_VOID);
+    }
+
+    // It is merged once locked.
+    TrnPiece locked = *piece;
+    while (trn_game_try_to_move_down(game))
+        locked = *piece;
+    for (squareIndex = 0 ;
+         squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES ;
+         squareIndex++) {
+        TrnPositionInGrid pos = trn_piece_position_in_grid(&locked,
+                                                           squareIndex);
+        CU_ASSERT_EQUAL(trn_grid_get_cell(grid, pos), locked.type);
+    }
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+
+    trn_game_destroy(game);
+}
+
+void test_game_gravity_20g()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 1);
+    TrnPiece ghost = trn_game_ghost_piece(game);
+    CU_ASSERT_TRUE( trn_game_drop_distance(game) > 0 );
+
+    // The piece lands at once, on its ghost, and locks on the next move down.
+    trn_game_set_gravity_20g(game, true);
+    CU_ASSERT_EQUAL(trn_game_drop_distance(game), 0);
+    CU_ASSERT_TRUE( trn_piece_equal(*game->current_piece, ghost) );
+    CU_ASSERT_FALSE( trn_game_try_to_move_down(game) );
+    CU_ASSERT_EQUAL(trn_grid_stack_top_row_index(game->grid),
+                    ghost.topLeftCorner.rowIndex +
+                    TRN_ALL_TETROMINO_SHAPES[ghost.type][ghost.angle]
+                    .firstRowIndex);
+    CU_ASSERT_EQUAL(trn_game_drop_distance(game), 0);
+
+    trn_game_destroy(game);
+}
+
+void test_piece_queue_bag()
+{
+    TrnPieceQueue queue;
+    trn_piece_queue_init(&queue, trn_randomizer_bag(), 42, 3);
+    CU_ASSERT_EQUAL(queue.previewLength, 3);
+
+    // Every bag holds each tetromino once.
+    int bagIndex, index;
+    for (bagIndex = 0 ; bagIndex < 10 ; bagIndex++) {
+        int counts[TRN_NUMBER_OF_TETROMINO] = {0};
+        for (index = 0 ; index < TRN_NUMBER_OF_TETROMINO ; index++) {
+            TrnTetrominoType type = trn_piece_queue_peek(&queue, 0);
+            CU_ASSERT_EQUAL(trn_piece_queue_pop(&queue), type);
+            counts[type]++;
+        }
+        for (index = 0 ; index < TRN_NUMBER_OF_TETROMINO ; index++)
+            CU_ASSERT_EQUAL(counts[index], 1);
+    }
+
+    // The preview length is clamped.
+    trn_piece_queue_set_preview_length(&queue, 1000);
+    CU_ASSERT_EQUAL(queue.previewLength, TRN_PIECE_QUEUE_MAX_PREVIEW);
+    CU_ASSERT_TRUE(queue.count >= TRN_PIECE_QUEUE_MAX_PREVIEW);
+}
+
+void test_random_seed()
+{
+    TrnRandom first, second;
+    uint64_t values[8];
+    int index;
+
+    // The same seed gives the same sequence, one value or many at a time.
+    trn_random_seed(&first, 7);
+    trn_random_seed(&second, 7);
+    trn_random_fill(&second, values, 8);
+    for (index = 0 ; index < 8 ; index++)
+        CU_ASSERT_EQUAL(trn_random_next(&first), values[index]);
+    for (index = 0 ; index < 100 ; index++) {
+        int const value = trn_random_below(&first, 7);
+        CU_ASSERT_EQUAL(trn_random_below(&second, 7), value);
+        CU_ASSERT_TRUE(value >= 0 && value < 7);
+    }
+    trn_random_seed(&second, 8);
+    CU_ASSERT_NOT_EQUAL(trn_random_next(&first), trn_random_next(&second));
+
+    // Games with the same seed get the same pieces.
+    TrnGame* game = trn_game_new(20, 10, 500, 123);
+    TrnGame* same = trn_game_new(20, 10, 500, 123);
+    TrnTetrominoType types[20];
+    TrnRandom random;
+    trn_random_seed(&random, 123);
+    trn_randomizer_generate(trn_randomizer_bag(), &random, types, 20);
+    for (index = 0 ; index < 20 ; index++) {
+        CU_ASSERT_EQUAL(game->current_piece->type, types[index]);
+        CU_ASSERT_EQUAL(same->current_piece->type, types[index]);
+        trn_game_next_piece(game);
+        trn_game_next_piece(same);
+    }
+    trn_game_destroy(game);
+    trn_game_destroy(same);
+}
+
+void test_game_hold()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 1);
+    trn_game_set_preview_length(game, 5);
+    CU_ASSERT_EQUAL(game->hold_type, TRN_TETROMINO_VOID);
+
+    // The first hold takes the current piece and spawns the next one.
+    TrnTetrominoType first = game->current_piece->type;
+    TrnTetrominoType second = trn_game_preview(game, 0);
+    TrnTetrominoType third = trn_game_preview(game, 1);
+    uint64_t hash = trn_game_hash(game);
+    CU_ASSERT_TRUE(trn_game_hold(game));
+    CU_ASSERT_EQUAL(game->hold_type, first);
+    CU_ASSERT_EQUAL(game->current_piece->type, second);
+    CU_ASSERT_EQUAL(trn_game_preview(game, 0), third);
+    CU_ASSERT_NOT_EQUAL(trn_game_hash(game), hash);
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+
+    // Only once per piece.
+    CU_ASSERT_FALSE(trn_game_hold(game));
+
+    // After a lock, the hold swaps with the current piece, at the top.
+    trn_game_move_to_bottom(game);
+    CU_ASSERT_EQUAL(game->current_piece->type, third);
+    CU_ASSERT_TRUE(trn_game_hold(game));
+    CU_ASSERT_EQUAL(game->hold_type, third);
+    CU_ASSERT_EQUAL(game->current_piece->type, first);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.rowIndex, 0);
+    CU_ASSERT_EQUAL(game->current_piece->angle, TRN_ANGLE_0);
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+
+    trn_game_destroy(game);
+}
+
+static int count_cells(uint8_t const * const plane, int const size,
+                       uint8_t const value)
+{
+    int count = 0, index;
+    for (index = 0 ; index < size ; index++)
+        count += plane[index] == value;
+    return count;
+}
+
+void test_env_step()
+{
+    int const numberOfGames = 16;
+    int const size = 20 * 10;
+    TrnEnv* env = trn_env_new(numberOfGames, 20, 10, 5);
+    TrnEnv* same = trn_env_new(numberOfGames, 20, 10, 5);
+    uint8_t actions[16];
+    int gameIndex, stepIndex;
+
+    // The first observations only show the current pieces.
+    for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++) {
+        uint8_t const* plane = trn_env_observation(env, gameIndex);
+        CU_ASSERT_EQUAL(count_cells(plane, size, TRN_ENV_CELL_PIECE), 4);
+        CU_ASSERT_EQUAL(count_cells(plane, size, TRN_ENV_CELL_LOCKED), 0);
+    }
+
+    // A hard drop locks 4 cells.
+    memset(actions, TRN_ACTION_HARD_DROP, numberOfGames);
+    trn_env_step(env, actions);
+    trn_env_step(same, actions);
+    for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++) {
+        uint8_t const* plane = trn_env_observation(env, gameIndex);
+        CU_ASSERT_EQUAL(count_cells(plane, size, TRN_ENV_CELL_LOCKED), 4);
+        CU_ASSERT_EQUAL(env->rewards[gameIndex], 0);
+        CU_ASSERT_FALSE(env->dones[gameIndex]);
+    }
+
+    // Games end and are reset within the step, the same way for the same
+    // seed.
+    int doneCount = 0;
+    for (stepIndex = 0 ; stepIndex < 100 ; stepIndex++) {
+        for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++)
+            actions[gameIndex] = (stepIndex + gameIndex) %
+                                 TRN_NUMBER_OF_ACTIONS;
+        trn_env_step(env, actions);
+        trn_env_step(same, actions);
+        for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++) {
+            if (!env->dones[gameIndex])
+                continue;
+            doneCount++;
+            CU_ASSERT_EQUAL(count_cells(trn_env_observation(env, gameIndex),
+                                        size, TRN_ENV_CELL_LOCKED), 0);
+            CU_ASSERT_EQUAL(env->games[gameIndex]->status, TRN_GAME_ON);
+        }
+    }
+    CU_ASSERT_TRUE(doneCount > 0);
+    CU_ASSERT_EQUAL(memcmp(env->observations, same->observations,
+                           numberOfGames * size), 0);
+    CU_ASSERT_EQUAL(memcmp(env->dones, same->dones, numberOfGames), 0);
+
+    trn_env_destroy(env);
+    trn_env_destroy(same);
+}
+
+typedef struct {
+    int runs[10000];
+    int badWorkers;
+    int numberOfWorkers;
+} SchedulerTestContext;
+
+static void count_runs(void * const context, int const begin, int const end,
+                       int const workerIndex)
+{
+    SchedulerTestContext * const test = (SchedulerTestContext*) context;
+    int index;
+    for (index = begin ; index < end ; index++)
+        __atomic_add_fetch(&test->runs[index], 1, __ATOMIC_RELAXED);
+    if (workerIndex < 0 || workerIndex >= test->numberOfWorkers)
+        __atomic_add_fetch(&test->badWorkers, 1, __ATOMIC_RELAXED);
+}
+
+void test_scheduler_parallel_for()
+{
+    static SchedulerTestContext test;
+    TrnScheduler* scheduler = trn_scheduler_new(4);
+    int loopIndex, index;
+
+    CU_ASSERT_EQUAL(trn_scheduler_number_of_workers(scheduler), 4);
+    test.numberOfWorkers = 4;
+
+    // Every index runs once per loop, whatever the grain, loop after loop.
+    for (loopIndex = 0 ; loopIndex < 20 ; loopIndex++)
+        trn_scheduler_parallel_for(scheduler, 10000, 1 + loopIndex * 7,
+                                   count_runs, &test);
+    for (index = 0 ; index < 10000 ; index++)
+        CU_ASSERT_EQUAL(test.runs[index], 20);
+    CU_ASSERT_EQUAL(test.badWorkers, 0);
+
+    trn_scheduler_destroy(scheduler);
+}
+
+void test_placement_finder()
+{
+    int const expectedCounts[TRN_NUMBER_OF_TETROMINO] = {
+        [TRN_TETROMINO_I] = 17, [TRN_TETROMINO_O] = 9,
+        [TRN_TETROMINO_T] = 34, [TRN_TETROMINO_S] = 17,
+        [TRN_TETROMINO_Z] = 17, [TRN_TETROMINO_J] = 34,
+        [TRN_TETROMINO_L] = 34
+    };
+    TrnGrid* grid = trn_grid_new(20, 10);
+    TrnPlacementFinder* finder = trn_placement_finder_new(20, 10);
+    int type, index;
+
+    // On an empty grid, one placement per column and distinct orientation,
+    // with or without tucks.
+    for (type = 0 ; type < TRN_NUMBER_OF_TETROMINO ; type++) {
+        TrnPiece piece = trn_piece_create(type, 0, 3, TRN_ANGLE_0);
+        CU_ASSERT_EQUAL(trn_placement_finder_find(finder, grid, &piece, false),
+                        expectedCounts[type]);
+        CU_ASSERT_EQUAL(trn_placement_finder_find(finder, grid, &piece, true),
+                        expectedCounts[type]);
+        for (index = 0 ; index < finder->numberOfPlacements ; index++) {
+            TrnPiece const* placement = &finder->placements[index];
+            CU_ASSERT_TRUE(trn_grid_can_set_cells_with_piece(grid, placement));
+            CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, placement), 0);
+        }
+    }
+
+    // Under an overhang, only tucks reach the cave on the left.
+    TrnPositionInGrid pos = {16, 0};
+    for (pos.columnIndex = 0 ; pos.columnIndex < 6 ; pos.columnIndex++)
+        trn_grid_set_cell(grid, pos, TRN_TETROMINO_I);
+    TrnPiece piece = trn_piece_create(TRN_TETROMINO_O, 0, 3, TRN_ANGLE_0);
+    int const withoutTucks =
+        trn_placement_finder_find(finder, grid, &piece, false);
+    int const withTucks =
+        trn_placement_finder_find(finder, grid, &piece, true);
+    CU_ASSERT_EQUAL(withoutTucks, 9);
+    CU_ASSERT_EQUAL(withTucks, 9 + 6);
+    bool tucked = false;
+    for (index = 0 ; index < withTucks ; index++) {
+        TrnPiece const* placement = &finder->placements[index];
+        CU_ASSERT_EQUAL(trn_grid_drop_distance(grid, placement), 0);
+        tucked |= placement->topLeftCorner.columnIndex == 0 &&
+                  placement->topLeftCorner.rowIndex == 17;
+    }
+    CU_ASSERT_TRUE(tucked);
+
+    // No placement for a piece that does not fit.
+    trn_grid_fill(grid, TRN_TETROMINO_I);
+    CU_ASSERT_EQUAL(trn_placement_finder_find(finder, grid, &piece, true), 0);
+
+    trn_placement_finder_destroy(finder);
+    trn_grid_destroy(grid);
+}
+
+void test_bot()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 7);
+    TrnPlacementFinder* finder = trn_placement_finder_new(20, 10);
+    TrnBotFeatures features, placed, expected;
+    int index, pieces;
+
+    // Incremental features match the ones computed from scratch, over the
+    // placements of a game played by the bot.
+    TrnBot* bot = trn_bot_new(20, 10, trn_bot_default_settings(), NULL);
+    CU_ASSERT_PTR_NOT_NULL(bot);
+    for (pieces = 0 ; pieces < 50 && game->status == TRN_GAME_ON ;
+         pieces++) {
+        trn_bot_compute_features(game->grid, &features);
+        int const numberOfPlacements =
+            trn_placement_finder_find(finder, game->grid, game->current_piece,
+                                      true);
+        for (index = 0 ; index < numberOfPlacements ; index++) {
+            TrnPiece const* placement = &finder->placements[index];
+            if (trn_bot_place_features(game->grid, &features, placement,
+                                       &placed))
+                continue;
+            TrnGrid* grid = trn_grid_snapshot(game->grid);
+            trn_grid_fill_piece(grid, placement);
+            trn_bot_compute_features(grid, &expected);
+            CU_ASSERT_EQUAL(memcmp(&placed, &expected, sizeof(placed)), 0);
+            trn_grid_destroy(grid);
+        }
+        CU_ASSERT_TRUE(trn_bot_play(bot, game));
+    }
+
+    // The bot keeps clearing lines, with or without a scheduler.
+    TrnScheduler* scheduler = trn_scheduler_new(2);
+    TrnBot* parallelBot = trn_bot_new(20, 10, trn_bot_default_settings(),
+                                      scheduler);
+    TrnGame* parallelGame = trn_game_new(20, 10, 500, 7);
+    trn_game_reset(game, 7);
+    for (pieces = 0 ; pieces < 500 ; pieces++) {
+        TrnPiece placement, parallelPlacement;
+        if (!trn_bot_choose(bot, game, &placement) ||
+            !trn_bot_choose(parallelBot, parallelGame, &parallelPlacement))
+            break;
+        CU_ASSERT_EQUAL(memcmp(&placement, &parallelPlacement,
+                               sizeof(TrnPiece)), 0);
+        CU_ASSERT_TRUE(trn_game_place(game, &placement));
+        CU_ASSERT_TRUE(trn_game_place(parallelGame, &placement));
+    }
+    CU_ASSERT_EQUAL(pieces, 500);
+    CU_ASSERT_EQUAL(game->status, TRN_GAME_ON);
+    CU_ASSERT_TRUE(game->lines_count >= 150);
+    CU_ASSERT_TRUE(trn_grid_equal(game->grid, parallelGame->grid));
+
+    // With 20G gravity, placements are reached from where the piece fell.
+    trn_game_reset(game, 8);
+    trn_game_set_gravity_20g(game, true);
+    for (pieces = 0 ; pieces < 50 && game->status == TRN_GAME_ON ;
+         pieces++) {
+        TrnPiece placement;
+        if (!trn_bot_choose(bot, game, &placement))
+            break;
+        int const count = trn_placement_finder_find(
+            finder, game->grid, game->current_piece,
+            trn_bot_default_settings().withTucks);
+        int index, isReachable = 0;
+        for (index = 0 ; index < count ; index++)
+            isReachable |= !memcmp(&finder->placements[index], &placement,
+                                   sizeof(TrnPiece));
+        CU_ASSERT_TRUE(isReachable);
+        trn_game_place(game, &placement);
+    }
+    CU_ASSERT_TRUE(pieces > 10);
+
+    trn_game_destroy(parallelGame);
+    trn_bot_destroy(parallelBot);
+    trn_scheduler_destroy(scheduler);
+    trn_bot_destroy(bot);
+    trn_placement_finder_destroy(finder);
+    trn_game_destroy(game);
+}
+
+void test_replay()
+{
+    char const * const path = "test_replay.trnr";
+    remove(path);
+    TrnReplayWriter* writer = trn_replay_writer_new(path);
+    CU_ASSERT_PTR_NOT_NULL(writer);
+    TrnReplayRecorder* recorder = trn_replay_recorder_new(writer);
+    TrnPlacementFinder* finder = trn_placement_finder_new(20, 10);
+    TrnGame* game = trn_game_new(20, 10, 500, 3);
+    TrnRandom random;
+    int scores[2], replayIndex, input;
+    uint64_t hashes[2];
+
+    // Two games, the second one drawn from the uniform randomizer: random
+    // inputs, and placements from the finder.
+    trn_random_seed(&random, 3);
+    trn_game_set_recorder(game, recorder);
+    for (replayIndex = 0 ; replayIndex < 2 ; replayIndex++) {
+        uint64_t tick = 0;
+        while (game->status == TRN_GAME_ON) {
+            tick += trn_random_below(&random, 40);
+            trn_replay_recorder_set_tick(recorder, tick);
+            input = 1 + trn_random_below(&random, TRN_REPLAY_PLACE);
+            switch (input) {
+            case TRN_REPLAY_LEFT: trn_game_try_to_move_left(game); break;
+            case TRN_REPLAY_RIGHT: trn_game_try_to_move_right(game); break;
+            case TRN_REPLAY_DOWN: trn_game_try_to_move_down(game); break;
+            case TRN_REPLAY_ROTATE_CLOCKWISE:
+                trn_game_try_to_rotate_clockwise(game); break;
+            case TRN_REPLAY_ROTATE_COUNTER_CLOCKWISE:
+                trn_game_try_to_rotate_counter_clockwise(game); break;
+            case TRN_REPLAY_ROTATE_180: trn_game_try_to_rotate_180(game); break;
+            case TRN_REPLAY_HOLD: trn_game_hold(game); break;
+            default: {
+                int const count = trn_placement_finder_find(
+                    finder, game->grid, game->current_piece, true);
+                if (count)
+                    trn_game_place(game, &finder->placements[
+                        trn_random_below(&random, count)]);
+                else
+                    trn_game_move_to_bottom(game);
+            }
+            }
+        }
+        scores[replayIndex] = game->score;
+        hashes[replayIndex] = trn_game_hash(game);
+        if (replayIndex == 0) {
+            trn_game_set_randomizer(game, trn_randomizer_uniform());
+            trn_game_reset(game, 4);
+        }
+    }
+    trn_game_destroy(game);
+    trn_replay_writer_destroy(writer);
+    trn_replay_recorder_destroy(recorder);
+
+    // Playing the replays again ends in the same games.
+    FILE* file = fopen(path, "rb");
+    CU_ASSERT_PTR_NOT_NULL(file);
+    size_t size;
+    uint8_t* bytes;
+    int replays = 0;
+    while ((bytes = trn_replay_read(file, &size))) {
+        TrnReplayReader reader;
+        TrnReplayEvent event;
+        CU_ASSERT_TRUE(trn_replay_reader_open(&reader, bytes, size));
+        TrnGame* replayed = trn_replay_new_game(&reader, trn_allocator_heap());
+        uint64_t lastTick = 0;
+        while (trn_replay_reader_next(&reader, &event)) {
+            CU_ASSERT_TRUE(event.tick >= lastTick);
+            lastTick = event.tick;
+            trn_replay_apply(replayed, &event);
+        }
+        CU_ASSERT_TRUE(reader.isComplete);
+        CU_ASSERT_EQUAL(reader.position, size);
+        CU_ASSERT_EQUAL(reader.status, TRN_GAME_OVER);
+        CU_ASSERT_EQUAL(replayed->status, TRN_GAME_OVER);
+        CU_ASSERT_EQUAL(trn_game_hash(replayed), reader.hash);
+        CU_ASSERT_EQUAL(replayed->score, reader.score);
+        if (replays < 2) {
+            CU_ASSERT_EQUAL(reader.score, scores[replays]);
+            CU_ASSERT_EQUAL(reader.hash, hashes[replays]);
+        }
+        trn_game_destroy(replayed);
+        free(bytes);
+        replays++;
+    }
+    CU_ASSERT_EQUAL(replays, 2);
+    fclose(file);
+    remove(path);
+    trn_placement_finder_destroy(finder);
+}
+
+void test_verifier()
+{
+    char const * const path = "test_verifier.trnr";
+    enum { NUMBER_OF_REPLAYS = 6, PIECES = 200 };
+    remove(path);
+    TrnReplayWriter* writer = trn_replay_writer_new(path);
+    TrnReplayRecorder* recorder = trn_replay_recorder_new(writer);
+    TrnBotSettings settings = trn_bot_default_settings();
+    settings.beamWidth = 1;
+    TrnBot* bot = trn_bot_new(20, 10, settings, NULL);
+    TrnGame* game = trn_game_new(20, 10, 500, 0);
+    int replayIndex, pieces;
+
+    // Bot games, with a longer preview, over several checkpoints.
+    trn_game_set_preview_length(game, 3);
+    for (replayIndex = 0 ; replayIndex < NUMBER_OF_REPLAYS ; replayIndex++) {
+        trn_game_reset(game, replayIndex);
+        if (!game->recorder)
+            trn_game_set_recorder(game, recorder);
+        for (pieces = 0 ; pieces < PIECES && trn_bot_play(bot, game) ;
+             pieces++)
+            trn_replay_recorder_set_tick(recorder, pieces);
+    }
+    trn_game_destroy(game);
+    trn_replay_writer_destroy(writer);
+    trn_replay_recorder_destroy(recorder);
+    trn_bot_destroy(bot);
+
+    uint8_t* replays[NUMBER_OF_REPLAYS];
+    size_t sizes[NUMBER_OF_REPLAYS];
+    TrnVerification results[NUMBER_OF_REPLAYS];
+    FILE* file = fopen(path, "rb");
+    for (replayIndex = 0 ; replayIndex < NUMBER_OF_REPLAYS ; replayIndex++)
+        replays[replayIndex] = trn_replay_read(file, &sizes[replayIndex]);
+    CU_ASSERT_PTR_NULL(trn_replay_read(file, &sizes[0]));
+    fclose(file);
+    remove(path);
+
+    TrnScheduler* scheduler = trn_scheduler_new(2);
+    TrnVerifier* verifier = trn_verifier_new(scheduler);
+    trn_verifier_verify(verifier, (uint8_t const * const *) replays, sizes,
+                        NUMBER_OF_REPLAYS, results);
+    for (replayIndex = 0 ; replayIndex < NUMBER_OF_REPLAYS ; replayIndex++) {
+        CU_ASSERT_EQUAL(results[replayIndex].status, TRN_VERIFICATION_VALID);
+        CU_ASSERT_TRUE(results[replayIndex].lines > 0);
+    }
+
+    // A placement moved one row down diverges at the next checkpoint.
+    TrnReplayReader reader;
+    TrnReplayEvent event;
+    uint64_t tamperedTick = 0;
+    int events = 0;
+    trn_replay_reader_open(&reader, replays[0], sizes[0]);
+    while (trn_replay_reader_next(&reader, &event))
+        if (event.input == TRN_REPLAY_PLACE && ++events == 100) {
+            tamperedTick = event.tick;
+            replays[0][reader.position - 1]++;
+            break;
+        }
+    // The level, written before the hash, no longer matches.
+    replays[1][sizes[1] - 9]++;
+    // Truncated.
+    sizes[2]--;
+    // Unknown randomizer: the flags follow the magic, the version, the seed,
+    // the size and the delay, 500 taking two bytes.
+    replays[3][4 + 1 + 8 + 1 + 1 + 2] |= TRN_REPLAY_FLAG_OTHER_RANDOMIZER;
+
+    trn_verifier_verify(verifier, (uint8_t const * const *) replays, sizes,
+                        NUMBER_OF_REPLAYS, results);
+    CU_ASSERT_EQUAL(results[0].status, TRN_VERIFICATION_DIVERGED);
+    CU_ASSERT_TRUE(results[0].divergenceTick >= tamperedTick);
+    CU_ASSERT_TRUE(results[0].divergenceTick <
+                   tamperedTick + TRN_REPLAY_CHECKPOINT_PERIOD);
+    CU_ASSERT_EQUAL(results[1].status, TRN_VERIFICATION_MISMATCH);
+    CU_ASSERT_EQUAL(results[2].status, TRN_VERIFICATION_CORRUPTED);
+    CU_ASSERT_EQUAL(results[3].status, TRN_VERIFICATION_UNSUPPORTED);
+    CU_ASSERT_EQUAL(results[4].status, TRN_VERIFICATION_VALID);
+
+    // A header asking for a huge grid is refused before anything is
+    // allocated.
+    uint8_t huge[] = {'T', 'R', 'N', 'R', TRN_REPLAY_VERSION,
+                      0, 0, 0, 0, 0, 0, 0, 0,
+                      0x80, 0x80, 0x04, 0x80, 0x80, 0x04, 0, 0, 1,
+                      TRN_REPLAY_END, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t const * hugeReplay = huge;
+    size_t const hugeSize = sizeof(huge);
+    trn_verifier_verify(verifier, &hugeReplay, &hugeSize, 1, results);
+    CU_ASSERT_EQUAL(results[0].status, TRN_VERIFICATION_CORRUPTED);
+
+    trn_verifier_destroy(verifier);
+    trn_scheduler_destroy(scheduler);
+    for (replayIndex = 0 ; replayIndex < NUMBER_OF_REPLAYS ; replayIndex++)
+        free(replays[replayIndex]);
+}
+
+void test_game_tick()
+{
+    uint64_t const frame = 10000000;
+    TrnGame* game = trn_game_new(20, 10, 500, 5);
+    TrnGameTiming timing = trn_game_default_timing();
+    timing.frameNanoseconds = frame;
+    CU_ASSERT_TRUE(trn_game_set_timing(game, timing));
+    TrnPiece const spawned = *game->current_piece;
+    uint64_t const start = 1000 * frame;
+    int frames;
+
+    // 50 frames per cell at level 0, whatever the rate of the ticks.
+    CU_ASSERT_EQUAL(trn_game_tick(game, start, 0), 1);
+    CU_ASSERT_EQUAL(trn_game_tick(game, start + frame / 2, 0), 0);
+    CU_ASSERT_EQUAL(trn_game_tick(game, start + 48 * frame, 0), 48);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.rowIndex,
+                    spawned.topLeftCorner.rowIndex);
+    CU_ASSERT_EQUAL(trn_game_tick(game, start + 49 * frame, 0), 1);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.rowIndex,
+                    spawned.topLeftCorner.rowIndex + 1);
+    CU_ASSERT_EQUAL(game->clock.frames, 50);
+
+    // A press shorter than a frame still acts, once.
+    TrnPiece const beforeRotation = *game->current_piece;
+    trn_game_tick(game, start + 49 * frame + 1, TRN_INPUT_ROTATE_CLOCKWISE);
+    trn_game_tick(game, start + 50 * frame, 0);
+    CU_ASSERT_EQUAL(game->current_piece->angle,
+                    (beforeRotation.angle + 1) % 4);
+
+    // DAS then ARR: a shift at the press, the next one dasFrames later, then
+    // one every arrFrames.
+    uint64_t now = start + 50 * frame;
+    int const column = game->current_piece->topLeftCorner.columnIndex;
+    now += frame;
+    trn_game_tick(game, now, TRN_INPUT_LEFT);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.columnIndex,
+                    column - 1);
+    now += (timing.dasFrames - 1) * frame;
+    trn_game_tick(game, now, TRN_INPUT_LEFT);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.columnIndex,
+                    column - 1);
+    now += frame;
+    trn_game_tick(game, now, TRN_INPUT_LEFT);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.columnIndex,
+                    column - 2);
+    now += timing.arrFrames * frame;
+    trn_game_tick(game, now, TRN_INPUT_LEFT);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.columnIndex,
+                    column - 3);
+    now += frame;
+    trn_game_tick(game, now, 0);
+
+    // On the ground, the piece locks after the lock delay, restarted by a
+    // move.
+    trn_game_set_gravity_20g(game, true);
+    TrnPiece const landed = *game->current_piece;
+    CU_ASSERT_EQUAL(trn_game_drop_distance(game), 0);
+    now += (timing.lockDelayFrames - 2) * frame;
+    trn_game_tick(game, now, 0);
+    CU_ASSERT_TRUE(trn_piece_equal(*game->current_piece, landed));
+    now += frame;
+    trn_game_tick(game, now, TRN_INPUT_RIGHT);
+    CU_ASSERT_EQUAL(game->current_piece->type, landed.type);
+    // The frame of the move counts as the first one on the ground.
+    for (frames = 2 ; frames < timing.lockDelayFrames ; frames++) {
+        now += frame;
+        trn_game_tick(game, now, 0);
+    }
+    CU_ASSERT_EQUAL(game->current_piece->type, landed.type);
+    CU_ASSERT_EQUAL(game->current_piece->topLeftCorner.columnIndex,
+                    landed.topLeftCorner.columnIndex + 1);
+    TrnGameEvent events[TRN_GAME_EVENTS_CAPACITY];
+    trn_game_poll_events(game, events, TRN_GAME_EVENTS_CAPACITY, NULL);
+    now += frame;
+    trn_game_tick(game, now, 0);
+    CU_ASSERT_TRUE(trn_game_poll_events(game, events,
+                                        TRN_GAME_EVENTS_CAPACITY, NULL) > 0);
+    CU_ASSERT_EQUAL(events[0].type, TRN_GAME_EVENT_PIECE_LOCKED);
+
+    // A hard drop locks at once.
+    TrnTetrominoType const next = trn_game_preview(game, 0);
+    now += frame;
+    trn_game_tick(game, now, TRN_INPUT_HARD_DROP);
+    CU_ASSERT_EQUAL(game->current_piece->type, next);
+
+    // Timings that would divide by zero or count frames below zero are
+    // refused.
+    TrnGameTiming invalid = timing;
+    invalid.frameNanoseconds = 0;
+    CU_ASSERT_FALSE(trn_game_set_timing(game, invalid));
+    invalid = timing;
+    invalid.dasFrames = -1;
+    CU_ASSERT_FALSE(trn_game_set_timing(game, invalid));
+    invalid = timing;
+    invalid.softDropFactor = 0;
+    CU_ASSERT_FALSE(trn_game_set_timing(game, invalid));
+    CU_ASSERT_EQUAL(game->clock.timing.frameNanoseconds, frame);
+
+    // A stall runs a bounded number of frames, then the ticks go on at the
+    // usual rate.
+    uint64_t const framesBefore = game->clock.frames;
+    now += 100000 * frame;
+    CU_ASSERT_EQUAL(trn_game_tick(game, now, 0), TRN_GAME_TICK_MAX_FRAMES);
+    CU_ASSERT_EQUAL(game->clock.frames,
+                    framesBefore + TRN_GAME_TICK_MAX_FRAMES);
+    CU_ASSERT_EQUAL(trn_game_tick(game, now, 0), 0);
+    CU_ASSERT_EQUAL(trn_game_tick(game, now + frame, 0), 1);
+    trn_game_destroy(game);
+}
+
+void test_counters()
+{
+    char const * const path = "test_counters.trnc";
+    TrnCounters counters, totals;
+    int index, moves, locks = 0;
+    uint64_t sum = 0;
+
+    trn_counters_reset();
+    TrnGame* game = trn_game_new(20, 10, 500, 8);
+    for (moves = 0 ; moves < 8 ; moves++)
+        trn_game_try_to_move_left(game);
+    trn_game_try_to_rotate_clockwise(game);
+    for (locks = 0 ; locks < 3 ; locks++)
+        trn_game_move_to_bottom(game);
+    trn_game_tick(game, 0, 0);
+    trn_game_tick(game, 1000000000, 0);
+    trn_game_read_counters(game, &counters);
+    trn_counters_read(&totals);
+
+    if (!trn_counters_enabled()) {
+        CU_ASSERT_FALSE(trn_counters_publish(path));
+        CU_ASSERT_EQUAL(counters.moveAttempts[TRN_COUNTED_MOVE_LEFT], 0);
+        CU_ASSERT_EQUAL(totals.lineClears[0], 0);
+        trn_game_destroy(game);
+        return;
+    }
+    CU_ASSERT_EQUAL(counters.moveAttempts[TRN_COUNTED_MOVE_LEFT], 8);
+    CU_ASSERT_TRUE(counters.failedMoves[TRN_COUNTED_MOVE_LEFT] > 0);
+    CU_ASSERT_TRUE(counters.failedMoves[TRN_COUNTED_MOVE_LEFT] < 8);
+    CU_ASSERT_EQUAL(counters.moveAttempts[TRN_COUNTED_ROTATION], 1);
+    for (index = 0 ; index < TRN_NUMBER_OF_TETROMINO ; index++)
+        sum += counters.spawnedPieces[index];
+    CU_ASSERT_TRUE(sum >= 4);
+    CU_ASSERT_TRUE(counters.lineClears[0] >= 3);
+    for (index = 0, sum = 0 ; index < TRN_COUNTERS_LATENCY_BUCKETS ; index++)
+        sum += counters.lockToSpawn[index];
+    CU_ASSERT_EQUAL(sum, counters.lineClears[0]);
+    for (index = 0, sum = 0 ; index < TRN_COUNTERS_LATENCY_BUCKETS ; index++)
+        sum += counters.ticks[index];
+    CU_ASSERT_EQUAL(sum, 2);
+    CU_ASSERT_EQUAL(memcmp(&counters, &totals, sizeof(counters)), 0);
+    CU_ASSERT_EQUAL(trn_counters_bucket(0), 0);
+    CU_ASSERT_EQUAL(trn_counters_bucket(1000), 9);
+
+    // Published, the totals go on in the file.
+    CU_ASSERT_TRUE(trn_counters_publish(path));
+    trn_game_move_to_bottom(game);
+    trn_counters_read(&totals);
+    FILE* file = fopen(path, "rb");
+    TrnCountersFileHeader header;
+    TrnCounters published;
+    CU_ASSERT_EQUAL(fread(&header, sizeof(header), 1, file), 1);
+    CU_ASSERT_EQUAL(fread(&published, sizeof(published), 1, file), 1);
+    fclose(file);
+    CU_ASSERT_EQUAL(memcmp(header.magic, "TRNC", 4), 0);
+    CU_ASSERT_EQUAL(header.size, sizeof(header) + sizeof(published));
+    CU_ASSERT_EQUAL(published.lineClears[0], counters.lineClears[0] + 1);
+    CU_ASSERT_EQUAL(memcmp(&published, &totals, sizeof(totals)), 0);
+    remove(path);
+
+    trn_game_reset(game, 9);
+    trn_game_read_counters(game, &counters);
+    CU_ASSERT_EQUAL(counters.lineClears[0], 0);
+    trn_game_destroy(game);
+}
+
+void test_game_events()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 5);
+    TrnGameEvent batch[TRN_GAME_EVENTS_CAPACITY];
+    uint64_t lost;
+    int count, rowIndex, columnIndex;
+
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, &lost);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_STARTED);
+    CU_ASSERT_EQUAL(batch[1].type, TRN_GAME_EVENT_PIECE_SPAWNED);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[1].to, *game->current_piece));
+    CU_ASSERT_EQUAL(lost, 0);
+
+    TrnPiece const spawned = *game->current_piece;
+    trn_game_try_to_move_left(game);
+    trn_game_try_to_rotate_clockwise(game);
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_PIECE_MOVED);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[0].from, spawned));
+    CU_ASSERT_TRUE(trn_piece_equal(batch[0].to, batch[1].from));
+    CU_ASSERT_EQUAL(batch[1].type, TRN_GAME_EVENT_PIECE_ROTATED);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[1].to, *game->current_piece));
+
+    // Two complete rows but for the cells of a vertical I on the right.
+    TrnPositionInGrid pos;
+    for (rowIndex = 18 ; rowIndex < 20 ; rowIndex++)
+        for (columnIndex = 0 ; columnIndex < 9 ; columnIndex++) {
+            pos.rowIndex = rowIndex;
+            pos.columnIndex = columnIndex;
+            trn_grid_set_cell(game->grid, pos, TRN_TETROMINO_O);
+        }
+    TrnPiece placement = trn_piece_create(TRN_TETROMINO_I, 16, 7,
+                                          TRN_ANGLE_90);
+    game->current_piece->type = TRN_TETROMINO_I;
+    trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_TRUE(trn_game_place(game, &placement));
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 5);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_PIECE_MOVED);
+    CU_ASSERT_EQUAL(batch[1].type, TRN_GAME_EVENT_PIECE_LOCKED);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[1].to, placement));
+    CU_ASSERT_EQUAL(batch[2].type, TRN_GAME_EVENT_ROWS_CLEARED);
+    CU_ASSERT_EQUAL(batch[2].rowsCount, 2);
+    CU_ASSERT_EQUAL(batch[2].rowIndices[0], 19);
+    CU_ASSERT_EQUAL(batch[2].rowIndices[1], 18);
+    CU_ASSERT_EQUAL(batch[3].type, TRN_GAME_EVENT_SCORE_CHANGED);
+    CU_ASSERT_EQUAL(batch[3].previousValue, 0);
+    CU_ASSERT_EQUAL(batch[3].value, game->score);
+    CU_ASSERT_EQUAL(batch[4].type, TRN_GAME_EVENT_PIECE_SPAWNED);
+
+    // A consumer falling behind loses the oldest events, and is told so.
+    int moves;
+    for (moves = 0 ; moves < TRN_GAME_EVENTS_CAPACITY + 3 ; moves++)
+        trn_game_try_to_rotate_clockwise(game);
+    count = trn_game_poll_events(game, batch, 4, &lost);
+    CU_ASSERT_EQUAL(count, 4);
+    CU_ASSERT_EQUAL(lost, 3);
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, &lost);
+    CU_ASSERT_EQUAL(count, TRN_GAME_EVENTS_CAPACITY - 4);
+    CU_ASSERT_EQUAL(lost, 0);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[count - 1].to,
+                                   *game->current_piece));
+
+    while (game->status == TRN_GAME_ON)
+        trn_game_move_to_bottom(game);
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(batch[count - 1].type, TRN_GAME_EVENT_GAME_OVER);
+    trn_game_reset(game, 6);
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_STARTED);
+
+    // The held piece is replaced by the next one.
+    TrnPiece const held = *game->current_piece;
+    CU_ASSERT_TRUE(trn_game_hold(game));
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_PIECE_SPAWNED);
+    CU_ASSERT_EQUAL(batch[1].type, TRN_GAME_EVENT_PIECE_HELD);
+    CU_ASSERT_TRUE(trn_piece_equal(batch[1].from, held));
+    CU_ASSERT_TRUE(trn_piece_equal(batch[1].to, *game->current_piece));
+
+    // A game restored from a save starts once.
+    size_t const size = trn_game_save_size(game);
+    void* save = malloc(size);
+    trn_game_save(game, save);
+    TrnGame* copy = trn_game_new_from_save(save, size, trn_allocator_heap());
+    count = trn_game_poll_events(copy, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 1);
+    CU_ASSERT_EQUAL(batch[0].type, TRN_GAME_EVENT_STARTED);
+    free(save);
+    trn_game_destroy(copy);
+
+    // A hold topping out ends the game, with no hold event after it.
+    trn_game_next_piece(game);
+    for (rowIndex = 0 ; rowIndex < 2 ; rowIndex++)
+        for (columnIndex = 0 ; columnIndex < 10 ; columnIndex++) {
+            pos.rowIndex = rowIndex;
+            pos.columnIndex = columnIndex;
+            trn_grid_set_cell(game->grid, pos, TRN_TETROMINO_O);
+        }
+    trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_FALSE(trn_game_hold(game));
+    CU_ASSERT_EQUAL(game->status, TRN_GAME_OVER);
+    count = trn_game_poll_events(game, batch, TRN_GAME_EVENTS_CAPACITY, NULL);
+    CU_ASSERT_EQUAL(count, 1);
+    CU_ASSERT_EQUAL(batch[count - 1].type, TRN_GAME_EVENT_GAME_OVER);
+    trn_game_destroy(game);
+}
+
+static void* failing_allocate(TrnAllocator * const allocator,
+                              size_t const size,
+                              size_t const alignment)
+{
+    (void) allocator;
+    (void) size;
+    (void) alignment;
+    return NULL;
+}
+
+static void failing_release(TrnAllocator * const allocator,
+                            void * const memory)
+{
+    (void) allocator;
+    (void) memory;
+}
+
+void test_game_out_of_memory()
+{
+    TrnAllocator failing = {failing_allocate, failing_release};
+    CU_ASSERT_PTR_NULL(trn_game_new_with_allocator(20, 10, 500, 1,
+                                                   &failing));
+}
+
+void test_game_save_restore()
+{
+    char const * const path = "test_game_save.trng";
+    TrnBotSettings settings = trn_bot_default_settings();
+    settings.beamWidth = 1;
+    TrnBot* bot = trn_bot_new(20, 10, settings, NULL);
+    TrnGame* game = trn_game_new(20, 10, 500, 7);
+    int pieces;
+
+    trn_game_set_preview_length(game, 3);
+    for (pieces = 0 ; pieces < 30 ; pieces++)
+        trn_bot_play(bot, game);
+    trn_game_hold(game);
+    size_t const size = trn_game_save_size(game);
+    void* save = malloc(size);
+    void* again = malloc(size);
+    CU_ASSERT_EQUAL(trn_game_save(game, save), size);
+    uint64_t const savedHash = trn_game_hash(game);
+    int const savedScore = game->score;
+
+    // Going on from the save draws the same pieces, to the same game.
+    for (pieces = 0 ; pieces < 40 ; pieces++)
+        trn_bot_play(bot, game);
+    uint64_t const laterHash = trn_game_hash(game);
+    int const laterLines = game->lines_count;
+    CU_ASSERT_TRUE(trn_game_restore(game, save, size));
+    CU_ASSERT_EQUAL(trn_game_hash(game), savedHash);
+    CU_ASSERT_EQUAL(trn_game_hash(game), trn_game_compute_hash(game));
+    CU_ASSERT_EQUAL(game->score, savedScore);
+    trn_game_save(game, again);
+    CU_ASSERT_EQUAL(memcmp(save, again, size), 0);
+    for (pieces = 0 ; pieces < 40 ; pieces++)
+        trn_bot_play(bot, game);
+    CU_ASSERT_EQUAL(trn_game_hash(game), laterHash);
+    CU_ASSERT_EQUAL(game->lines_count, laterLines);
+
+    TrnGame* copy = trn_game_new_from_save(save, size, trn_allocator_heap());
+    CU_ASSERT_PTR_NOT_NULL(copy);
+    CU_ASSERT_EQUAL(trn_game_hash(copy), savedHash);
+    CU_ASSERT_EQUAL(copy->queue.previewLength, 3);
+
+    // Through a file, after the save of another game.
+    FILE* file = fopen(path, "wb");
+    CU_ASSERT_TRUE(trn_game_save_to_file(copy, file));
+    CU_ASSERT_TRUE(trn_game_save_to_file(game, file));
+    fclose(file);
+    file = fopen(path, "rb");
+    CU_ASSERT_TRUE(trn_game_restore_from_file(copy, file));
+    CU_ASSERT_EQUAL(trn_game_hash(copy), savedHash);
+    CU_ASSERT_TRUE(trn_game_restore_from_file(copy, file));
+    CU_ASSERT_EQUAL(trn_game_hash(copy), laterHash);
+    CU_ASSERT_TRUE(trn_grid_equal(copy->grid, game->grid));
+    CU_ASSERT_FALSE(trn_game_restore_from_file(copy, file));
+    fclose(file);
+    remove(path);
+
+    // Not a save, truncated, or of another grid size.
+    CU_ASSERT_FALSE(trn_game_restore(copy, save, size - 1));
+    ((char*) save)[0] = 'X';
+    CU_ASSERT_FALSE(trn_game_restore(copy, save, size));
+    CU_ASSERT_PTR_NULL(trn_game_new_from_save(save, size,
+                                              trn_allocator_heap()));
+    TrnGame* other = trn_game_new(22, 10, 500, 7);
+    CU_ASSERT_FALSE(trn_game_restore(other, again, size));
+    CU_ASSERT_EQUAL(trn_game_hash(copy), laterHash);
+
+    free(save);
+    free(again);
+    trn_game_destroy(other);
+    trn_game_destroy(copy);
+    trn_game_destroy(game);
+    trn_bot_destroy(bot);
+}
+
+void test_game_save_restore_checks()
+{
+    TrnGame* game = trn_game_new(20, 10, 500, 3);
+    TrnGame* copy = trn_game_new(20, 10, 500, 4);
+    size_t const size = trn_game_save_size(game);
+    void* save = malloc(size);
+
+    // A fresh game, whatever its queue slots were allocated with.
+    trn_game_save(game, save);
+    CU_ASSERT_TRUE(trn_game_restore(copy, save, size));
+    CU_ASSERT_EQUAL(trn_game_hash(copy), trn_game_hash(game));
+    TrnGame* fresh = trn_game_new_from_save(save, size, trn_allocator_heap());
+    CU_ASSERT_PTR_NOT_NULL(fresh);
+    trn_game_destroy(fresh);
+
+    // Saves of values out of range are refused, leaving the game as is.
+    TrnGame* other = trn_game_new(20, 10, 500, 5);
+    uint64_t const otherHash = trn_game_hash(other);
+    int corruption;
+    for (corruption = 0 ; corruption < 12 ; corruption++) {
+        trn_game_restore(copy, save, size);
+        switch (corruption) {
+        case 0: copy->current_piece->topLeftCorner.rowIndex = 30; break;
+        case 1: copy->current_piece->topLeftCorner.columnIndex = -3; break;
+        case 2: copy->queue.types[copy->queue.first] = TRN_TETROMINO_VOID;
+                break;
+        case 3: copy->grid->stackTopRowIndex = 21; break;
+        case 4: copy->grid->columnHeights[4] = -1; break;
+        case 5: copy->grid->tetrominoTypes[19][0] = TRN_TETROMINO_VOID + 1;
+                break;
+        // Occupancy beyond the columns, or out of step with the cells.
+        case 6: copy->grid->rowBits[19 * copy->grid->rowWords] |=
+                    (TrnGridRowBits) 1 << 63;
+                break;
+        case 7: copy->grid->rowBits[19 * copy->grid->rowWords] |= 1; break;
+        case 8: copy->grid->rowHashes[19] ^= 1; break;
+        case 9: copy->grid->hash ^= 1; break;
+        case 10: copy->grid->columnHeights[4] = 3; break;
+        case 11: copy->level = -1; break;
+        }
+        void* corrupted = malloc(size);
+        trn_game_save(copy, corrupted);
+        CU_ASSERT_FALSE(trn_game_restore(other, corrupted, size));
+        CU_ASSERT_EQUAL(trn_game_hash(other), otherHash);
+        CU_ASSERT_PTR_NULL(trn_game_new_from_save(corrupted, size,
+                                                  trn_allocator_heap()));
+        free(corrupted);
+        // Restores only copy the rows up to the stack top.
+        copy->grid->tetrominoTypes[19][0] = TRN_TETROMINO_VOID;
+    }
+
+    free(save);
+    trn_game_destroy(other);
+    trn_game_destroy(copy);
+    trn_game_destroy(game);
+}
+
+void test_game_with_arena()
+{
+    TrnArena* arena = trn_arena_new(64 * 1024);
+    TrnGame* game = trn_game_new_with_allocator(20, 10, 500, 1, &arena->base);
+    CU_ASSERT_PTR_NOT_NULL(game);
+    CU_ASSERT_PTR_EQUAL(game->allocator, &arena->base);
+
+    // Play the game to its end: no more memory is taken from the arena.
+    TrnArenaChunk* chunks = arena->chunks;
+    TrnPiece* piece = game->current_piece;
+    while (game->status == TRN_GAME_ON) {
+        trn_game_move_to_bottom(game);
+        trn_game_end_piece(game);
+        CU_ASSERT_PTR_EQUAL(game->current_piece, piece);
+    }
+    CU_ASSERT_PTR_EQUAL(arena->chunks, chunks);
+
+    // Nor when the bot plays it: its boards are not taken from the arena.
+    TrnBotSettings settings = trn_bot_default_settings();
+    settings.beamWidth = 4;
+    TrnBot* bot = trn_bot_new(20, 10, settings, NULL);
+    int pieces;
+    trn_game_reset(game, 2);
+    for (pieces = 0 ; pieces < 200 && game->status == TRN_GAME_ON ; pieces++)
+        trn_bot_play(bot, game);
+    CU_ASSERT_PTR_EQUAL(arena->chunks, chunks);
+    trn_bot_destroy(bot);
+
+    // The whole game is released with the arena.
+    trn_arena_reset(arena);
+    game = trn_game_new_with_allocator(20, 10, 500, 1, &arena->base);
+    CU_ASSERT_PTR_EQUAL(arena->chunks, chunks);
+    trn_arena_destroy(arena);
+}
+
+
+void test_grid_snapshot_with_pool()
+{
+    TrnPool* pool = trn_pool_new(4096, 4);
+    TrnGrid* grid = trn_grid_new_with_allocator(20, 10, &pool->base);
+    CU_ASSERT_PTR_NOT_NULL(grid);
+
+    // Copied rows go back to the pool and are reused.
+    TrnGrid* snapshot = trn_grid_snapshot(grid);
+    TrnPositionInGrid pos = {19, 0};
+    trn_grid_set_cell(grid, pos, TRN_TETROMINO_I);
+    TrnPoolBlock* freeBlocks = pool->freeBlocks;
+    trn_grid_destroy(snapshot);
+    CU_ASSERT_PTR_NOT_EQUAL(pool->freeBlocks, freeBlocks);
+    snapshot = trn_grid_snapshot(grid);
+    CU_ASSERT_PTR_EQUAL(pool->freeBlocks, freeBlocks);
+
+    trn_grid_destroy(snapshot);
+    trn_grid_destroy(grid);
+    trn_pool_destroy(pool);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Functional suite tests
 //////////////////////////////////////////////////////////////////////////////
@@ -539,13 +2110,28 @@ void test_game_new_destroy()
  *
  */
 
+/* Alternate J and L, one of each per batch. */
+static int next_batch_j_l(TrnRandomizer * const randomizer,
+                          TrnRandom * const random,
+                          TrnTetrominoType types[])
+{
+    (void) randomizer;
+    (void) random;
+    types[0] = TRN_TETROMINO_J;
+    types[1] = TRN_TETROMINO_L;
+    return 2;
+}
+
+static TrnRandomizer randomizer_j_l = {next_batch_j_l};
+
 void stack_some_pieces()
 {
     int numberOfRows = 20;
     int numberOfColumns = 10;
     int delay = 500;
     int imove;
-    TrnGame* game = trn_game_new(numberOfRows, numberOfColumns, delay);
+    TrnGame* game = trn_game_new(numberOfRows, numberOfColumns, delay, 1);
+    trn_game_set_randomizer(game, &randomizer_j_l);
     
     // TrnPiece 0. While the piece is falling:
     // Rotate it 3 times.
@@ -648,8 +2234,10 @@ void stack_some_pieces()
 int main()
 {
   trn_init();
+  CU_pSuite suiteTetromino = NULL;
   CU_pSuite suitePiece = NULL;
   CU_pSuite Suite_grid = NULL;
+  CU_pSuite suiteGame = NULL;
   CU_pSuite suiteFunctional = NULL;
 
 
@@ -667,10 +2255,25 @@ int main()
    ADD_TEST_TO_SUITE(Suite_grid,TestGridCellIsInGridAndIsVoid)
    ADD_TEST_TO_SUITE(Suite_grid,TestGridCanSetCellsWithPiece)
    ADD_TEST_TO_SUITE(Suite_grid,test_grid_pop_row_and_make_above_fall)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_pop_middle_row)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_pop_first_complete_rows_block)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_column_heights)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_equal_and_refresh_occupancy)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_snapshot)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_snapshot_with_pool)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_hash)
    ADD_TEST_TO_SUITE(Suite_grid,test_grid_find_last_complete_row_index)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_row_bits)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_wide_rows)
+   ADD_TEST_TO_SUITE(Suite_grid,test_grid_drop_distance)
    /*ADD_TEST_TO_SUITE(Suite_grid,test_set_row_to_zero)*/
    /*ADD_TEST_TO_SUITE(Suite_grid,test_set_grid_to_zero)*/
 
+   /* Create TrnTetromino test suite */
+   ADD_SUITE_TO_REGISTRY(suiteTetromino)
+   ADD_TEST_TO_SUITE(suiteTetromino, test_tetromino_shapes)
+   ADD_TEST_TO_SUITE(suiteTetromino, test_srs_find_kick)
+
    /* Create TrnPiece test suite */
    ADD_SUITE_TO_REGISTRY(suitePiece )
    ADD_TEST_TO_SUITE(suitePiece, test_piece_move_to_left)
@@ -678,6 +2281,29 @@ int main()
    ADD_TEST_TO_SUITE(suitePiece, test_piece_move_to_bottom)
    ADD_TEST_TO_SUITE(suitePiece, test_piece_rotate_clockwise)
 
+   /* Create game test suite */
+   ADD_SUITE_TO_REGISTRY(suiteGame)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_new_destroy)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_hash)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_piece_overlay)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_gravity_20g)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_with_arena)
+   ADD_TEST_TO_SUITE(suiteGame, test_piece_queue_bag)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_hold)
+   ADD_TEST_TO_SUITE(suiteGame, test_random_seed)
+   ADD_TEST_TO_SUITE(suiteGame, test_env_step)
+   ADD_TEST_TO_SUITE(suiteGame, test_scheduler_parallel_for)
+   ADD_TEST_TO_SUITE(suiteGame, test_placement_finder)
+   ADD_TEST_TO_SUITE(suiteGame, test_bot)
+   ADD_TEST_TO_SUITE(suiteGame, test_replay)
+   ADD_TEST_TO_SUITE(suiteGame, test_verifier)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_out_of_memory)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_save_restore)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_save_restore_checks)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_events)
+   ADD_TEST_TO_SUITE(suiteGame, test_game_tick)
+   ADD_TEST_TO_SUITE(suiteGame, test_counters)
+
    /* Create functional test suite */
    ADD_SUITE_TO_REGISTRY(suiteFunctional)
    ADD_TEST_TO_SUITE(suiteFunctional, stack_some_pieces)
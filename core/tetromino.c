@@ -3,55 +3,112 @@
 
 #include "tetromino.h"
 
-TrnTetrominoFourRotationsArray
+/* Coordinates {rowIndex, columnIndex} of the four squares of each tetromino,
+ * one rotation per line, from TRN_ANGLE_0 to TRN_ANGLE_270. Every table
+ * below is expanded from these lists. */
+
+#define TRN_TETROMINO_I_ROTATIONS(ROTATION) \
+  ROTATION(1,0, 1,1, 1,2, 1,3), \
+  ROTATION(0,2, 1,2, 2,2, 3,2), \
+  ROTATION(2,0, 2,1, 2,2, 2,3), \
+  ROTATION(0,1, 1,1, 2,1, 3,1)
+
+#define TRN_TETROMINO_O_ROTATIONS(ROTATION) \
+  ROTATION(1,0, 2,0, 1,1, 2,1), \
+  ROTATION(1,0, 2,0, 1,1, 2,1), \
+  ROTATION(1,0, 2,0, 1,1, 2,1), \
+  ROTATION(1,0, 2,0, 1,1, 2,1)
+
+#define TRN_TETROMINO_T_ROTATIONS(ROTATION) \
+  ROTATION(0,1, 1,0, 1,1, 1,2), \
+  ROTATION(0,1, 1,1, 1,2, 2,1), \
+  ROTATION(1,0, 1,1, 1,2, 2,1), \
+  ROTATION(0,1, 1,0, 1,1, 2,1)
+
+#define TRN_TETROMINO_S_ROTATIONS(ROTATION) \
+  ROTATION(0,1, 0,2, 1,0, 1,1), \
+  ROTATION(0,1, 1,1, 1,2, 2,2), \
+  ROTATION(1,1, 1,2, 2,0, 2,1), \
+  ROTATION(0,0, 1,0, 1,1, 2,1)
+
+#define TRN_TETROMINO_Z_ROTATIONS(ROTATION) \
+  ROTATION(0,0, 0,1, 1,1, 1,2), \
+  ROTATION(0,2, 1,1, 1,2, 2,1), \
+  ROTATION(1,0, 1,1, 2,1, 2,2), \
+  ROTATION(0,1, 1,0, 1,1, 2,0)
+
+#define TRN_TETROMINO_J_ROTATIONS(ROTATION) \
+  ROTATION(0,0, 1,0, 1,1, 1,2), \
+  ROTATION(0,1, 0,2, 1,1, 2,1), \
+  ROTATION(1,0, 1,1, 1,2, 2,2), \
+  ROTATION(0,1, 1,1, 2,0, 2,1)
+
+#define TRN_TETROMINO_L_ROTATIONS(ROTATION) \
+  ROTATION(0,2, 1,0, 1,1, 1,2), \
+  ROTATION(0,1, 1,1, 2,1, 2,2), \
+  ROTATION(1,0, 1,1, 1,2, 2,0), \
+  ROTATION(0,0, 0,1, 1,1, 2,1)
+
+#define TRN_ALL_TETROMINO_ROTATIONS(ROTATION) \
+  { TRN_TETROMINO_I_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_O_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_T_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_S_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_Z_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_J_ROTATIONS(ROTATION) }, \
+  { TRN_TETROMINO_L_ROTATIONS(ROTATION) }
+
+TrnColor const TRN_ALL_TETROMINO_COLORS[TRN_NUMBER_OF_TETROMINO] =
+{
+  [TRN_TETROMINO_I] = TRN_CYAN_INITIALIZER,
+  [TRN_TETROMINO_O] = TRN_YELLOW_INITIALIZER,
+  [TRN_TETROMINO_T] = TRN_PURPLE_INITIALIZER,
+  [TRN_TETROMINO_S] = TRN_GREEN_INITIALIZER,
+  [TRN_TETROMINO_Z] = TRN_RED_INITIALIZER,
+  [TRN_TETROMINO_J] = TRN_BLUE_INITIALIZER,
+  [TRN_TETROMINO_L] = TRN_ORANGE_INITIALIZER
+};
+
+#define SQUARES(r0,c0, r1,c1, r2,c2, r3,c3) \
+  { {r0,c0}, {r1,c1}, {r2,c2}, {r3,c3} }
+
+TrnTetrominoFourRotationsArray const
   TRN_ALL_TETROMINO_FOUR_ROTATIONS[TRN_NUMBER_OF_TETROMINO] =
 {
-  { // I
-  { {1,0}, {1,1}, {1,2}, {1,3} },
-  { {0,2}, {1,2}, {2,2}, {3,2} },
-  { {2,0}, {2,1}, {2,2}, {2,3} },
-  { {0,1}, {1,1}, {2,1}, {3,1} } 
-  },
-
-  { // O
-  { {1,0}, {2,0}, {1,1}, {2,1} },
-  { {1,0}, {2,0}, {1,1}, {2,1} },
-  { {1,0}, {2,0}, {1,1}, {2,1} },
-  { {1,0}, {2,0}, {1,1}, {2,1} }
-  },
-
-  { // T
-  { {0,1}, {1,0}, {1,1}, {1,2} },
-  { {0,1}, {1,1}, {1,2}, {2,1} },
-  { {1,0}, {1,1}, {1,2}, {2,1} },
-  { {0,1}, {1,0}, {1,1}, {2,1} }
-  },
-
-  { // S
-  { {0,1}, {0,2}, {1,0}, {1,1} },
-  { {0,1}, {1,1}, {1,2}, {2,2} },
-  { {1,1}, {1,2}, {2,0}, {2,1} },
-  { {0,0}, {1,0}, {1,1}, {2,1} }
-  },
-
-  { // Z
-  { {0,0}, {0,1}, {1,1}, {1,2} },
-  { {0,2}, {1,1}, {1,2}, {2,1} },
-  { {1,0}, {1,1}, {2,1}, {2,2} },
-  { {0,1}, {1,0}, {1,1}, {2,0} }
-  },
-
-  { // J
-  { {0,0}, {1,0}, {1,1}, {1,2} },
-  { {0,1}, {0,2}, {1,1}, {2,1} },
-  { {1,0}, {1,1}, {1,2}, {2,2} },
-  { {0,1}, {1,1}, {2,0}, {2,1} }
-  },
-
-  { // L
-  { {0,2}, {1,0}, {1,1}, {1,2} },
-  { {0,1}, {1,1}, {2,1}, {2,2} },
-  { {1,0}, {1,1}, {1,2}, {2,0} },
-  { {0,0}, {0,1}, {1,1}, {2,1} }
-  }
+  TRN_ALL_TETROMINO_ROTATIONS(SQUARES)
+};
+
+/* Constant expressions over the four squares of a rotation. */
+
+#define MIN2(a,b) ((a) < (b) ? (a) : (b))
+#define MAX2(a,b) ((a) > (b) ? (a) : (b))
+#define MIN4(a,b,c,d) MIN2(MIN2(a,b), MIN2(c,d))
+#define MAX4(a,b,c,d) MAX2(MAX2(a,b), MAX2(c,d))
+
+#define ROW_MASK(row, r0,c0, r1,c1, r2,c2, r3,c3) \
+  (((r0) == (row)) << (c0) | ((r1) == (row)) << (c1) | \
+   ((r2) == (row)) << (c2) | ((r3) == (row)) << (c3))
+
+#define COLUMN_BOTTOM(column, r0,c0, r1,c1, r2,c2, r3,c3) \
+  MAX4((c0) == (column) ? (r0) : -1, (c1) == (column) ? (r1) : -1, \
+       (c2) == (column) ? (r2) : -1, (c3) == (column) ? (r3) : -1)
+
+#define SHAPE(r0,c0, r1,c1, r2,c2, r3,c3) \
+  { SQUARES(r0,c0, r1,c1, r2,c2, r3,c3), \
+    { ROW_MASK(0, r0,c0, r1,c1, r2,c2, r3,c3), \
+      ROW_MASK(1, r0,c0, r1,c1, r2,c2, r3,c3), \
+      ROW_MASK(2, r0,c0, r1,c1, r2,c2, r3,c3), \
+      ROW_MASK(3, r0,c0, r1,c1, r2,c2, r3,c3) }, \
+    MIN4(r0, r1, r2, r3), MAX4(r0, r1, r2, r3), \
+    MIN4(c0, c1, c2, c3), MAX4(c0, c1, c2, c3), \
+    { COLUMN_BOTTOM(0, r0,c0, r1,c1, r2,c2, r3,c3), \
+      COLUMN_BOTTOM(1, r0,c0, r1,c1, r2,c2, r3,c3), \
+      COLUMN_BOTTOM(2, r0,c0, r1,c1, r2,c2, r3,c3), \
+      COLUMN_BOTTOM(3, r0,c0, r1,c1, r2,c2, r3,c3) } }
+
+TrnTetrominoShape const
+  TRN_ALL_TETROMINO_SHAPES[TRN_NUMBER_OF_TETROMINO]
+                          [TRN_TETROMINO_NUMBER_OF_ROTATIONS] =
+{
+  TRN_ALL_TETROMINO_ROTATIONS(SHAPE)
 };
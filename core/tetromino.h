@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "color.h"
 #include "position_in_grid.h"
@@ -25,13 +26,35 @@ typedef TrnPositionInGrid
 typedef TrnTetrominoRotationArray
   TrnTetrominoFourRotationsArray[TRN_TETROMINO_NUMBER_OF_ROTATIONS];
 
-typedef TrnPositionInGrid* TrnTetrominoRotation;
+typedef TrnPositionInGrid const* TrnTetrominoRotation;
 typedef TrnPositionInGrid** TrnTetrominoFourRotations;
 
-extern TrnColor
+extern TrnColor const
   TRN_ALL_TETROMINO_COLORS[TRN_NUMBER_OF_TETROMINO];
 
-extern TrnTetrominoFourRotationsArray
+extern TrnTetrominoFourRotationsArray const
   TRN_ALL_TETROMINO_FOUR_ROTATIONS[TRN_NUMBER_OF_TETROMINO];
 
+/* A tetromino at a given angle, within its TRN_TETROMINO_GRID_SIZE box:
+ * - its squares, as in TRN_ALL_TETROMINO_FOUR_ROTATIONS,
+ * - one occupancy mask per box row, bit i meaning box column i,
+ * - the box rows and columns its squares span,
+ * - the box row of the lowest square of each box column, -1 for a column
+ *   without square, ie how far down the piece reaches in each column. */
+typedef struct {
+  TrnTetrominoRotationArray squares;
+  uint8_t rowMasks[TRN_TETROMINO_GRID_SIZE];
+  int8_t firstRowIndex;
+  int8_t lastRowIndex;
+  int8_t firstColumnIndex;
+  int8_t lastColumnIndex;
+  int8_t columnBottoms[TRN_TETROMINO_GRID_SIZE];
+} TrnTetrominoShape;
+
+/* Derived at compile time from the same coordinates as
+ * TRN_ALL_TETROMINO_FOUR_ROTATIONS, read-only. */
+extern TrnTetrominoShape const
+  TRN_ALL_TETROMINO_SHAPES[TRN_NUMBER_OF_TETROMINO]
+                          [TRN_TETROMINO_NUMBER_OF_ROTATIONS];
+
 #endif
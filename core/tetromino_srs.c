@@ -0,0 +1,102 @@
+#include "tetromino_srs.h"
+
+/* Kicks are given as in the SRS specification, x to the right and y up, and
+ * turned into grid offsets, rows growing downwards. */
+#define K(x, y) {-(y), (x)}
+
+#define KICKS(k0, k1, k2, k3, k4) {5, {k0, k1, k2, k3, k4}}
+#define IN_PLACE {1, {K(0,0)}}
+
+/* For each angle: clockwise, counter clockwise and 180 degrees kicks. */
+
+#define JLSTZ_KICKS \
+  { /* 0 -> R, 0 -> L */ \
+    { KICKS(K(0,0), K(-1,0), K(-1, 1), K(0,-2), K(-1,-2)), \
+      KICKS(K(0,0), K( 1,0), K( 1, 1), K(0,-2), K( 1,-2)), \
+      IN_PLACE }, \
+    /* R -> 2, R -> 0 */ \
+    { KICKS(K(0,0), K( 1,0), K( 1,-1), K(0, 2), K( 1, 2)), \
+      KICKS(K(0,0), K( 1,0), K( 1,-1), K(0, 2), K( 1, 2)), \
+      IN_PLACE }, \
+    /* 2 -> L, 2 -> R */ \
+    { KICKS(K(0,0), K( 1,0), K( 1, 1), K(0,-2), K( 1,-2)), \
+      KICKS(K(0,0), K(-1,0), K(-1, 1), K(0,-2), K(-1,-2)), \
+      IN_PLACE }, \
+    /* L -> 0, L -> 2 */ \
+    { KICKS(K(0,0), K(-1,0), K(-1,-1), K(0, 2), K(-1, 2)), \
+      KICKS(K(0,0), K(-1,0), K(-1,-1), K(0, 2), K(-1, 2)), \
+      IN_PLACE } }
+
+#define I_KICKS \
+  { /* 0 -> R, 0 -> L */ \
+    { KICKS(K(0,0), K(-2,0), K( 1,0), K(-2,-1), K( 1, 2)), \
+      KICKS(K(0,0), K(-1,0), K( 2,0), K(-1, 2), K( 2,-1)), \
+      IN_PLACE }, \
+    /* R -> 2, R -> 0 */ \
+    { KICKS(K(0,0), K(-1,0), K( 2,0), K(-1, 2), K( 2,-1)), \
+      KICKS(K(0,0), K( 2,0), K(-1,0), K( 2, 1), K(-1,-2)), \
+      IN_PLACE }, \
+    /* 2 -> L, 2 -> R */ \
+    { KICKS(K(0,0), K( 2,0), K(-1,0), K( 2, 1), K(-1,-2)), \
+      KICKS(K(0,0), K( 1,0), K(-2,0), K( 1,-2), K(-2, 1)), \
+      IN_PLACE }, \
+    /* L -> 0, L -> 2 */ \
+    { KICKS(K(0,0), K( 1,0), K(-2,0), K( 1,-2), K(-2, 1)), \
+      KICKS(K(0,0), K(-2,0), K( 1,0), K(-2,-1), K( 1, 2)), \
+      IN_PLACE } }
+
+/* The O tetromino looks the same at every angle, it never needs a kick. */
+#define O_KICKS \
+  { { IN_PLACE, IN_PLACE, IN_PLACE }, \
+    { IN_PLACE, IN_PLACE, IN_PLACE }, \
+    { IN_PLACE, IN_PLACE, IN_PLACE }, \
+    { IN_PLACE, IN_PLACE, IN_PLACE } }
+
+TrnSrsKicks const
+  TRN_SRS_KICKS[TRN_NUMBER_OF_TETROMINO]
+               [TRN_TETROMINO_NUMBER_OF_ROTATIONS]
+               [TRN_NUMBER_OF_ROTATION_DIRECTIONS] =
+{
+  I_KICKS,     // I
+  O_KICKS,     // O
+  JLSTZ_KICKS, // T
+  JLSTZ_KICKS, // S
+  JLSTZ_KICKS, // Z
+  JLSTZ_KICKS, // J
+  JLSTZ_KICKS  // L
+};
+
+TrnTetrominoRotationAngle trn_srs_rotated_angle(
+  TrnTetrominoRotationAngle const angle,
+  TrnRotationDirection const direction)
+{
+  static int const quarterTurns[TRN_NUMBER_OF_ROTATION_DIRECTIONS] =
+    {1, 3, 2};
+  return (TrnTetrominoRotationAngle)
+    ((angle + quarterTurns[direction]) % TRN_TETROMINO_NUMBER_OF_ROTATIONS);
+}
+
+int trn_srs_find_kick(TrnGrid const * const grid,
+                      TrnPiece const * const piece,
+                      TrnRotationDirection const direction,
+                      TrnPiece * const rotated)
+{
+  TrnSrsKicks const * const kicks =
+    &TRN_SRS_KICKS[piece->type][piece->angle][direction];
+  TrnPiece candidate = *piece;
+  int kickIndex;
+
+  candidate.angle = trn_srs_rotated_angle(piece->angle, direction);
+  for (kickIndex = 0 ; kickIndex < kicks->numberOfKicks ; kickIndex++) {
+    TrnPositionInGrid const offset = kicks->offsets[kickIndex];
+    candidate.topLeftCorner.rowIndex =
+      piece->topLeftCorner.rowIndex + offset.rowIndex;
+    candidate.topLeftCorner.columnIndex =
+      piece->topLeftCorner.columnIndex + offset.columnIndex;
+    if (trn_grid_can_set_cells_with_piece(grid, &candidate)) {
+      *rotated = candidate;
+      return kickIndex;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,46 @@
+#ifndef TRN_TETROMINO_SRS_H
+#define TRN_TETROMINO_SRS_H
+
+#include "tetromino.h"
+#include "piece.h"
+#include "grid.h"
+
+/* Super Rotation System: when a rotated piece does not fit, it is tried again
+ * at a few offsets, the wall kicks, which depend on the tetromino, its angle
+ * and the rotation direction. */
+
+typedef enum {TRN_ROTATION_CLOCKWISE, TRN_ROTATION_COUNTER_CLOCKWISE,
+              TRN_ROTATION_180} TrnRotationDirection;
+
+#define TRN_NUMBER_OF_ROTATION_DIRECTIONS 3
+#define TRN_SRS_MAX_NUMBER_OF_KICKS 5
+
+/* Offsets, in grid rows and columns, added to the top left corner of the
+ * rotated piece, in the order they are tried. The first one is always
+ * {0,0}. SRS defines no kick for 180 degrees rotations, which only succeed
+ * in place. */
+typedef struct {
+  int numberOfKicks;
+  TrnPositionInGrid offsets[TRN_SRS_MAX_NUMBER_OF_KICKS];
+} TrnSrsKicks;
+
+/* Kicks by tetromino, angle before the rotation and rotation direction. */
+extern TrnSrsKicks const
+  TRN_SRS_KICKS[TRN_NUMBER_OF_TETROMINO]
+               [TRN_TETROMINO_NUMBER_OF_ROTATIONS]
+               [TRN_NUMBER_OF_ROTATION_DIRECTIONS];
+
+TrnTetrominoRotationAngle trn_srs_rotated_angle(
+  TrnTetrominoRotationAngle const angle,
+  TrnRotationDirection const direction);
+
+/* Look for the first kick for which piece, rotated in direction, fits in
+ * grid, the piece itself not being in grid. Return the kick index and set
+ * rotated to the rotated and kicked piece, or return -1 if there is none.
+ * Neither the grid nor the piece are changed. */
+int trn_srs_find_kick(TrnGrid const * const grid,
+                      TrnPiece const * const piece,
+                      TrnRotationDirection const direction,
+                      TrnPiece * const rotated);
+
+#endif
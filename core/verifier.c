@@ -0,0 +1,161 @@
+#include "verifier.h"
+#include "allocator.h"
+#include "replay.h"
+
+#include <stdlib.h>
+
+/* A game and the arena it lives in, on cache lines of their own. */
+typedef struct {
+    TrnArena* arena;
+    TrnGame* game;
+} __attribute__((aligned(TRN_ALLOCATOR_MAX_ALIGNMENT))) Worker;
+
+struct TrnVerifier {
+    TrnScheduler* scheduler;
+    Worker* workers;
+    int numberOfWorkers;
+
+    /* Current batch. */
+    uint8_t const * const * replays;
+    size_t const* sizes;
+    TrnVerification* results;
+};
+
+static char const* const STATUS_NAMES[TRN_NUMBER_OF_VERIFICATION_STATUSES] =
+{
+    [TRN_VERIFICATION_VALID] = "valid",
+    [TRN_VERIFICATION_CORRUPTED] = "corrupted",
+    [TRN_VERIFICATION_UNSUPPORTED] = "unsupported",
+    [TRN_VERIFICATION_DIVERGED] = "diverged",
+    [TRN_VERIFICATION_MISMATCH] = "mismatch"
+};
+
+char const* trn_verification_status_name(TrnVerificationStatus const status)
+{
+    return STATUS_NAMES[status];
+}
+
+TrnVerifier* trn_verifier_new(TrnScheduler * const scheduler)
+{
+    TrnVerifier* verifier = (TrnVerifier*) malloc(sizeof(TrnVerifier));
+    verifier->scheduler = scheduler;
+    verifier->numberOfWorkers = scheduler ?
+        trn_scheduler_number_of_workers(scheduler) : 1;
+    verifier->workers = (Worker*) trn_allocator_allocate(
+        trn_allocator_heap(), verifier->numberOfWorkers * sizeof(Worker),
+        TRN_ALLOCATOR_MAX_ALIGNMENT);
+
+    int workerIndex;
+    for (workerIndex = 0 ; workerIndex < verifier->numberOfWorkers ;
+         workerIndex++) {
+        verifier->workers[workerIndex].arena = trn_arena_new(64 * 1024);
+        verifier->workers[workerIndex].game = NULL;
+    }
+    return verifier;
+}
+
+void trn_verifier_destroy(TrnVerifier * verifier)
+{
+    int workerIndex;
+    for (workerIndex = 0 ; workerIndex < verifier->numberOfWorkers ;
+         workerIndex++)
+        trn_arena_destroy(verifier->workers[workerIndex].arena);
+    trn_allocator_release(trn_allocator_heap(), verifier->workers);
+    free(verifier);
+}
+
+/* Reset the game of worker for the replay of reader, making a new one when
+ * the grid size changes. */
+static TrnGame* reset_game(Worker * const worker,
+                           TrnReplayReader const * const reader)
+{
+    if (worker->game && trn_replay_reset_game(reader, worker->game))
+        return worker->game;
+
+    trn_arena_reset(worker->arena);
+    worker->game = trn_replay_new_game(reader, &worker->arena->base);
+    return worker->game;
+}
+
+static void verify_replay(Worker * const worker,
+                          uint8_t const * const bytes,
+                          size_t const size,
+                          TrnVerification * const result)
+{
+    TrnReplayReader reader;
+    TrnReplayEvent event;
+
+    result->divergenceTick = 0;
+    result->score = 0;
+    result->lines = 0;
+    result->level = 0;
+    if (!trn_replay_reader_open(&reader, bytes, size)) {
+        result->status = TRN_VERIFICATION_CORRUPTED;
+        return;
+    }
+    TrnGame * const game = reset_game(worker, &reader);
+    if (!game) {
+        result->status = TRN_VERIFICATION_UNSUPPORTED;
+        return;
+    }
+
+    result->status = TRN_VERIFICATION_VALID;
+    while (trn_replay_reader_next(&reader, &event)) {
+        if (event.input != TRN_REPLAY_CHECKPOINT)
+            trn_replay_apply(game, &event);
+        else if (result->status == TRN_VERIFICATION_VALID &&
+                 event.hash != trn_game_hash(game)) {
+            /* Keep reading, a truncated replay is corrupted even so. */
+            result->status = TRN_VERIFICATION_DIVERGED;
+            result->divergenceTick = event.tick;
+        }
+    }
+
+    result->score = game->score;
+    result->lines = game->lines_count;
+    result->level = game->level;
+    if (!reader.isComplete || reader.position != reader.size)
+        result->status = TRN_VERIFICATION_CORRUPTED;
+    else if (result->status != TRN_VERIFICATION_VALID)
+        return;
+    else if (reader.hash != trn_game_hash(game) ||
+             reader.status != game->status) {
+        result->status = TRN_VERIFICATION_DIVERGED;
+        result->divergenceTick = reader.tick;
+    }
+    else if (reader.score != game->score ||
+             reader.lines != game->lines_count ||
+             reader.level != game->level)
+        result->status = TRN_VERIFICATION_MISMATCH;
+}
+
+static void verify_replays(void * const context,
+                           int const begin,
+                           int const end,
+                           int const workerIndex)
+{
+    TrnVerifier * const verifier = (TrnVerifier*) context;
+    Worker * const worker = &verifier->workers[workerIndex];
+    int replayIndex;
+    for (replayIndex = begin ; replayIndex < end ; replayIndex++)
+        verify_replay(worker, verifier->replays[replayIndex],
+                      verifier->sizes[replayIndex],
+                      &verifier->results[replayIndex]);
+}
+
+void trn_verifier_verify(TrnVerifier * const verifier,
+                         uint8_t const * const replays[],
+                         size_t const sizes[],
+                         int const numberOfReplays,
+                         TrnVerification results[])
+{
+    verifier->replays = replays;
+    verifier->sizes = sizes;
+    verifier->results = results;
+    /* Small ranges, replays lengths vary a lot. */
+    if (verifier->scheduler)
+        trn_scheduler_parallel_for(verifier->scheduler, numberOfReplays, 16,
+                                   verify_replays, verifier);
+    else
+        verify_replays(verifier, 0, numberOfReplays, 0);
+}
@@ -0,0 +1,47 @@
+#ifndef TRN_VERIFIER_H
+#define TRN_VERIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "scheduler.h"
+
+typedef enum {
+    TRN_VERIFICATION_VALID,
+    TRN_VERIFICATION_CORRUPTED,  /* unreadable or truncated */
+    TRN_VERIFICATION_UNSUPPORTED, /* pieces not drawn from the seed */
+    TRN_VERIFICATION_DIVERGED,   /* the game played again differs */
+    TRN_VERIFICATION_MISMATCH,   /* same game, but not the claimed result */
+    TRN_NUMBER_OF_VERIFICATION_STATUSES
+} TrnVerificationStatus;
+
+/* Result of a replay played again: the simulated result and, when the game
+ * diverges, the tick of the first checkpoint, or of the end, that differs. */
+typedef struct {
+    TrnVerificationStatus status;
+    uint64_t divergenceTick;
+    int score;
+    int lines;
+    int level;
+} TrnVerification;
+
+/* Plays replays again as fast as possible, one game per worker of a
+ * scheduler, reused from one replay to the next of the same size. Workers
+ * share nothing but the replays they read. */
+typedef struct TrnVerifier TrnVerifier;
+
+/* Verify serially when scheduler is NULL. */
+TrnVerifier* trn_verifier_new(TrnScheduler * const scheduler);
+
+void trn_verifier_destroy(TrnVerifier * verifier);
+
+void trn_verifier_verify(TrnVerifier * const verifier,
+                         uint8_t const * const replays[],
+                         size_t const sizes[],
+                         int const numberOfReplays,
+                         TrnVerification results[]);
+
+char const* trn_verification_status_name(TrnVerificationStatus const status);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRN_ZOBRIST_H
+#define TRN_ZOBRIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tetromino.h"
+#include "piece.h"
+
+/* Zobrist keys, derived from their coordinates by a 64 bits mixer rather than
+ * stored in tables, so that they are read-only and fit any grid size.
+ *
+ * A row hash is the xor of the keys of its cells, a void cell having a zero
+ * key. The grid hash is the xor of its row keys, each one mixing the row hash
+ * with the row index, so that rows falling after a line clear only need their
+ * row key to be recomputed. */
+
+static inline uint64_t trn_zobrist_mix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+static inline uint64_t trn_zobrist_cell_key(int const columnIndex,
+                                            TrnTetrominoType const type)
+{
+    if (type == TRN_TETROMINO_VOID)
+        return 0;
+    return trn_zobrist_mix(((uint64_t) columnIndex << 3) | type);
+}
+
+static inline uint64_t trn_zobrist_row_key(int const rowIndex,
+                                           uint64_t const rowHash)
+{
+    if (rowHash == 0)
+        return 0;
+    return trn_zobrist_mix(rowHash ^ trn_zobrist_mix(~(uint64_t) rowIndex));
+}
+
+static inline uint64_t trn_zobrist_piece_key(TrnPiece const * const piece)
+{
+    uint64_t const position =
+        ((uint64_t) (uint32_t) piece->topLeftCorner.rowIndex << 32) |
+        (uint32_t) piece->topLeftCorner.columnIndex;
+    return trn_zobrist_mix(trn_zobrist_mix(position) ^
+                           ((uint64_t) piece->type << 2 | piece->angle));
+}
+
+/* Key of the tetromino type at index in the preview. */
+static inline uint64_t trn_zobrist_preview_key(int const index,
+                                               TrnTetrominoType const type)
+{
+    return trn_zobrist_mix(0x5052455649455700ull ^
+                           ((uint64_t) index << 3 | type));
+}
+
+/* Key of the held tetromino type, and of whether it can be swapped. */
+static inline uint64_t trn_zobrist_hold_key(TrnTetrominoType const type,
+                                            bool const used)
+{
+    return trn_zobrist_mix(0x484F4C4400000000ull ^
+                           ((uint64_t) type << 1 | used));
+}
+
+#endif
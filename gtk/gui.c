@@ -1,6 +1,7 @@
 #include "gui.h"
 
 #include <malloc.h>
+#include <time.h>
 
 
 void fill_cell(cairo_t *cr, TrnColor color, int i, int j, bool border_shade)
@@ -22,13 +23,20 @@ void fill_cell(cairo_t *cr, TrnColor color, int i, int j, bool border_shade)
   cairo_stroke(cr);
 }
 
+/* Run the frames of the game due now, on the monotonic clock. */
+static void tick(TrnGUI* gui)
+{
+  trn_game_tick(gui->game, (uint64_t) g_get_monotonic_time() * 1000,
+                gui->inputs);
+  trn_gui_update_view(gui);
+}
+
+/* The timer only wakes the game up: the game counts its frames from the
+ * clock, so a late timer does not slow it down. */
 gint on_timeout_event(gpointer data)
 {
-  TrnGUI* self = (TrnGUI*)data;
-  trn_game_try_to_move_down(self->game);
-  trn_gui_update_view(self);
-  g_timeout_add(trn_game_delay(self->game),on_timeout_event,(gpointer)self);
-  return 0;
+  tick((TrnGUI*)data);
+  return TRUE;
 }
 
 gboolean on_preview_expose_event(GtkWidget* preview,
@@ -49,12 +57,12 @@ gboolean on_preview_expose_event(GtkWidget* preview,
 
   int squareIndex;
 
-  TrnPiece* piece = gui->game->next_piece;
+  TrnTetrominoType type = trn_game_preview(gui->game,0);
 
   TrnTetrominoRotation tetromino_rotation = 
-      TRN_ALL_TETROMINO_FOUR_ROTATIONS[piece->type][TRN_ANGLE_0];
+      TRN_ALL_TETROMINO_FOUR_ROTATIONS[type][TRN_ANGLE_0];
 
-  TrnColor color = TRN_ALL_TETROMINO_COLORS[piece->type];
+  TrnColor color = TRN_ALL_TETROMINO_COLORS[type];
 
   for (squareIndex=0;squareIndex<TRN_TETROMINO_NUMBER_OF_SQUARES;++squareIndex)
   {
@@ -66,16 +74,40 @@ gboolean on_preview_expose_event(GtkWidget* preview,
   return TRUE;
 }
 
-gboolean on_matrix_expose_event(GtkWidget *matrix,GdkEventExpose* UNUSED(event), TrnGUI* gui)
+gboolean on_matrix_expose_event(GtkWidget *matrix,GdkEventExpose* event, TrnGUI* gui)
 {
   cairo_t* cr = gdk_cairo_create(matrix->window);
 
   TrnGrid* grid = gui->game->grid;
   TrnColor color;
 
+  /* Only the cells of the exposed area are painted again, most often the
+   * few around the current piece. */
+  gdk_cairo_rectangle(cr, &event->area);
+  cairo_clip(cr);
+  int firstRowIndex = event->area.y / NPIXELS - 1;
+  int lastRowIndex = (event->area.y + event->area.height) / NPIXELS;
+  int firstColumnIndex = event->area.x / NPIXELS - 1;
+  int lastColumnIndex = (event->area.x + event->area.width) / NPIXELS;
+  if (lastRowIndex >= grid->numberOfRows)
+    lastRowIndex = grid->numberOfRows - 1;
+  if (firstColumnIndex < 0)
+    firstColumnIndex = 0;
+  if (lastColumnIndex >= grid->numberOfColumns)
+    lastColumnIndex = grid->numberOfColumns - 1;
+
+  /* Rows above the stack top are void: paint them black at once. */
+  int const stackTopRowIndex = trn_grid_stack_top_row_index(grid);
+  cairo_rectangle(cr, 0, 0, grid->numberOfColumns * NPIXELS + 2,
+                  stackTopRowIndex * NPIXELS + 2);
+  cairo_set_source_rgb(cr, TRN_BLACK.red, TRN_BLACK.green, TRN_BLACK.blue);
+  cairo_fill(cr);
+
+  if (firstRowIndex < stackTopRowIndex)
+    firstRowIndex = stackTopRowIndex;
   int irow, icol;
-  for (irow = 0; irow < grid->numberOfRows; irow++) {
-    for (icol = 0; icol < grid->numberOfColumns; icol++) {
+  for (irow = firstRowIndex; irow <= lastRowIndex; irow++) {
+    for (icol = firstColumnIndex; icol <= lastColumnIndex; icol++) {
       TrnPositionInGrid pos;
       pos.rowIndex = irow;
       pos.columnIndex = icol;
@@ -87,37 +119,67 @@ gboolean on_matrix_expose_event(GtkWidget *matrix,GdkEventExpose* UNUSED(event),
       fill_cell(cr, color, irow, icol, true);
     }
   }
+
+  /* The current piece is not in the grid, draw it over, above its ghost
+   * showing where it would land. */
+  TrnPiece* piece = gui->game->current_piece;
+  if (gui->game->status != TRN_GAME_OVER) {
+    TrnPiece ghost = trn_game_ghost_piece(gui->game);
+    TrnColor ghost_color;
+    int squareIndex;
+    color = TRN_ALL_TETROMINO_COLORS[piece->type];
+    ghost_color.red = color.red * 0.3;
+    ghost_color.green = color.green * 0.3;
+    ghost_color.blue = color.blue * 0.3;
+    for (squareIndex = 0;
+         squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES;
+         squareIndex++) {
+      TrnPositionInGrid pos = trn_piece_position_in_grid(&ghost, squareIndex);
+      fill_cell(cr, ghost_color, pos.rowIndex, pos.columnIndex, false);
+    }
+    for (squareIndex = 0;
+         squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES;
+         squareIndex++) {
+      TrnPositionInGrid pos = trn_piece_position_in_grid(piece, squareIndex);
+      fill_cell(cr, color, pos.rowIndex, pos.columnIndex, true);
+    }
+  }
   cairo_destroy(cr);
   return TRUE;
 }
 
+static unsigned key_input(guint const keyval)
+{
+  switch (keyval) {
+  case GDK_Left: return TRN_INPUT_LEFT;
+  case GDK_Right: return TRN_INPUT_RIGHT;
+  case GDK_Up: return TRN_INPUT_ROTATE_CLOCKWISE;
+  case GDK_KEY_z: return TRN_INPUT_ROTATE_COUNTER_CLOCKWISE;
+  case GDK_KEY_a: return TRN_INPUT_ROTATE_180;
+  case GDK_Down: return TRN_INPUT_SOFT_DROP;
+  case GDK_KEY_space: return TRN_INPUT_HARD_DROP;
+  case GDK_KEY_c: return TRN_INPUT_HOLD;
+  default: return 0;
+  }
+}
+
+/* Keys only change the inputs held down, which the game reads at its next
+ * frame, auto-repeat included. */
 gboolean on_key_press_event(GtkWidget* UNUSED(widget),
                             GdkEventKey* event,
                             TrnGUI* gui)
 {
+  gui->inputs |= key_input(event->keyval);
+  tick(gui);
+  return TRUE;
+}
 
-  switch (event->keyval) {
-  case GDK_Left:
-    trn_game_try_to_move_left(gui->game);
-    break;
-  case GDK_Right:
-    trn_game_try_to_move_right(gui->game);
-    break;
-  case GDK_Up:
-    trn_game_try_to_rotate_clockwise(gui->game);
-    break;
-  case GDK_Down:
-    trn_game_try_to_move_down(gui->game);
-    break;
-  case GDK_KEY_space:
-    trn_game_move_to_bottom(gui->game);
-    break;
-
-    break;
-  }
-
-  trn_gui_update_view(gui);
-  
+gboolean on_key_release_event(GtkWidget* UNUSED(widget),
+                              GdkEventKey* event,
+                              TrnGUI* gui)
+{
+  gui->inputs &= ~key_input(event->keyval);
+  tick(gui);
   return TRUE;
 }
 
@@ -126,7 +188,8 @@ gboolean button_newgame_clicked(GtkWidget* UNUSED(widget), TrnGUI* gui) {
   int numberOfColumns = gui->game->grid->numberOfColumns;
   int delay = gui->game->initial_delay;
   trn_game_destroy(gui->game);
-  gui->game = trn_game_new(numberOfRows, numberOfColumns, delay);
+  gui->game = trn_game_new(numberOfRows, numberOfColumns, delay, time(NULL));
+  trn_gui_update_view(gui);
   return TRUE;
 }
 
@@ -143,7 +206,8 @@ TrnGUI* trn_gui_new(int numberOfRows, int numberOfColumns, int delay)
 
   TrnGUI* gui = (TrnGUI*)malloc(sizeof(TrnGUI));
 
-  gui->game = trn_game_new(numberOfRows, numberOfColumns, delay);
+  gui->game = trn_game_new(numberOfRows, numberOfColumns, delay, time(NULL));
+  gui->inputs = 0;
 
   gui->window = trn_window_new(numberOfRows,numberOfColumns);
   
@@ -151,7 +215,8 @@ TrnGUI* trn_gui_new(int numberOfRows, int numberOfColumns, int delay)
   g_signal_connect(gui->window->pauseButton, "clicked", G_CALLBACK(button_pause_clicked), gui);
 
   trn_window_show(gui->window);
-  g_timeout_add(trn_game_delay(gui->game),on_timeout_event,(gpointer)gui);
+  g_timeout_add(gui->game->clock.timing.frameNanoseconds / 1000000,
+                on_timeout_event, (gpointer)gui);
 
   return gui;
 }
@@ -163,10 +228,82 @@ void trn_gui_destroy(TrnGUI* gui)
   free(gui);
 }
 
+/* Redraw the columns of piece from its top row down to the bottom of the
+ * grid, where its ghost lies. */
+static void refresh_piece(TrnGUI* gui, TrnPiece const * const piece)
+{
+  TrnGrid const * const grid = gui->game->grid;
+  int firstRowIndex = grid->numberOfRows - 1;
+  int firstColumnIndex = grid->numberOfColumns - 1;
+  int lastColumnIndex = 0;
+  int squareIndex;
+
+  for (squareIndex = 0;
+       squareIndex < TRN_TETROMINO_NUMBER_OF_SQUARES;
+       squareIndex++) {
+    TrnPositionInGrid pos = trn_piece_position_in_grid(piece, squareIndex);
+    if (pos.rowIndex < firstRowIndex)
+      firstRowIndex = pos.rowIndex < 0 ? 0 : pos.rowIndex;
+    if (pos.columnIndex < firstColumnIndex)
+      firstColumnIndex = pos.columnIndex;
+    if (pos.columnIndex > lastColumnIndex)
+      lastColumnIndex = pos.columnIndex;
+  }
+  trn_window_refresh_cells(gui->window, firstRowIndex, grid->numberOfRows - 1,
+                           firstColumnIndex, lastColumnIndex);
+}
+
+/* Redraw what the events of the game since the last update changed, rather
+ * than the whole window. */
 void trn_gui_update_view(TrnGUI* gui)
 {
-  trn_window_refresh(gui->window);
-  trn_gui_update_labels(gui);
+  TrnGameEvent events[TRN_GAME_EVENTS_CAPACITY];
+  uint64_t lost;
+  int const count = trn_game_poll_events(gui->game, events,
+                                         TRN_GAME_EVENTS_CAPACITY, &lost);
+  bool refresh_all = lost > 0;
+  int index;
+
+  for (index = 0; index < count && !refresh_all; index++) {
+    TrnGameEvent const * const event = &events[index];
+    switch (event->type) {
+    case TRN_GAME_EVENT_PIECE_MOVED:
+    case TRN_GAME_EVENT_PIECE_ROTATED:
+      refresh_piece(gui, &event->from);
+      refresh_piece(gui, &event->to);
+      break;
+    case TRN_GAME_EVENT_PIECE_LOCKED:
+      refresh_piece(gui, &event->to);
+      break;
+    case TRN_GAME_EVENT_PIECE_SPAWNED:
+      refresh_piece(gui, &event->to);
+      trn_window_refresh_preview(gui->window);
+      break;
+    case TRN_GAME_EVENT_PIECE_HELD:
+      refresh_piece(gui, &event->from);
+      break;
+    case TRN_GAME_EVENT_ROWS_CLEARED:
+      /* The rows above the lowest cleared one all moved down. */
+      trn_window_refresh_cells(gui->window, 0, event->rowIndices[0],
+                               0, gui->game->grid->numberOfColumns - 1);
+      trn_window_update_lines(gui->window, gui->game->lines_count);
+      break;
+    case TRN_GAME_EVENT_LEVEL_UP:
+      trn_window_update_level(gui->window, event->value);
+      break;
+    case TRN_GAME_EVENT_SCORE_CHANGED:
+      trn_window_update_score(gui->window, event->value);
+      break;
+    default:
+      refresh_all = true;
+      break;
+    }
+  }
+
+  if (refresh_all) {
+    trn_window_refresh(gui->window);
+    trn_gui_update_labels(gui);
+  }
 }
 
 void trn_gui_update_labels(TrnGUI* gui)
@@ -14,6 +14,7 @@ typedef struct
 {
   TrnWindow* window;
   TrnGame* game;
+  unsigned inputs; /* TrnInput held down */
 } TrnGUI;
 
 TrnGUI* trn_gui_new(int numberOfRows, int numberOfColumns, int delay);
@@ -21,6 +22,9 @@ void trn_gui_destroy(TrnGUI* gui);
 gboolean on_key_press_event(GtkWidget *window,
                             GdkEventKey *event,
                             TrnGUI* gui);
+gboolean on_key_release_event(GtkWidget *window,
+                              GdkEventKey *event,
+                              TrnGUI* gui);
 gboolean on_preview_expose_event(GtkWidget *matrix, GdkEventExpose *event, TrnGUI* gui);
 gboolean on_matrix_expose_event(GtkWidget *matrix, GdkEventExpose *event, TrnGUI* gui);
 
@@ -76,6 +76,26 @@ void trn_window_refresh(TrnWindow const * const window)
   gtk_widget_queue_draw(window->base);
 }
 
+void trn_window_refresh_cells(TrnWindow const * const window,
+                              int const firstRowIndex,
+                              int const lastRowIndex,
+                              int const firstColumnIndex,
+                              int const lastColumnIndex)
+{
+  /* Cells are drawn with a border overlapping their neighbours by a pixel. */
+  gtk_widget_queue_draw_area(window->matrix,
+                             firstColumnIndex * NPIXELS,
+                             firstRowIndex * NPIXELS,
+                             (lastColumnIndex - firstColumnIndex + 1) * NPIXELS
+                             + 2,
+                             (lastRowIndex - firstRowIndex + 1) * NPIXELS + 2);
+}
+
+void trn_window_refresh_preview(TrnWindow const * const window)
+{
+  gtk_widget_queue_draw(window->preview);
+}
+
 void trn_window_destroy(TrnWindow* window)
 {
   gtk_widget_destroy(window->base);
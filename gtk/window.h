@@ -27,6 +27,13 @@ TrnWindow* trn_window_new(int const numberOfRows, int const numberOfColumns);
 void trn_window_destroy(TrnWindow * window);
 void trn_window_show(TrnWindow  const *  const window);
 void trn_window_refresh(TrnWindow const * const window);
+/* Redraw only the cells of the matrix within the given rows and columns. */
+void trn_window_refresh_cells(TrnWindow const * const window,
+                              int const firstRowIndex,
+                              int const lastRowIndex,
+                              int const firstColumnIndex,
+                              int const lastColumnIndex);
+void trn_window_refresh_preview(TrnWindow const * const window);
 void trn_window_update_score(TrnWindow const * const window, int const score);
 void trn_window_update_level(TrnWindow const * const window, int const level);
 void trn_window_update_lines(TrnWindow const * const window, int const lines);
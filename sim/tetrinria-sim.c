@@ -0,0 +1,302 @@
+/* Headless self-play: plays games with a bot on every core and prints the
+ * throughput and the score distribution. */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bot.h"
+#include "counters.h"
+#include "game.h"
+#include "random.h"
+#include "replay.h"
+#include "scheduler.h"
+
+/* A bot plays the current piece of a game until it locks. Each worker has
+ * its own state of the bot, if any, made for the grid size. */
+typedef struct {
+  char const* name;
+  void* (*new_state)(int const numberOfRows, int const numberOfColumns);
+  void (*destroy_state)(void * state);
+  void (*play_piece)(TrnGame * const game, TrnRandom * const random,
+                     void * const state);
+} SimBot;
+
+/* Random rotation and column, then hard drop. */
+static void play_random_piece(TrnGame * const game, TrnRandom * const random,
+                              void * const state)
+{
+  (void) state;
+  int const rotations = trn_random_below(random, 4);
+  int shift = trn_random_below(random, game->grid->numberOfColumns) -
+              game->grid->numberOfColumns / 2;
+  int index;
+
+  for (index = 0 ; index < rotations ; index++)
+    trn_game_try_to_rotate_clockwise(game);
+  for ( ; shift < 0 && trn_game_try_to_move_left(game) ; shift++)
+    ;
+  for ( ; shift > 0 && trn_game_try_to_move_right(game) ; shift--)
+    ;
+  trn_game_move_to_bottom(game);
+}
+
+/* Heuristic bots, searching the current piece only or the preview too. The
+ * workers already run games in parallel, so the bots search serially. */
+static void* new_greedy_bot(int const numberOfRows, int const numberOfColumns)
+{
+  TrnBotSettings settings = trn_bot_default_settings();
+  settings.beamWidth = 1;
+  settings.depth = 1;
+  return trn_bot_new(numberOfRows, numberOfColumns, settings, NULL);
+}
+
+static void* new_beam_bot(int const numberOfRows, int const numberOfColumns)
+{
+  return trn_bot_new(numberOfRows, numberOfColumns,
+                     trn_bot_default_settings(), NULL);
+}
+
+static void destroy_bot(void * state)
+{
+  trn_bot_destroy((TrnBot*) state);
+}
+
+static void play_bot_piece(TrnGame * const game, TrnRandom * const random,
+                           void * const state)
+{
+  (void) random;
+  if (!trn_bot_play((TrnBot*) state, game))
+    trn_game_move_to_bottom(game);
+}
+
+static SimBot const BOTS[] = {
+  {"random", NULL, NULL, play_random_piece},
+  {"greedy", new_greedy_bot, destroy_bot, play_bot_piece},
+  {"beam", new_beam_bot, destroy_bot, play_bot_piece},
+};
+
+#define NUMBER_OF_BOTS ((int) (sizeof(BOTS) / sizeof(BOTS[0])))
+
+/* Everything a worker writes while playing, on its own cache lines. */
+typedef struct {
+  TrnArena* arena;
+  TrnGame* game;
+  TrnRandom random;
+  void* botState;
+  TrnReplayRecorder* recorder; /* NULL when not recording */
+  long long pieces;
+  long long lines;
+} __attribute__((aligned(TRN_ALLOCATOR_MAX_ALIGNMENT))) SimWorker;
+
+typedef struct {
+  SimBot const* bot;
+  SimWorker* workers;
+  int* scores;
+  uint64_t firstSeed;
+  int maxPieces;
+} Sim;
+
+/* Play games [begin, end), game i with seed firstSeed + i, reusing the game
+ * of the worker. */
+static void play_games(void * const context, int const begin, int const end,
+                       int const workerIndex)
+{
+  Sim * const sim = (Sim*) context;
+  SimWorker * const worker = &sim->workers[workerIndex];
+  TrnGame * const game = worker->game;
+  int gameIndex;
+
+  for (gameIndex = begin ; gameIndex < end ; gameIndex++) {
+    uint64_t const seed = sim->firstSeed + gameIndex;
+    int pieces = 0;
+
+    /* A reset hands the replay of the previous game over, and starts the
+     * next one. */
+    trn_game_reset(game, seed);
+    if (game->recorder != worker->recorder)
+      trn_game_set_recorder(game, worker->recorder);
+    trn_random_seed(&worker->random, ~seed);
+    while (game->status == TRN_GAME_ON && pieces < sim->maxPieces) {
+      if (worker->recorder)
+        trn_replay_recorder_set_tick(worker->recorder, pieces);
+      sim->bot->play_piece(game, &worker->random, worker->botState);
+      pieces++;
+    }
+    sim->scores[gameIndex] = game->score;
+    worker->pieces += pieces;
+    worker->lines += game->lines_count;
+  }
+}
+
+static int compare_scores(void const* left, void const* right)
+{
+  int const l = *(int const*) left;
+  int const r = *(int const*) right;
+  return (l > r) - (l < r);
+}
+
+static double now_in_seconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void print_counters()
+{
+  static char const * const MOVE_NAMES[TRN_NUMBER_OF_COUNTED_MOVES] =
+    {"left", "right", "down", "rotation", "other"};
+  TrnCounters counters;
+  uint64_t locks = 0;
+  int index;
+
+  trn_counters_read(&counters);
+  printf("moves (attempts/failed):");
+  for (index = 0 ; index < TRN_NUMBER_OF_COUNTED_MOVES ; index++)
+    printf(" %s %llu/%llu", MOVE_NAMES[index],
+           (unsigned long long) counters.moveAttempts[index],
+           (unsigned long long) counters.failedMoves[index]);
+  printf("\nspawned:");
+  for (index = 0 ; index < TRN_NUMBER_OF_TETROMINO ; index++)
+    printf(" %llu", (unsigned long long) counters.spawnedPieces[index]);
+  printf("\nclears 0/1/2/3/4 rows:");
+  for (index = 0 ; index < 5 ; index++) {
+    printf(" %llu", (unsigned long long) counters.lineClears[index]);
+    locks += counters.lineClears[index];
+  }
+  printf("\nlock to spawn mean %.0f ns\n",
+         locks ? (double) counters.lockToSpawnNanoseconds / locks : 0.);
+}
+
+static void print_usage(char const * const program)
+{
+  int botIndex;
+  fprintf(stderr,
+          "usage: %s [-n games] [-s first seed] [-t threads] [-b bot]\n"
+          "          [-p max pieces per game] [-r rows] [-c columns]\n"
+          "          [-o replays file] [-m counters file]\n"
+          "bots:", program);
+  for (botIndex = 0 ; botIndex < NUMBER_OF_BOTS ; botIndex++)
+    fprintf(stderr, " %s", BOTS[botIndex].name);
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[])
+{
+  int numberOfGames = 10000;
+  int numberOfThreads = 0;
+  int numberOfRows = 20;
+  int numberOfColumns = 10;
+  char const* botName = "random";
+  char const* replayPath = NULL;
+  char const* countersPath = NULL;
+  TrnReplayWriter* writer = NULL;
+  Sim sim = {NULL, NULL, NULL, 0, 100000};
+  int option, botIndex, workerIndex;
+
+  while ((option = getopt(argc, argv, "n:s:t:b:p:r:c:o:m:h")) != -1) {
+    switch (option) {
+    case 'n': numberOfGames = atoi(optarg); break;
+    case 's': sim.firstSeed = strtoull(optarg, NULL, 0); break;
+    case 't': numberOfThreads = atoi(optarg); break;
+    case 'b': botName = optarg; break;
+    case 'p': sim.maxPieces = atoi(optarg); break;
+    case 'r': numberOfRows = atoi(optarg); break;
+    case 'c': numberOfColumns = atoi(optarg); break;
+    case 'o': replayPath = optarg; break;
+    case 'm': countersPath = optarg; break;
+    default:
+      print_usage(argv[0]);
+      return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  for (botIndex = 0 ; botIndex < NUMBER_OF_BOTS ; botIndex++)
+    if (strcmp(BOTS[botIndex].name, botName) == 0)
+      sim.bot = &BOTS[botIndex];
+  if (!sim.bot || numberOfGames <= 0 || numberOfRows < 4 ||
+      numberOfColumns < 4) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  /* Replays are written by a thread of their own, games never wait for
+   * the file. */
+  if (replayPath && !(writer = trn_replay_writer_new(replayPath))) {
+    fprintf(stderr, "cannot open %s\n", replayPath);
+    return EXIT_FAILURE;
+  }
+
+  /* Counters are published before the first game adds to them. */
+  if (countersPath && !trn_counters_publish(countersPath)) {
+    fprintf(stderr, trn_counters_enabled() ? "cannot map %s\n" :
+            "counters not compiled in, cannot publish %s\n", countersPath);
+    return EXIT_FAILURE;
+  }
+
+  TrnScheduler* scheduler = trn_scheduler_new(numberOfThreads);
+  int const numberOfWorkers = trn_scheduler_number_of_workers(scheduler);
+  sim.workers = (SimWorker*) trn_allocator_allocate(
+    trn_allocator_heap(), numberOfWorkers * sizeof(SimWorker),
+    TRN_ALLOCATOR_MAX_ALIGNMENT);
+  sim.scores = (int*) malloc(numberOfGames * sizeof(int));
+  for (workerIndex = 0 ; workerIndex < numberOfWorkers ; workerIndex++) {
+    SimWorker * const worker = &sim.workers[workerIndex];
+    worker->arena = trn_arena_new(64 * 1024);
+    worker->game = trn_game_new_with_allocator(numberOfRows, numberOfColumns,
+                                               0, 0, &worker->arena->base);
+    worker->botState = sim.bot->new_state ?
+                       sim.bot->new_state(numberOfRows, numberOfColumns) :
+                       NULL;
+    worker->recorder = writer ? trn_replay_recorder_new(writer) : NULL;
+    worker->pieces = 0;
+    worker->lines = 0;
+  }
+
+  /* Small ranges, games lengths vary a lot from one seed to the other. */
+  double const start = now_in_seconds();
+  trn_scheduler_parallel_for(scheduler, numberOfGames, 16, play_games, &sim);
+  double const seconds = now_in_seconds() - start;
+
+  long long pieces = 0, lines = 0, totalScore = 0;
+  int gameIndex;
+  for (workerIndex = 0 ; workerIndex < numberOfWorkers ; workerIndex++) {
+    pieces += sim.workers[workerIndex].pieces;
+    lines += sim.workers[workerIndex].lines;
+    /* Hand the replay of the last game over, if it did not end. */
+    trn_game_set_recorder(sim.workers[workerIndex].game, NULL);
+    if (sim.workers[workerIndex].recorder)
+      trn_replay_recorder_destroy(sim.workers[workerIndex].recorder);
+    trn_arena_destroy(sim.workers[workerIndex].arena);
+    if (sim.bot->destroy_state)
+      sim.bot->destroy_state(sim.workers[workerIndex].botState);
+  }
+  for (gameIndex = 0 ; gameIndex < numberOfGames ; gameIndex++)
+    totalScore += sim.scores[gameIndex];
+  qsort(sim.scores, numberOfGames, sizeof(int), compare_scores);
+
+  printf("bot %s, %d games, seeds %llu to %llu, %d threads\n",
+         sim.bot->name, numberOfGames, (unsigned long long) sim.firstSeed,
+         (unsigned long long) sim.firstSeed + numberOfGames - 1,
+         numberOfWorkers);
+  printf("%.3f s, %.0f games/s, %.0f pieces/s\n", seconds,
+         numberOfGames / seconds, pieces / seconds);
+  printf("pieces per game %.1f, lines per game %.2f\n",
+         (double) pieces / numberOfGames, (double) lines / numberOfGames);
+  printf("score min %d, mean %.1f, p50 %d, p90 %d, p99 %d, max %d\n",
+         sim.scores[0], (double) totalScore / numberOfGames,
+         sim.scores[numberOfGames / 2],
+         sim.scores[(int) (numberOfGames * 0.9)],
+         sim.scores[(int) (numberOfGames * 0.99)],
+         sim.scores[numberOfGames - 1]);
+  if (trn_counters_enabled())
+    print_counters();
+
+  if (writer)
+    trn_replay_writer_destroy(writer);
+  free(sim.scores);
+  trn_allocator_release(trn_allocator_heap(), sim.workers);
+  trn_scheduler_destroy(scheduler);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/* Replay verifier: plays the replays of files again on every core, and
+ * checks that they end with the recorded score, lines and level. */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "replay.h"
+#include "scheduler.h"
+#include "verifier.h"
+
+/* Replays of all the files, in memory before verifying, so that workers never
+ * wait for the disk. */
+typedef struct {
+  uint8_t** replays;
+  size_t* sizes;
+  int* fileIndices;
+  int count;
+  int capacity;
+} Replays;
+
+static void add_replay(Replays * const replays, uint8_t * const bytes,
+                       size_t const size, int const fileIndex)
+{
+  if (replays->count == replays->capacity) {
+    replays->capacity = replays->capacity ? 2 * replays->capacity : 1024;
+    replays->replays = (uint8_t**) realloc(
+      replays->replays, replays->capacity * sizeof(uint8_t*));
+    replays->sizes = (size_t*) realloc(replays->sizes,
+                                       replays->capacity * sizeof(size_t));
+    replays->fileIndices = (int*) realloc(replays->fileIndices,
+                                          replays->capacity * sizeof(int));
+  }
+  replays->replays[replays->count] = bytes;
+  replays->sizes[replays->count] = size;
+  replays->fileIndices[replays->count] = fileIndex;
+  replays->count++;
+}
+
+static double now_in_seconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void print_usage(char const * const program)
+{
+  fprintf(stderr, "usage: %s [-t threads] [-v] replays file...\n"
+          "  -v lists every replay, not only the invalid ones\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+  int numberOfThreads = 0;
+  int isVerbose = 0;
+  Replays replays = {NULL, NULL, NULL, 0, 0};
+  int option, fileIndex, replayIndex;
+
+  while ((option = getopt(argc, argv, "t:vh")) != -1) {
+    switch (option) {
+    case 't': numberOfThreads = atoi(optarg); break;
+    case 'v': isVerbose = 1; break;
+    default:
+      print_usage(argv[0]);
+      return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind == argc) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (fileIndex = optind ; fileIndex < argc ; fileIndex++) {
+    FILE * const file = fopen(argv[fileIndex], "rb");
+    uint8_t* bytes;
+    size_t size;
+    if (!file) {
+      fprintf(stderr, "cannot open %s\n", argv[fileIndex]);
+      return EXIT_FAILURE;
+    }
+    while ((bytes = trn_replay_read(file, &size)))
+      add_replay(&replays, bytes, size, fileIndex);
+    fclose(file);
+  }
+
+  TrnScheduler* scheduler = trn_scheduler_new(numberOfThreads);
+  TrnVerifier* verifier = trn_verifier_new(scheduler);
+  TrnVerification* results = (TrnVerification*) malloc(
+    (replays.count ? replays.count : 1) * sizeof(TrnVerification));
+
+  double const start = now_in_seconds();
+  trn_verifier_verify(verifier, (uint8_t const * const *) replays.replays,
+                      replays.sizes, replays.count, results);
+  double const seconds = now_in_seconds() - start;
+
+  int counts[TRN_NUMBER_OF_VERIFICATION_STATUSES] = {0};
+  int previousFileIndex = -1, indexInFile = 0;
+  for (replayIndex = 0 ; replayIndex < replays.count ; replayIndex++) {
+    TrnVerification const * const result = &results[replayIndex];
+    if (replays.fileIndices[replayIndex] != previousFileIndex)
+      indexInFile = 0;
+    previousFileIndex = replays.fileIndices[replayIndex];
+    counts[result->status]++;
+    if (isVerbose || result->status != TRN_VERIFICATION_VALID) {
+      printf("%s:%d %s", argv[replays.fileIndices[replayIndex]],
+             indexInFile, trn_verification_status_name(result->status));
+      if (result->status == TRN_VERIFICATION_DIVERGED)
+        printf(" at tick %llu",
+               (unsigned long long) result->divergenceTick);
+      printf(", score %d, lines %d, level %d\n", result->score,
+             result->lines, result->level);
+    }
+    indexInFile++;
+  }
+
+  printf("%d replays, %d threads, %.3f s, %.0f replays/min\n",
+         replays.count, trn_scheduler_number_of_workers(scheduler), seconds,
+         replays.count / seconds * 60);
+  int status;
+  for (status = 0 ; status < TRN_NUMBER_OF_VERIFICATION_STATUSES ; status++)
+    printf("%s%s %d", status ? ", " : "",
+           trn_verification_status_name((TrnVerificationStatus) status),
+           counts[status]);
+  printf("\n");
+
+  for (replayIndex = 0 ; replayIndex < replays.count ; replayIndex++)
+    free(replays.replays[replayIndex]);
+  free(replays.replays);
+  free(replays.sizes);
+  free(replays.fileIndices);
+  free(results);
+  trn_verifier_destroy(verifier);
+  trn_scheduler_destroy(scheduler);
+  return counts[TRN_VERIFICATION_VALID] == replays.count ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE;
+}